@@ -0,0 +1,243 @@
+/*
+ * Zeroed blocks for the matrices. calloc faults every page in from the allocating thread, so on a NUMA host a
+ * whole n x n matrix lands on one node. Blocks of a huge page and up are therefore mapped directly instead: they
+ * ask for huge pages (reserved ones through MAP_HUGETLB, else transparent ones through madvise) and are either
+ * interleaved page by page over the nodes, or first touched by the parallel_for workers that run the products.
+ */
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "alloc.h"
+#include "options.h"
+#include "parallel.h"
+
+#define MPOL_INTERLEAVE 3 /* From <numaif.h>, which comes with libnuma rather than the C library */
+#define ALLOC_MAX_NODES 1024
+#define NODE_MASK_WORDS (ALLOC_MAX_NODES / (8 * sizeof(unsigned long)))
+
+/*Kept in the ALLOC_HEADER bytes before every block*/
+typedef struct block_header_t
+{
+    void *map; /* NULL for heap blocks */
+    size_t map_len;
+    size_t bytes;
+} block_header_t;
+
+typedef struct touch_job_t
+{
+    char *block;
+    size_t bytes;
+    size_t stride;
+} touch_job_t;
+
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static alloc_stats_t stats;
+
+/*The highest online node plus one, from "0-1,3"-style lists in sysfs; 1 where there is no such file*/
+static size_t count_nodes(void)
+{
+    FILE *file = fopen("/sys/devices/system/node/online", "r");
+    unsigned long first, last, nodes = 1;
+    int separator;
+    if (NULL == file)
+    {
+        return 1;
+    }
+    while (fscanf(file, "%lu", &first) == 1)
+    {
+        last = first;
+        separator = fgetc(file);
+        if ('-' == separator && fscanf(file, "%lu", &last) == 1)
+        {
+            separator = fgetc(file);
+        }
+        nodes = last + 1 > nodes ? last + 1 : nodes;
+        if (',' != separator)
+        {
+            break;
+        }
+    }
+    fclose(file);
+    return nodes < ALLOC_MAX_NODES ? nodes : ALLOC_MAX_NODES;
+}
+
+static void touch_task(void *arg, const size_t index)
+{
+    touch_job_t *job = (touch_job_t *)arg;
+    const size_t start = index * job->stride;
+    memset(job->block + start, 0, start + job->stride < job->bytes ? job->stride : job->bytes - start);
+}
+
+static void record(const size_t bytes, const int mapped, const size_t explicit_bytes, const size_t transparent_bytes,
+                   const size_t interleaved_bytes, const size_t first_touch_bytes)
+{
+    pthread_mutex_lock(&stats_lock);
+    if (mapped)
+    {
+        stats.mapped_blocks++;
+        stats.mapped_bytes += bytes;
+    }
+    else
+    {
+        stats.heap_blocks++;
+        stats.heap_bytes += bytes;
+    }
+    stats.explicit_bytes += explicit_bytes;
+    stats.transparent_bytes += transparent_bytes;
+    stats.interleaved_bytes += interleaved_bytes;
+    stats.first_touch_bytes += first_touch_bytes;
+    stats.current_bytes += bytes;
+    if (stats.current_bytes > stats.peak_bytes)
+    {
+        stats.peak_bytes = stats.current_bytes;
+    }
+    pthread_mutex_unlock(&stats_lock);
+}
+
+static size_t node_count(void)
+{
+    size_t nodes;
+    pthread_mutex_lock(&stats_lock);
+    if (0 == stats.nodes)
+    {
+        stats.nodes = count_nodes();
+    }
+    nodes = stats.nodes;
+    pthread_mutex_unlock(&stats_lock);
+    return nodes;
+}
+
+/*
+ * A zeroed block of 'bytes', placed per SPKM_HUGE_PAGES and SPKM_NUMA. 'stride' is the span of one task of the
+ * code that will use it, such as MATRIX_TILE rows, so first-touch placement follows the same partition.
+ */
+void *alloc_block(const size_t bytes, const size_t stride)
+{
+    block_header_t *header;
+    options_t options;
+#ifdef __linux__
+    void *map = MAP_FAILED;
+    size_t len, explicit_bytes = 0, transparent_bytes = 0, interleaved_bytes = 0, first_touch_bytes = 0, nodes, i;
+    unsigned long mask[NODE_MASK_WORDS];
+    touch_job_t job;
+#endif
+
+    load_options(&options);
+#ifdef __linux__
+    if (bytes >= ALLOC_MAP_MIN)
+    {
+        len = (bytes + ALLOC_HEADER + ALLOC_HUGE_PAGE - 1) / ALLOC_HUGE_PAGE * ALLOC_HUGE_PAGE;
+#ifdef MAP_HUGETLB
+        if (EXPLICIT_HUGE_PAGES == options.huge_pages)
+        {
+            map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            explicit_bytes = MAP_FAILED == map ? 0 : bytes; /* Fails unless huge pages were reserved; then fall back */
+        }
+#endif
+        if (MAP_FAILED == map)
+        {
+            map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+            if (MAP_FAILED != map && NO_HUGE_PAGES != options.huge_pages && madvise(map, len, MADV_HUGEPAGE) == 0)
+            {
+                transparent_bytes = bytes;
+            }
+#endif
+        }
+    }
+    if (MAP_FAILED != map)
+    {
+        nodes = node_count();
+        if (INTERLEAVE_PLACEMENT == options.placement && nodes > 1)
+        {
+            memset(mask, 0, sizeof(mask));
+            for (i = 0; i < nodes; i++)
+            {
+                mask[i / (8 * sizeof(unsigned long))] |= 1UL << (i % (8 * sizeof(unsigned long)));
+            }
+            if (syscall(SYS_mbind, map, len, MPOL_INTERLEAVE, mask, (unsigned long)ALLOC_MAX_NODES, 0) == 0)
+            {
+                interleaved_bytes = bytes;
+            }
+        }
+        header = (block_header_t *)map;
+        header->map = map;
+        header->map_len = len;
+        header->bytes = bytes;
+        job.block = (char *)map + ALLOC_HEADER;
+        job.bytes = bytes;
+        job.stride = stride > 0 ? stride : bytes;
+        if (FIRST_TOUCH_PLACEMENT == options.placement && 0 == interleaved_bytes && get_num_threads() > 1 &&
+            parallel_for((bytes + job.stride - 1) / job.stride, touch_task, &job) == 0)
+        {
+            first_touch_bytes = bytes;
+        }
+        record(bytes, 1, explicit_bytes, transparent_bytes, interleaved_bytes, first_touch_bytes);
+        return job.block;
+    }
+#endif
+
+    (void)stride;
+    header = (block_header_t *)calloc(1, bytes + ALLOC_HEADER);
+    if (NULL == header)
+    {
+        return NULL;
+    }
+    header->map = NULL;
+    header->map_len = 0;
+    header->bytes = bytes;
+    record(bytes, 0, 0, 0, 0, 0);
+    return (char *)header + ALLOC_HEADER;
+}
+
+void free_block(void *block)
+{
+    block_header_t *header;
+    if (NULL == block)
+    {
+        return;
+    }
+    header = (block_header_t *)((char *)block - ALLOC_HEADER);
+    pthread_mutex_lock(&stats_lock);
+    stats.current_bytes -= header->bytes;
+    pthread_mutex_unlock(&stats_lock);
+#ifdef __linux__
+    if (NULL != header->map)
+    {
+        munmap(header->map, header->map_len);
+        return;
+    }
+#endif
+    free(header);
+}
+
+void get_alloc_stats(alloc_stats_t *out)
+{
+    node_count();
+    pthread_mutex_lock(&stats_lock);
+    *out = stats;
+    pthread_mutex_unlock(&stats_lock);
+}
+
+/*One line per kind of block, for SPKM_ALLOC_STATS*/
+void print_alloc_stats(FILE *stream)
+{
+    alloc_stats_t current;
+    const double mib = 1 << 20;
+    get_alloc_stats(&current);
+    fprintf(stream, "Mapped blocks: %lu, %.1f MiB (explicit huge pages %.1f MiB, transparent huge pages advised %.1f MiB)\n",
+            (unsigned long)current.mapped_blocks, current.mapped_bytes / mib, current.explicit_bytes / mib, current.transparent_bytes / mib);
+    fprintf(stream, "Placement over %lu NUMA node(s): interleaved %.1f MiB, first-touched by workers %.1f MiB\n",
+            (unsigned long)current.nodes, current.interleaved_bytes / mib, current.first_touch_bytes / mib);
+    fprintf(stream, "Heap blocks: %lu, %.1f MiB; peak in use %.1f MiB\n",
+            (unsigned long)current.heap_blocks, current.heap_bytes / mib, current.peak_bytes / mib);
+}
@@ -0,0 +1,29 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ALLOC_HUGE_PAGE (2UL << 20) /* The x86-64 huge page size */
+#define ALLOC_MAP_MIN ALLOC_HUGE_PAGE /* Smaller blocks come from the heap, where pages are shared and placement is moot */
+#define ALLOC_HEADER 64 /* Bytes before every block, keeping its rows cache-line aligned */
+
+/*What the allocations of this process got so far*/
+typedef struct alloc_stats_t
+{
+    size_t heap_blocks, heap_bytes;
+    size_t mapped_blocks, mapped_bytes;
+    size_t explicit_bytes;    /* Backed by reserved MAP_HUGETLB pages */
+    size_t transparent_bytes; /* Advised to the kernel for transparent huge pages */
+    size_t interleaved_bytes; /* Spread page by page over every NUMA node */
+    size_t first_touch_bytes; /* Touched by the workers in the row partition of the blocked products */
+    size_t current_bytes, peak_bytes;
+    size_t nodes; /* Online NUMA nodes */
+} alloc_stats_t;
+
+void *alloc_block(const size_t bytes, const size_t stride);
+void free_block(void *block);
+void get_alloc_stats(alloc_stats_t *stats);
+void print_alloc_stats(FILE *stream);
+
+#endif /* ALLOC_H */
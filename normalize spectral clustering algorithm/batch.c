@@ -0,0 +1,619 @@
+/*
+ * Many small independent problems in one process. Each problem runs on one pool worker, one after the other,
+ * and every worker keeps a workspace of the buffers a problem needs: the file text, the parsed values, the
+ * output matrix, the eigenpairs and a formatted row. They only grow, so once the largest problem seen so far
+ * fits, the next ones reuse them instead of allocating, and a file is read once rather than once per pass.
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "batch.h"
+#include "debug.h"
+#include "input.h"
+#include "options.h"
+#include "parallel.h"
+#include "solver.h"
+
+#define BATCH_FIXED_WIDTH 32 /* Bytes sprint_fixed4() may take for one value and its comma */
+
+typedef struct batch_workspace_t
+{
+    char *text;
+    size_t text_len;
+    double *values;
+    size_t values_len;
+    point_t *points;
+    double **rows;
+    double **out_rows;
+    size_t rows_len;
+    double *out;
+    size_t out_len;
+    eigen_t *eigens;
+    double *vectors;
+    size_t eigens_len;
+    char *line;
+    size_t line_len;
+    struct batch_workspace_t *next;
+} batch_workspace_t;
+
+typedef struct batch_t
+{
+    batch_input_t *inputs;
+    batch_result_t *results;
+    batch_output_e output;
+    FILE *indexed;
+    batch_index_t *index;
+    unsigned long offset; /* Where the next matrix of the indexed file goes */
+    double budget;        /* Seconds per problem, 0 for no limit */
+    batch_workspace_t *idle;
+    pthread_mutex_t lock;
+} batch_t;
+
+/*Makes *buffer hold at least 'len' elements of 'size' bytes, keeping a larger one*/
+static int reserve(void **buffer, size_t *buffer_len, const size_t len, const size_t size)
+{
+    void *grown;
+    if (len <= *buffer_len)
+    {
+        return 0;
+    }
+    grown = realloc(*buffer, len * size);
+    if (NULL == grown)
+    {
+        return 1;
+    }
+    *buffer = grown;
+    *buffer_len = len;
+    return 0;
+}
+
+/*The point, input row and output row arrays share one capacity*/
+static int reserve_rows(batch_workspace_t *workspace, const size_t rows)
+{
+    point_t *points;
+    double **input_rows, **out_rows;
+    if (rows <= workspace->rows_len)
+    {
+        return 0;
+    }
+    points = (point_t *)realloc(workspace->points, rows * sizeof(point_t));
+    workspace->points = NULL != points ? points : workspace->points;
+    input_rows = (double **)realloc(workspace->rows, rows * sizeof(double *));
+    workspace->rows = NULL != input_rows ? input_rows : workspace->rows;
+    out_rows = (double **)realloc(workspace->out_rows, rows * sizeof(double *));
+    workspace->out_rows = NULL != out_rows ? out_rows : workspace->out_rows;
+    if (NULL == points || NULL == input_rows || NULL == out_rows)
+    {
+        return 1;
+    }
+    workspace->rows_len = rows;
+    return 0;
+}
+
+/*n eigenpairs whose vectors lie in one n x n block*/
+static int reserve_eigens(batch_workspace_t *workspace, const size_t n)
+{
+    eigen_t *eigens;
+    double *vectors;
+    size_t j;
+    if (n > workspace->eigens_len)
+    {
+        eigens = (eigen_t *)realloc(workspace->eigens, n * sizeof(eigen_t));
+        workspace->eigens = NULL != eigens ? eigens : workspace->eigens;
+        vectors = (double *)realloc(workspace->vectors, n * n * sizeof(double));
+        workspace->vectors = NULL != vectors ? vectors : workspace->vectors;
+        if (NULL == eigens || NULL == vectors)
+        {
+            return 1;
+        }
+        workspace->eigens_len = n;
+    }
+    for (j = 0; j < n; j++)
+    {
+        workspace->eigens[j].vector = workspace->vectors + j * n;
+    }
+    return 0;
+}
+
+static void free_workspace(batch_workspace_t *workspace)
+{
+    free(workspace->text);
+    free(workspace->values);
+    free(workspace->points);
+    free(workspace->rows);
+    free(workspace->out_rows);
+    free(workspace->out);
+    free(workspace->eigens);
+    free(workspace->vectors);
+    free(workspace->line);
+    free(workspace);
+}
+
+/*Reads the whole file into the workspace text, NUL-terminated*/
+static error_e read_text(batch_workspace_t *workspace, const char *path)
+{
+    FILE *file;
+    long len;
+    size_t read;
+    file = fopen(path, "rb");
+    if (NULL == file)
+    {
+        return INVALID_INPUT;
+    }
+    if (fseek(file, 0, SEEK_END) != 0 || (len = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0)
+    {
+        fclose(file);
+        return INVALID_INPUT;
+    }
+    if (reserve((void **)&workspace->text, &workspace->text_len, (size_t)len + 1, sizeof(char)) != 0)
+    {
+        fclose(file);
+        return MALLOC_ERROR;
+    }
+    read = fread(workspace->text, 1, (size_t)len, file);
+    fclose(file);
+    workspace->text[read] = '\0';
+    return read == (size_t)len ? OK : INVALID_INPUT;
+}
+
+/*
+ * Parses the text as read_points() and read_matrix() read a file: one row per line, the dimension from the
+ * commas of the first line, and n x n values for a Jacobi matrix
+ */
+static error_e parse_text(batch_workspace_t *workspace, const goal_e goal, size_t *n, size_t *dim)
+{
+    char *cursor = workspace->text, *end;
+    size_t i;
+    *n = 0;
+    *dim = 1;
+    for (end = cursor; '\0' != *end; end++)
+    {
+        *n += '\n' == *end ? 1 : 0;
+    }
+    for (end = cursor; '\0' != *end && '\n' != *end; end++)
+    {
+        *dim += DELIM == *end ? 1 : 0;
+    }
+    if (JACOBI == goal)
+    {
+        *dim = *n;
+    }
+    if (0 == *n || reserve((void **)&workspace->values, &workspace->values_len, *n * *dim, sizeof(double)) != 0)
+    {
+        return 0 == *n ? INVALID_INPUT : MALLOC_ERROR;
+    }
+    for (i = 0; i < *n * *dim; i++)
+    {
+        while (DELIM == *cursor || '\n' == *cursor || '\r' == *cursor)
+        {
+            cursor++;
+        }
+        workspace->values[i] = strtod(cursor, &end);
+        if (end == cursor)
+        {
+            return INVALID_INPUT;
+        }
+        cursor = end;
+    }
+    return OK;
+}
+
+/*Solves one problem into the workspace output, an n-row matrix or the n + 1 rows of the eigenpairs*/
+static error_e solve_problem(batch_t *batch, batch_workspace_t *workspace, batch_input_t *input, batch_result_t *result)
+{
+    error_e status;
+    double *values = input->values;
+    size_t n = input->n, dim = input->dim, rows, k = input->k, i, j;
+    int solved;
+    deadline_t deadline;
+
+    if (NULL == values)
+    {
+        status = read_text(workspace, input->path);
+        if (OK == status)
+        {
+            status = parse_text(workspace, input->goal, &n, &dim);
+        }
+        if (OK != status)
+        {
+            return status;
+        }
+        values = workspace->values;
+    }
+    if (0 == n || 0 == dim || (JACOBI == input->goal && dim != n) || (NORMALIZED_EIGEN_MATRIX == input->goal && k > n))
+    {
+        return INVALID_INPUT;
+    }
+    if (JACOBI == input->goal && values != workspace->values)
+    {
+        if (reserve((void **)&workspace->values, &workspace->values_len, n * n, sizeof(double)) != 0)
+        {
+            return MALLOC_ERROR;
+        }
+        memcpy(workspace->values, values, n * n * sizeof(double)); /* The solver rotates its input in place */
+        values = workspace->values;
+    }
+
+    rows = JACOBI == input->goal ? n + 1 : n;
+    if (reserve_rows(workspace, rows) != 0 || reserve((void **)&workspace->out, &workspace->out_len, rows * n, sizeof(double)) != 0)
+    {
+        return MALLOC_ERROR;
+    }
+    memset(workspace->out, 0, rows * n * sizeof(double)); /* The goals only write the entries that are not 0, as into a fresh matrix */
+    for (i = 0; i < rows; i++)
+    {
+        workspace->out_rows[i] = workspace->out + i * n;
+    }
+    for (i = 0; i < n; i++)
+    {
+        workspace->rows[i] = values + i * dim;
+        workspace->points[i].elements = values + i * dim;
+    }
+
+    deadline_start(&deadline, batch->budget);
+    if (JACOBI != input->goal)
+    {
+        status = calc_matrix(n, workspace->points, dim, input->goal, workspace->out_rows, &k, &deadline);
+        result->rows = n;
+        result->cols = NORMALIZED_EIGEN_MATRIX == input->goal || POWER_ITERATION_EMBEDDING == input->goal ? k : n;
+        return status;
+    }
+
+    if (reserve_eigens(workspace, n) != 0)
+    {
+        return MALLOC_ERROR;
+    }
+    solved = solve_jacobi_goal(n, workspace->rows, workspace->eigens, &deadline);
+    status = 0 == solved ? OK : (DEADLINE_STOPPED(solved) ? (error_e)solved : MALLOC_ERROR);
+    for (j = 0; j < n; j++)
+    {
+        workspace->out_rows[0][j] = workspace->eigens[j].value;
+        for (i = 0; i < n; i++)
+        {
+            workspace->out_rows[i + 1][j] = workspace->eigens[j].vector[i];
+        }
+    }
+    result->rows = n + 1;
+    result->cols = n;
+    return status;
+}
+
+/*Writes the output as the CLI prints it, formatting each row into the workspace line*/
+static error_e write_text(batch_workspace_t *workspace, const char *path, const error_e status, batch_result_t *result)
+{
+    FILE *out;
+    size_t i, j, len;
+    out = fopen(path, "w");
+    if (NULL == out)
+    {
+        return INVALID_INPUT;
+    }
+    if (OK != status && !DEADLINE_STOPPED(status))
+    {
+        fputs(INVALID_INPUT == status ? "Invalid Input\n" : "An Error Has Occurred\n", out);
+        return 0 == fclose(out) ? status : MALLOC_ERROR;
+    }
+    if (reserve((void **)&workspace->line, &workspace->line_len, result->cols * BATCH_FIXED_WIDTH + 1, sizeof(char)) != 0)
+    {
+        fclose(out);
+        return MALLOC_ERROR;
+    }
+    for (i = 0; i < result->rows; i++)
+    {
+        len = 0;
+        for (j = 0; j < result->cols; j++)
+        {
+            len += sprint_fixed4(workspace->line + len, workspace->out_rows[i][j]);
+            workspace->line[len++] = j < result->cols - 1 ? ',' : '\n';
+        }
+        fwrite(workspace->line, 1, len, out);
+    }
+    return 0 == fclose(out) ? status : MALLOC_ERROR;
+}
+
+/*Appends the matrix to the indexed file and records where it went*/
+static error_e write_indexed(batch_t *batch, batch_workspace_t *workspace, const size_t index, const error_e status, batch_result_t *result)
+{
+    size_t i, written = 0;
+    batch_index_t *entry = &batch->index[index];
+    entry->status = (unsigned long)status;
+    if (OK != status && !DEADLINE_STOPPED(status))
+    {
+        return status;
+    }
+    pthread_mutex_lock(&batch->lock);
+    entry->rows = (unsigned long)result->rows;
+    entry->cols = (unsigned long)result->cols;
+    entry->offset = batch->offset;
+    if (fseek(batch->indexed, (long)batch->offset, SEEK_SET) == 0)
+    {
+        for (i = 0; i < result->rows; i++)
+        {
+            written += fwrite(workspace->out_rows[i], sizeof(double), result->cols, batch->indexed);
+        }
+    }
+    batch->offset += (unsigned long)(result->rows * result->cols * sizeof(double));
+    pthread_mutex_unlock(&batch->lock);
+    if (written != result->rows * result->cols)
+    {
+        entry->status = MALLOC_ERROR;
+        return MALLOC_ERROR;
+    }
+    return status;
+}
+
+static error_e copy_result(batch_workspace_t *workspace, const error_e status, batch_result_t *result)
+{
+    size_t i;
+    if (OK != status && !DEADLINE_STOPPED(status))
+    {
+        return status;
+    }
+    result->values = (double *)malloc((result->rows * result->cols > 0 ? result->rows * result->cols : 1) * sizeof(double));
+    if (NULL == result->values)
+    {
+        return MALLOC_ERROR;
+    }
+    for (i = 0; i < result->rows; i++)
+    {
+        memcpy(result->values + i * result->cols, workspace->out_rows[i], result->cols * sizeof(double));
+    }
+    return status;
+}
+
+static void batch_task(void *arg, const size_t index)
+{
+    batch_t *batch = (batch_t *)arg;
+    batch_workspace_t *workspace;
+    batch_result_t *result = &batch->results[index];
+    error_e status;
+
+    pthread_mutex_lock(&batch->lock);
+    workspace = batch->idle;
+    if (NULL != workspace)
+    {
+        batch->idle = workspace->next;
+    }
+    pthread_mutex_unlock(&batch->lock);
+    if (NULL == workspace)
+    {
+        workspace = (batch_workspace_t *)calloc(1, sizeof(batch_workspace_t)); /* At most one per thread of the pool */
+    }
+
+    result->rows = 0;
+    result->cols = 0;
+    result->values = NULL;
+    status = NULL != workspace ? solve_problem(batch, workspace, &batch->inputs[index], result) : MALLOC_ERROR;
+    if (OK != status && !DEADLINE_STOPPED(status))
+    {
+        result->rows = 0;
+        result->cols = 0;
+    }
+    if (BATCH_FILES == batch->output && NULL != workspace)
+    {
+        status = write_text(workspace, batch->inputs[index].out_path, status, result);
+    }
+    else if (BATCH_INDEXED == batch->output)
+    {
+        status = write_indexed(batch, workspace, index, status, result);
+    }
+    else if (BATCH_MEMORY == batch->output)
+    {
+        status = copy_result(workspace, status, result);
+    }
+    result->status = status;
+    if (NULL == workspace)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&batch->lock);
+    workspace->next = batch->idle;
+    batch->idle = workspace;
+    pthread_mutex_unlock(&batch->lock);
+}
+
+/*
+ * Runs the 'count' problems, one per pool worker at a time, and stores each one's status and output size in
+ * 'results'. Returns OK when every problem succeeded, and else the status of the first one that did not.
+ */
+error_e run_batch(batch_input_t *inputs, const size_t count, const batch_output_e output, FILE *indexed, batch_result_t *results)
+{
+    batch_t batch;
+    batch_header_t header;
+    batch_workspace_t *workspace;
+    options_t options;
+    error_e result = OK;
+    size_t i;
+
+    load_options(&options);
+    memset(&batch, 0, sizeof(batch));
+    batch.inputs = inputs;
+    batch.results = results;
+    batch.output = output;
+    batch.indexed = indexed;
+    batch.budget = options.time_budget / 1000.0;
+    if (BATCH_INDEXED == output)
+    {
+        batch.index = (batch_index_t *)calloc(count > 0 ? count : 1, sizeof(batch_index_t));
+        if (NULL == batch.index)
+        {
+            return MALLOC_ERROR;
+        }
+        batch.offset = (unsigned long)(sizeof(batch_header_t) + count * sizeof(batch_index_t));
+    }
+    pthread_mutex_init(&batch.lock, NULL);
+
+    if (parallel_for(count, batch_task, &batch) != 0)
+    {
+        result = MALLOC_ERROR;
+    }
+    for (i = 0; i < count && OK == result; i++)
+    {
+        result = results[i].status;
+    }
+    if (BATCH_INDEXED == output)
+    {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, BATCH_MAGIC, sizeof(BATCH_MAGIC));
+        header.count = (unsigned long)count;
+        if (fseek(indexed, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, indexed) != 1 ||
+            fwrite(batch.index, sizeof(batch_index_t), count, indexed) != count)
+        {
+            result = MALLOC_ERROR;
+        }
+        free(batch.index);
+    }
+
+    while (NULL != batch.idle)
+    {
+        workspace = batch.idle;
+        batch.idle = workspace->next;
+        free_workspace(workspace);
+    }
+    pthread_mutex_destroy(&batch.lock);
+    return result;
+}
+
+/*Copies the 'len' bytes at 'start' into a new NUL-terminated string*/
+static char *copy_field(const char *start, const size_t len)
+{
+    char *field = (char *)malloc(len + 1);
+    if (NULL != field)
+    {
+        memcpy(field, start, len);
+        field[len] = '\0';
+    }
+    return field;
+}
+
+/*
+ * Parses a manifest line "<goal>,<input>[,<output>]"; without an output the problem's text goes to
+ * "<input>.out". Empty lines yield no problem.
+ */
+static error_e parse_manifest_line(char *line, batch_input_t *input, int *parsed)
+{
+    char *fields[3], *end;
+    size_t fields_len = 0, len;
+
+    *parsed = 0;
+    len = strlen(line);
+    while (len > 0 && ('\n' == line[len - 1] || '\r' == line[len - 1]))
+    {
+        line[--len] = '\0';
+    }
+    if (0 == len)
+    {
+        return OK;
+    }
+    fields[fields_len++] = line;
+    for (end = line; '\0' != *end && fields_len < 3; end++)
+    {
+        if (DELIM == *end)
+        {
+            *end = '\0';
+            fields[fields_len++] = end + 1;
+        }
+    }
+    memset(input, 0, sizeof(batch_input_t));
+    input->goal = fields_len >= 2 ? get_goal(fields[0]) : UNKNOWN_GOAL;
+    if (UNKNOWN_GOAL == input->goal || '\0' == *fields[1])
+    {
+        return INVALID_INPUT;
+    }
+    input->path = copy_field(fields[1], strlen(fields[1]));
+    if (3 == fields_len)
+    {
+        input->out_path = copy_field(fields[2], strlen(fields[2]));
+    }
+    else if (NULL != input->path)
+    {
+        input->out_path = (char *)malloc(strlen(input->path) + sizeof(".out"));
+        if (NULL != input->out_path)
+        {
+            sprintf(input->out_path, "%s.out", input->path);
+        }
+    }
+    *parsed = 1;
+    return NULL == input->path || NULL == input->out_path ? MALLOC_ERROR : OK;
+}
+
+/*
+ * The CLI's batch command: runs every problem of the manifest and writes each output to its own file, or all
+ * of them to the indexed file SPKM_BATCH_OUTPUT names
+ */
+error_e run_manifest(char *manifest_path)
+{
+    error_e result = OK;
+    options_t options;
+    FILE *manifest, *indexed = NULL;
+    char line[BATCH_MAX_LINE];
+    batch_input_t *inputs = NULL, *grown;
+    batch_result_t *results = NULL;
+    size_t count = 0, inputs_len = 0, i;
+    int parsed;
+
+    load_options(&options);
+    manifest = fopen(manifest_path, "r");
+    if (NULL == manifest)
+    {
+        return INVALID_INPUT;
+    }
+    while (OK == result && NULL != fgets(line, sizeof(line), manifest))
+    {
+        if (count == inputs_len)
+        {
+            grown = (batch_input_t *)realloc(inputs, (inputs_len > 0 ? 2 * inputs_len : 64) * sizeof(batch_input_t));
+            if (NULL == grown)
+            {
+                result = MALLOC_ERROR;
+                break;
+            }
+            inputs = grown;
+            inputs_len = inputs_len > 0 ? 2 * inputs_len : 64;
+        }
+        result = parse_manifest_line(line, &inputs[count], &parsed);
+        count += parsed;
+    }
+    fclose(manifest);
+    if (OK != result)
+    {
+        goto inputs_cleanup;
+    }
+
+    results = (batch_result_t *)malloc((count > 0 ? count : 1) * sizeof(batch_result_t));
+    if (NULL == results)
+    {
+        result = MALLOC_ERROR;
+        goto inputs_cleanup;
+    }
+    if (NULL != options.batch_output)
+    {
+        indexed = fopen(options.batch_output, "wb");
+        if (NULL == indexed)
+        {
+            result = INVALID_INPUT;
+            goto results_cleanup;
+        }
+    }
+    result = run_batch(inputs, count, NULL != indexed ? BATCH_INDEXED : BATCH_FILES, indexed, results);
+    if (NULL != indexed && fclose(indexed) != 0)
+    {
+        result = MALLOC_ERROR;
+    }
+
+results_cleanup:
+    free(results);
+inputs_cleanup:
+    for (i = 0; i < count; i++)
+    {
+        free(inputs[i].path);
+        free(inputs[i].out_path);
+    }
+    free(inputs);
+    return result;
+}
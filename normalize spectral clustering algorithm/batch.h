@@ -0,0 +1,61 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "spkmeans.h"
+
+#define BATCH_COMMAND "batch"
+#define BATCH_MAGIC "SPKMBAT"
+#define BATCH_MAX_LINE 8192
+
+typedef enum batch_output_e
+{
+    BATCH_FILES = 0,   /* Every problem's output, as the CLI prints it, goes to its own file */
+    BATCH_INDEXED = 1, /* Every problem's matrix goes to one indexed binary file */
+    BATCH_MEMORY = 2   /* Every problem's matrix is returned in its batch_result_t */
+} batch_output_e;
+
+/*One independent problem: a goal on the points, or for jacobi the symmetric matrix, of a file or an array*/
+typedef struct batch_input_t
+{
+    goal_e goal;
+    size_t k;           /* Only read by the spk goal, 0 uses the eigengap */
+    char *path;         /* Read when 'values' is NULL */
+    double *values;     /* n * dim doubles, row after row */
+    size_t n;
+    size_t dim;
+    char *out_path;     /* For BATCH_FILES */
+} batch_input_t;
+
+/*The matrix the CLI would print: rows x cols, the eigenvalues over the eigenvectors' columns for jacobi*/
+typedef struct batch_result_t
+{
+    error_e status;
+    size_t rows;
+    size_t cols;
+    double *values; /* Only for BATCH_MEMORY, owned by the caller; NULL when the problem failed */
+} batch_result_t;
+
+/*
+ * The indexed file starts with this header and 'count' batch_index_t entries, in input order, followed by the
+ * matrices as native doubles row after row, in the order the problems finished.
+ */
+typedef struct batch_header_t
+{
+    char magic[8];
+    unsigned long count;
+} batch_header_t;
+
+typedef struct batch_index_t
+{
+    unsigned long status; /* An error_e value; rows and cols are 0 when no matrix was written */
+    unsigned long rows;
+    unsigned long cols;
+    unsigned long offset; /* Of the first double, from the start of the file */
+} batch_index_t;
+
+error_e run_batch(batch_input_t *inputs, const size_t count, const batch_output_e output, FILE *indexed, batch_result_t *results);
+error_e run_manifest(char *manifest_path);
+
+#endif /* BATCH_H */
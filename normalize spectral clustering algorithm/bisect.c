@@ -0,0 +1,572 @@
+/*
+ * Hierarchical spectral clustering by recursive bisection. Each cluster is split in two by the sweep cut of
+ * lowest conductance along D^-1/2 times its Fiedler vector, the eigenvector of the second smallest eigenvalue of
+ * the cluster's own L_norm. That one eigenvector comes from a short Lanczos run kept orthogonal to the known
+ * first one, D^1/2 1, so no cluster needs more than a few dozen products with its L_norm. Every round finds the
+ * best cut of each new cluster, each on its own pool worker, preferring balanced cuts so that a cluster of many
+ * separated groups is halved rather than peeled, then makes the cuts of lowest conductance, all of those within
+ * BISECT_BATCH_SLACK of the lowest, until there are k clusters or no cluster has a cut leaving
+ * 'min_size' points on both sides with a conductance of at most 'max_conductance'.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "bisect.h"
+#include "matrix.h"
+#include "operator.h"
+#include "parallel.h"
+#include "tridiag.h"
+
+/*The points of one cluster and its L_norm, from a dense W or regenerated by the operator past BISECT_DENSE_MAX*/
+typedef struct subgraph_t
+{
+    size_t m, dim;
+    point_t *points; /* Sharing the elements of the input points */
+    double **w;      /* NULL when the operator is used */
+    double *degrees;
+    double *scale;   /* D^-1/2, the operator's own when it is used */
+    double *scaled;  /* D^-1/2 x for the dense products */
+    lnorm_operator_t op;
+} subgraph_t;
+
+typedef struct product_job_t
+{
+    subgraph_t *graph;
+    double *x, *y;
+} product_job_t;
+
+typedef enum leaf_state_e
+{
+    UNSPLIT_LEAF = 0, /* Its best cut is not known yet */
+    CUT_LEAF = 1,     /* Its range is sorted along its Fiedler vector and its best cut is kept */
+    FINAL_LEAF = 2    /* No allowed cut */
+} leaf_state_e;
+
+/*A cluster: the range [begin, end) of the order of the points*/
+typedef struct leaf_t
+{
+    size_t begin, end;
+    leaf_state_e state;
+    size_t cut;
+    double conductance, fiedler;
+} leaf_t;
+
+typedef struct split_job_t
+{
+    point_t *points;
+    size_t dim;
+    size_t *order;
+    size_t leaf;
+    size_t begin, end;
+    size_t min_size;
+    double max_conductance;
+    size_t cut; /* The first side is [begin, begin + cut) after the range is reordered, 0 when it is not split */
+    double conductance, fiedler;
+    error_e status;
+} split_job_t;
+
+typedef struct sweep_key_t
+{
+    double key;
+    size_t index;
+} sweep_key_t;
+
+typedef struct candidate_t
+{
+    double conductance;
+    size_t leaf;
+} candidate_t;
+
+static int compare_keys(const void *a, const void *b)
+{
+    const sweep_key_t *left = (const sweep_key_t *)a, *right = (const sweep_key_t *)b;
+    if (left->key != right->key)
+    {
+        return left->key < right->key ? -1 : 1;
+    }
+    return left->index < right->index ? -1 : (left->index > right->index ? 1 : 0);
+}
+
+/*Lowest conductance first, then in leaf order*/
+static int compare_candidates(const void *a, const void *b)
+{
+    const candidate_t *left = (const candidate_t *)a, *right = (const candidate_t *)b;
+    if (left->conductance != right->conductance)
+    {
+        return left->conductance < right->conductance ? -1 : 1;
+    }
+    return left->leaf < right->leaf ? -1 : (left->leaf > right->leaf ? 1 : 0);
+}
+
+static double dot(const size_t m, const double *x, const double *y)
+{
+    double sum = .0;
+    size_t i;
+    for (i = 0; i < m; i++)
+    {
+        sum += x[i] * y[i];
+    }
+    return sum;
+}
+
+/*x -= (x . u) u for a unit u*/
+static void project_out(const size_t m, double *x, const double *u)
+{
+    const double projection = dot(m, x, u);
+    size_t i;
+    for (i = 0; i < m; i++)
+    {
+        x[i] -= projection * u[i];
+    }
+}
+
+static error_e init_subgraph(subgraph_t *graph, point_t *points, size_t *order, const size_t m, const size_t dim)
+{
+    size_t i, j;
+    memset(graph, 0, sizeof(subgraph_t));
+    graph->m = m;
+    graph->dim = dim;
+    graph->points = (point_t *)malloc(m * sizeof(point_t));
+    graph->degrees = (double *)malloc(m * sizeof(double));
+    if (NULL == graph->points || NULL == graph->degrees)
+    {
+        return MALLOC_ERROR;
+    }
+    for (i = 0; i < m; i++)
+    {
+        graph->points[i] = points[order[i]];
+    }
+    if (m > BISECT_DENSE_MAX)
+    {
+        if (lnorm_operator_init(&graph->op, m, graph->points, dim) != 0)
+        {
+            return MALLOC_ERROR;
+        }
+        graph->scale = graph->op.scale;
+        for (i = 0; i < m; i++)
+        {
+            graph->degrees[i] = 1 / (graph->scale[i] * graph->scale[i]);
+        }
+        return OK;
+    }
+    graph->w = (double **)malloc_matrix(m, m, sizeof(double));
+    graph->scale = (double *)malloc(m * sizeof(double));
+    graph->scaled = (double *)malloc(m * sizeof(double));
+    if (NULL == graph->w || NULL == graph->scale || NULL == graph->scaled || OK != calc_weight_matrix(m, graph->points, dim, graph->w))
+    {
+        return MALLOC_ERROR;
+    }
+    for (i = 0; i < m; i++)
+    {
+        graph->degrees[i] = .0;
+        for (j = 0; j < m; j++)
+        {
+            graph->degrees[i] += graph->w[i][j];
+        }
+        graph->scale[i] = graph->degrees[i] > .0 ? 1 / sqrt(graph->degrees[i]) : .0;
+    }
+    return OK;
+}
+
+static void free_subgraph(subgraph_t *graph)
+{
+    if (NULL != graph->w)
+    {
+        free_matrix(graph->m, (void **)graph->w);
+    }
+    if (NULL != graph->op.scale)
+    {
+        lnorm_operator_free(&graph->op);
+    }
+    else
+    {
+        free(graph->scale);
+    }
+    free(graph->scaled);
+    free(graph->degrees);
+    free(graph->points);
+}
+
+static void product_task(void *arg, const size_t block)
+{
+    product_job_t *job = (product_job_t *)arg;
+    subgraph_t *graph = job->graph;
+    const size_t end = (block + 1) * BISECT_ROW_GRAIN < graph->m ? (block + 1) * BISECT_ROW_GRAIN : graph->m;
+    size_t i;
+    for (i = block * BISECT_ROW_GRAIN; i < end; i++)
+    {
+        job->y[i] = job->x[i] - graph->scale[i] * dot(graph->m, graph->w[i], graph->scaled);
+    }
+}
+
+/*y = L_norm x*/
+static int apply_lnorm(subgraph_t *graph, double *x, double *y)
+{
+    product_job_t job;
+    size_t i;
+    if (NULL == graph->w)
+    {
+        return lnorm_operator_apply(&graph->op, 1, &x, &y);
+    }
+    for (i = 0; i < graph->m; i++)
+    {
+        graph->scaled[i] = graph->scale[i] * x[i];
+    }
+    job.graph = graph;
+    job.x = x;
+    job.y = y;
+    return parallel_for((graph->m + BISECT_ROW_GRAIN - 1) / BISECT_ROW_GRAIN, product_task, &job);
+}
+
+/*
+ * The unit eigenvector 'v' of the second smallest eigenvalue of L_norm and that eigenvalue, by Lanczos runs on
+ * the complement of u0 = D^1/2 1 / |D^1/2 1|, each restarted from the previous Ritz vector, with full
+ * reorthogonalization. The Ritz values of the tridiagonal projection come from the QL solver.
+ */
+static error_e find_fiedler(subgraph_t *graph, double *v, double *value)
+{
+    const size_t m = graph->m, steps_max = m - 1 < BISECT_LANCZOS_STEPS ? m - 1 : BISECT_LANCZOS_STEPS;
+    error_e result = MALLOC_ERROR;
+    double *u0, *alpha, *beta, *basis, *next, norm, residual;
+    double **tridiagonal;
+    eigen_t *eigens;
+    size_t restart, steps, i, j, pass, smallest;
+
+    u0 = (double *)malloc(m * sizeof(double));
+    alpha = (double *)malloc(steps_max * sizeof(double));
+    beta = (double *)malloc((steps_max + 1) * sizeof(double));
+    basis = (double *)malloc((steps_max + 1) * m * sizeof(double));
+    tridiagonal = (double **)malloc_matrix(steps_max, steps_max, sizeof(double));
+    eigens = malloc_eigens(steps_max);
+    if (NULL == u0 || NULL == alpha || NULL == beta || NULL == basis || NULL == tridiagonal || NULL == eigens)
+    {
+        goto cleanup;
+    }
+    for (i = 0; i < m; i++)
+    {
+        u0[i] = graph->scale[i] > .0 ? 1 / graph->scale[i] : .0;
+        v[i] = (double)((i * 2654435761UL) % 1000) / 1000 - .5; /* A fixed start with no structure of its own */
+    }
+    norm = sqrt(dot(m, u0, u0));
+    for (i = 0; i < m; i++)
+    {
+        u0[i] /= norm;
+    }
+
+    for (restart = 0; restart <= BISECT_MAX_RESTARTS; restart++)
+    {
+        memcpy(basis, v, m * sizeof(double));
+        project_out(m, basis, u0);
+        norm = sqrt(dot(m, basis, basis));
+        for (i = 0; i < m; i++)
+        {
+            basis[i] /= norm;
+        }
+        beta[0] = .0;
+        for (steps = 0; steps < steps_max;)
+        {
+            next = basis + (steps + 1) * m;
+            if (apply_lnorm(graph, basis + steps * m, next) != 0)
+            {
+                goto cleanup;
+            }
+            alpha[steps] = dot(m, basis + steps * m, next);
+            for (pass = 0; pass < 2; pass++) /* Twice is enough, as the first pass leaves only rounding behind */
+            {
+                project_out(m, next, u0);
+                for (j = 0; j <= steps; j++)
+                {
+                    project_out(m, next, basis + j * m);
+                }
+            }
+            beta[++steps] = sqrt(dot(m, next, next));
+            if (beta[steps] <= BISECT_TOLERANCE * BISECT_TOLERANCE)
+            {
+                break; /* The Krylov space is invariant, so its Ritz pairs are exact */
+            }
+            for (i = 0; i < m; i++)
+            {
+                next[i] /= beta[steps];
+            }
+        }
+
+        for (i = 0; i < steps; i++)
+        {
+            for (j = 0; j < steps; j++)
+            {
+                tridiagonal[i][j] = i == j ? alpha[i] : (i == j + 1 ? beta[i] : (j == i + 1 ? beta[j] : .0));
+            }
+        }
+        if (1 == steps)
+        {
+            eigens[0].value = alpha[0];
+            eigens[0].vector[0] = 1;
+        }
+        else if (tridiag_eigens(steps, tridiagonal, eigens) != 0)
+        {
+            goto cleanup;
+        }
+        smallest = 0;
+        for (j = 1; j < steps; j++)
+        {
+            smallest = eigens[j].value < eigens[smallest].value ? j : smallest;
+        }
+        *value = eigens[smallest].value;
+        for (i = 0; i < m; i++)
+        {
+            v[i] = .0;
+        }
+        for (j = 0; j < steps; j++)
+        {
+            for (i = 0; i < m; i++)
+            {
+                v[i] += eigens[smallest].vector[j] * basis[j * m + i];
+            }
+        }
+        norm = sqrt(dot(m, v, v));
+        for (i = 0; i < m; i++)
+        {
+            v[i] /= norm;
+        }
+        residual = fabs(beta[steps] * eigens[smallest].vector[steps - 1]);
+        if (residual <= BISECT_TOLERANCE || steps < steps_max)
+        {
+            break;
+        }
+    }
+    result = OK;
+
+cleanup:
+    if (NULL != eigens)
+    {
+        free_eigens(steps_max, eigens);
+    }
+    if (NULL != tridiagonal)
+    {
+        free_matrix(steps_max, (void **)tridiagonal);
+    }
+    free(basis);
+    free(beta);
+    free(alpha);
+    free(u0);
+    return result;
+}
+
+/*
+ * The prefix of the points sorted by D^-1/2 v with the lowest conductance among those leaving 'min_size' points
+ * on each side, or rather the most balanced prefix within BISECT_BALANCE_SLACK of it: well separated groups give
+ * many cuts of conductance near 0, and peeling them off one at a time would cost a Fiedler vector of almost the
+ * whole cluster per group. Adding point u to the prefix S changes the cut by d_u - 2 * sum over S of w_uj.
+ */
+static void sweep_cut(subgraph_t *graph, sweep_key_t *keys, double *phi, const size_t min_size, size_t *cut, double *conductance)
+{
+    const size_t m = graph->m;
+    double volume = .0, prefix_volume = .0, cut_weight = .0, lowest = HUGE_VAL, inside, smaller;
+    size_t p, q, u, balance = 0;
+
+    for (p = 0; p < m; p++)
+    {
+        volume += graph->degrees[p];
+    }
+    for (p = 0; p + 1 < m; p++)
+    {
+        u = keys[p].index;
+        inside = .0;
+        for (q = 0; q < p; q++)
+        {
+            inside += NULL != graph->w ? graph->w[u][keys[q].index] : calc_weight(graph->points[u], graph->points[keys[q].index], graph->dim);
+        }
+        cut_weight += graph->degrees[u] - 2 * inside;
+        prefix_volume += graph->degrees[u];
+        smaller = prefix_volume < volume - prefix_volume ? prefix_volume : volume - prefix_volume;
+        phi[p] = p + 1 >= min_size && m - p - 1 >= min_size && smaller > .0 ? (cut_weight > .0 ? cut_weight : .0) / smaller : HUGE_VAL;
+        lowest = phi[p] < lowest ? phi[p] : lowest;
+    }
+    *cut = 0;
+    *conductance = lowest;
+    for (p = 0; p + 1 < m && lowest < HUGE_VAL; p++)
+    {
+        if (phi[p] <= lowest + BISECT_BALANCE_SLACK && (p + 1 < m - p - 1 ? p + 1 : m - p - 1) > balance)
+        {
+            balance = p + 1 < m - p - 1 ? p + 1 : m - p - 1;
+            *cut = p + 1;
+            *conductance = phi[p];
+        }
+    }
+}
+
+static void split_task(void *arg, const size_t index)
+{
+    split_job_t *job = (split_job_t *)arg + index;
+    const size_t m = job->end - job->begin;
+    subgraph_t graph;
+    sweep_key_t *keys = NULL;
+    size_t *reordered = NULL, i;
+    double *v = NULL, *phi = NULL;
+
+    job->cut = 0;
+    job->status = init_subgraph(&graph, job->points, job->order + job->begin, m, job->dim);
+    if (OK != job->status)
+    {
+        goto cleanup;
+    }
+    job->status = MALLOC_ERROR;
+    v = (double *)malloc(m * sizeof(double));
+    keys = (sweep_key_t *)malloc(m * sizeof(sweep_key_t));
+    reordered = (size_t *)malloc(m * sizeof(size_t));
+    phi = (double *)malloc(m * sizeof(double));
+    if (NULL == v || NULL == keys || NULL == reordered || NULL == phi || OK != find_fiedler(&graph, v, &job->fiedler))
+    {
+        goto cleanup;
+    }
+    for (i = 0; i < m; i++)
+    {
+        keys[i].key = graph.scale[i] * v[i];
+        keys[i].index = i;
+    }
+    qsort(keys, m, sizeof(sweep_key_t), compare_keys);
+    sweep_cut(&graph, keys, phi, job->min_size, &job->cut, &job->conductance);
+    if (0 == job->cut || job->conductance > job->max_conductance)
+    {
+        job->cut = 0;
+    }
+    else
+    {
+        for (i = 0; i < m; i++)
+        {
+            reordered[i] = job->order[job->begin + keys[i].index];
+        }
+        memcpy(job->order + job->begin, reordered, m * sizeof(size_t));
+    }
+    job->status = OK;
+
+cleanup:
+    free(phi);
+    free(reordered);
+    free(keys);
+    free(v);
+    free_subgraph(&graph);
+}
+
+/*
+ * Labels the n points with up to k clusters (as many as the thresholds allow when k is 0) and stores the
+ * splits made, at most max(k, n) - 1 of them, in 'splits'. Cluster 0 is the root; the i-th split moves one
+ * side of its cluster into the new cluster i + 1.
+ */
+error_e bisect_labels(const size_t n, point_t *points, const size_t dim, const size_t k, const size_t min_size, const double max_conductance, size_t *labels, size_t *clusters_len, bisect_split_t *splits)
+{
+    const size_t wanted = 0 == k ? n : k;
+    error_e result = MALLOC_ERROR;
+    leaf_t *leaves;
+    candidate_t *candidates;
+    split_job_t *jobs;
+    size_t *order, leaves_len = 1, count, i, l;
+
+    if (0 == n || k > n || 0 == min_size)
+    {
+        return INVALID_INPUT;
+    }
+    order = (size_t *)malloc(n * sizeof(size_t));
+    leaves = (leaf_t *)malloc(wanted * sizeof(leaf_t));
+    candidates = (candidate_t *)malloc(wanted * sizeof(candidate_t));
+    jobs = (split_job_t *)malloc(wanted * sizeof(split_job_t));
+    if (NULL == order || NULL == leaves || NULL == candidates || NULL == jobs)
+    {
+        goto cleanup;
+    }
+    for (i = 0; i < n; i++)
+    {
+        order[i] = i;
+    }
+    leaves[0].begin = 0;
+    leaves[0].end = n;
+    leaves[0].state = UNSPLIT_LEAF;
+
+    while (leaves_len < wanted)
+    {
+        count = 0;
+        for (l = 0; l < leaves_len; l++) /* The best cut of every new cluster, each on its own worker */
+        {
+            if (UNSPLIT_LEAF == leaves[l].state && leaves[l].end - leaves[l].begin < 2 * min_size)
+            {
+                leaves[l].state = FINAL_LEAF;
+            }
+            if (UNSPLIT_LEAF == leaves[l].state)
+            {
+                jobs[count].points = points;
+                jobs[count].dim = dim;
+                jobs[count].order = order;
+                jobs[count].leaf = l;
+                jobs[count].begin = leaves[l].begin;
+                jobs[count].end = leaves[l].end;
+                jobs[count].min_size = min_size;
+                jobs[count++].max_conductance = max_conductance;
+            }
+        }
+        if (parallel_for(count, split_task, jobs) != 0)
+        {
+            goto cleanup;
+        }
+        for (i = 0; i < count; i++)
+        {
+            if (OK != jobs[i].status)
+            {
+                result = jobs[i].status;
+                goto cleanup;
+            }
+            l = jobs[i].leaf;
+            leaves[l].state = 0 == jobs[i].cut ? FINAL_LEAF : CUT_LEAF;
+            leaves[l].cut = jobs[i].cut;
+            leaves[l].conductance = jobs[i].conductance;
+            leaves[l].fiedler = jobs[i].fiedler;
+        }
+
+        count = 0;
+        for (l = 0; l < leaves_len; l++)
+        {
+            if (CUT_LEAF == leaves[l].state)
+            {
+                candidates[count].conductance = leaves[l].conductance;
+                candidates[count++].leaf = l;
+            }
+        }
+        if (0 == count)
+        {
+            break;
+        }
+        qsort(candidates, count, sizeof(candidate_t), compare_candidates);
+        count = count < wanted - leaves_len ? count : wanted - leaves_len;
+        for (i = 0; i < count && candidates[i].conductance <= candidates[0].conductance + BISECT_BATCH_SLACK; i++)
+        {
+            l = candidates[i].leaf;
+            splits[leaves_len - 1].cluster = l;
+            splits[leaves_len - 1].size = leaves[l].end - leaves[l].begin - leaves[l].cut; /* The side that moves */
+            splits[leaves_len - 1].conductance = leaves[l].conductance;
+            splits[leaves_len - 1].fiedler = leaves[l].fiedler;
+            leaves[leaves_len].begin = leaves[l].begin + leaves[l].cut;
+            leaves[leaves_len].end = leaves[l].end;
+            leaves[leaves_len].state = UNSPLIT_LEAF;
+            leaves[l].end = leaves[leaves_len].begin;
+            leaves[l].state = UNSPLIT_LEAF;
+            leaves_len++;
+        }
+    }
+
+    for (l = 0; l < leaves_len; l++)
+    {
+        for (i = leaves[l].begin; i < leaves[l].end; i++)
+        {
+            labels[order[i]] = l;
+        }
+    }
+    *clusters_len = leaves_len;
+    result = OK;
+
+cleanup:
+    free(jobs);
+    free(candidates);
+    free(leaves);
+    free(order);
+    return result;
+}
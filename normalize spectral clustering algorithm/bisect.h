@@ -0,0 +1,27 @@
+#ifndef BISECT_H
+#define BISECT_H
+
+#include <stdlib.h>
+#include "point.h"
+#include "spkmeans.h"
+
+#define BISECT_DENSE_MAX 4096        /* Larger subgraphs regenerate W on every product instead of keeping it */
+#define BISECT_LANCZOS_STEPS 48      /* Krylov vectors per Lanczos run */
+#define BISECT_MAX_RESTARTS 0        /* Runs restarted from the last Ritz vector; converging pulls it onto one of many groups */
+#define BISECT_TOLERANCE 1e-8        /* Residual norm of a converged Fiedler vector */
+#define BISECT_ROW_GRAIN 64          /* Rows per task of the dense products */
+#define BISECT_BATCH_SLACK 0.05      /* Cuts made in one round exceed the round's lowest conductance by at most this */
+#define BISECT_BALANCE_SLACK 1e-3    /* A cut may exceed the lowest conductance of its cluster by this to be more balanced */
+
+/*The i-th split of the hierarchy, which moved one side of cluster 'cluster' into the new cluster i + 1*/
+typedef struct bisect_split_t
+{
+    size_t cluster;
+    size_t size;
+    double conductance; /* cut / min(vol S, vol of the rest), of the best sweep cut */
+    double fiedler;     /* Second smallest eigenvalue of the cluster's L_norm */
+} bisect_split_t;
+
+error_e bisect_labels(const size_t n, point_t *points, const size_t dim, const size_t k, const size_t min_size, const double max_conductance, size_t *labels, size_t *clusters_len, bisect_split_t *splits);
+
+#endif /* BISECT_H */
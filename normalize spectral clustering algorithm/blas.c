@@ -0,0 +1,328 @@
+/*
+ * The dense kernels routed to a system BLAS/LAPACK when the build found one (see comp.sh and setup.py).
+ * Our matrices are row-major arrays of row pointers while BLAS is column-major, so a row-major product
+ * C = A * B is passed as the column-major C^T = B^T * A^T, which needs no transposition at all. Operands
+ * whose rows are not one block are packed into one first.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include "blas.h"
+#include "options.h"
+
+#ifdef SPKM_HAVE_LAPACK
+
+extern void dgemm_(const char *transa, const char *transb, const int *m, const int *n, const int *k, const double *alpha,
+                   const double *a, const int *lda, const double *b, const int *ldb, const double *beta, double *c, const int *ldc);
+extern void dsyevr_(const char *jobz, const char *range, const char *uplo, const int *n, double *a, const int *lda,
+                    const double *vl, const double *vu, const int *il, const int *iu, const double *abstol, int *m,
+                    double *w, double *z, const int *ldz, int *isuppz, double *work, const int *lwork, int *iwork,
+                    const int *liwork, int *info);
+
+int blas_enabled(void)
+{
+    options_t options;
+    load_options(&options);
+    return BLAS_BACKEND == options.backend;
+}
+
+/*TRUE when the rows of mat follow each other in one block*/
+static int is_block(const size_t rows, const size_t cols, double **mat)
+{
+    size_t i;
+    for (i = 1; i < rows; i++)
+    {
+        if (mat[i] != mat[0] + i * cols)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*The rows of mat as one rows x cols block: the matrix's own storage when it already is one, else a copy*/
+static double *pack(const size_t rows, const size_t cols, double **mat)
+{
+    size_t i;
+    double *packed;
+    if (is_block(rows, cols, mat))
+    {
+        return mat[0];
+    }
+    packed = (double *)malloc((rows * cols > 0 ? rows * cols : 1) * sizeof(double));
+    for (i = 0; NULL != packed && i < rows; i++)
+    {
+        memcpy(packed + i * cols, mat[i], cols * sizeof(double));
+    }
+    return packed;
+}
+
+static void release(double *packed, double **mat)
+{
+    if (packed != mat[0])
+    {
+        free(packed);
+    }
+}
+
+/*n*m times m*p (or, when transposed, n*m times the transpose of a p*m matrix) into the n*p 'result'*/
+int blas_multiply(const size_t n, const size_t m, const size_t p, double **left_mat, double **right_mat, double **result, const int transposed)
+{
+    int status = 1, rows, inner, cols;
+    const double one = 1.0, zero = .0;
+    double *left, *right, *product;
+    size_t i;
+
+    if ((double)n * m * p < (double)BLAS_MIN_PRODUCT * BLAS_MIN_PRODUCT * BLAS_MIN_PRODUCT ||
+        n > INT_MAX || m > INT_MAX || p > INT_MAX || !blas_enabled())
+    {
+        return 1;
+    }
+    rows = (int)n;
+    inner = (int)m;
+    cols = (int)p;
+    left = pack(n, m, left_mat);
+    if (NULL == left)
+    {
+        goto end;
+    }
+    right = transposed ? pack(p, m, right_mat) : pack(m, p, right_mat);
+    if (NULL == right)
+    {
+        goto left_cleanup;
+    }
+    product = result[0];
+    if (!is_block(n, p, result) || product == left || product == right) /* dgemm may not write over its operands */
+    {
+        product = (double *)malloc(n * p * sizeof(double));
+    }
+    if (NULL == product)
+    {
+        goto right_cleanup;
+    }
+
+    dgemm_(transposed ? "T" : "N", "N", &cols, &rows, &inner, &one, right, transposed ? &inner : &cols, left, &inner, &zero, product, &cols);
+    for (i = 0; product != result[0] && i < n; i++)
+    {
+        memcpy(result[i], product + i * p, p * sizeof(double));
+    }
+    status = 0;
+
+    release(product, result);
+right_cleanup:
+    release(right, right_mat);
+left_cleanup:
+    release(left, left_mat);
+end:
+    return status;
+}
+
+/*The 'count' largest eigenpairs of the symmetric mat, largest first, from dsyevr (relatively robust representations)*/
+static int syevr_top(const size_t n, double **mat, const size_t count, eigen_t *eigens)
+{
+    int status = 1, order, lower, upper, found, lwork = -1, liwork = -1, iwork_query, info, *isuppz, *iwork;
+    const double bound = .0, abstol = .0; /* A zero tolerance lets LAPACK pick the most accurate one */
+    double *a, *values, *vectors, *work, work_query;
+    size_t i;
+
+    if (n > INT_MAX || 0 == count)
+    {
+        return 1;
+    }
+    order = (int)n;
+    lower = (int)(n - count + 1);
+    upper = order;
+    a = (double *)malloc((n * n + n + n * count) * sizeof(double));
+    if (NULL == a)
+    {
+        goto end;
+    }
+    values = a + n * n;
+    vectors = values + n;
+    isuppz = (int *)malloc(2 * count * sizeof(int));
+    if (NULL == isuppz)
+    {
+        goto a_cleanup;
+    }
+    for (i = 0; i < n; i++)
+    {
+        memcpy(a + i * n, mat[i], n * sizeof(double)); /* dsyevr overwrites its input; symmetry makes the layout moot */
+    }
+
+    dsyevr_("V", "I", "U", &order, a, &order, &bound, &bound, &lower, &upper, &abstol, &found, values, vectors, &order,
+            isuppz, &work_query, &lwork, &iwork_query, &liwork, &info);
+    if (0 != info)
+    {
+        goto isuppz_cleanup;
+    }
+    lwork = (int)work_query;
+    liwork = iwork_query;
+    work = (double *)malloc(lwork * sizeof(double));
+    if (NULL == work)
+    {
+        goto isuppz_cleanup;
+    }
+    iwork = (int *)malloc(liwork * sizeof(int));
+    if (NULL == iwork)
+    {
+        goto work_cleanup;
+    }
+    dsyevr_("V", "I", "U", &order, a, &order, &bound, &bound, &lower, &upper, &abstol, &found, values, vectors, &order,
+            isuppz, work, &lwork, iwork, &liwork, &info);
+    if (0 == info && (size_t)found == count)
+    {
+        for (i = 0; i < count; i++)
+        {
+            eigens[i].value = values[count - 1 - i]; /* dsyevr returns them in ascending order */
+            memcpy(eigens[i].vector, vectors + (count - 1 - i) * n, n * sizeof(double));
+        }
+        status = 0;
+    }
+
+    free(iwork);
+work_cleanup:
+    free(work);
+isuppz_cleanup:
+    free(isuppz);
+a_cleanup:
+    free(a);
+end:
+    return status;
+}
+
+/*All n eigenpairs, largest first, with the same contract as jacobi()*/
+int blas_eigens(const size_t n, double **mat, eigen_t *eigens)
+{
+    if (!blas_enabled())
+    {
+        return 1;
+    }
+    return syevr_top(n, mat, n, eigens);
+}
+
+/*The same contract as tridiag_top_eigens(): only the eigenpairs the caller reads are computed*/
+int blas_top_eigens(const size_t n, double **mat, eigen_t *eigens, size_t *k)
+{
+    size_t needed = 0 == *k ? n / 2 + 1 : *k;
+    if (!blas_enabled())
+    {
+        return 1;
+    }
+    if (syevr_top(n, mat, needed > n ? n : needed, eigens) != 0)
+    {
+        return 1;
+    }
+    if (0 == *k)
+    {
+        *k = find_eigengap_max(n, eigens);
+    }
+    return 0;
+}
+
+/*
+ * Euclidean distances above the diagonal of dist_mat from the Gram matrix: |x - y|^2 = |x|^2 + |y|^2 - 2 x.y,
+ * formed a block of rows at a time, and only right of the diagonal. The subtraction cancels for close pairs,
+ * so it is only used from BLAS_GRAM_MIN_DIM dimensions, where the products dominate.
+ */
+int blas_distances(const size_t n, point_t *points, const size_t dim, double **dist_mat)
+{
+    int status = 1, rows, cols, inner;
+    const double one = 1.0, zero = .0;
+    double *elements, *copy = NULL, *norms, *gram, squared;
+    size_t i, j, start, width;
+
+    if (n > INT_MAX || dim > INT_MAX || (double)n * BLAS_GRAM_BLOCK > INT_MAX || !blas_enabled())
+    {
+        return 1;
+    }
+    inner = (int)dim;
+    norms = (double *)malloc((n + BLAS_GRAM_BLOCK * n) * sizeof(double));
+    if (NULL == norms)
+    {
+        goto end;
+    }
+    gram = norms + n;
+    elements = points[0].elements;
+    for (i = 1; i < n && points[i].elements == elements + i * dim; i++)
+    {
+    }
+    if (i < n) /* Points that do not share one block are copied into one */
+    {
+        copy = (double *)malloc(n * dim * sizeof(double));
+        if (NULL == copy)
+        {
+            goto norms_cleanup;
+        }
+        for (i = 0; i < n; i++)
+        {
+            memcpy(copy + i * dim, points[i].elements, dim * sizeof(double));
+        }
+        elements = copy;
+    }
+    for (i = 0; i < n; i++)
+    {
+        norms[i] = .0;
+        for (j = 0; j < dim; j++)
+        {
+            norms[i] += points[i].elements[j] * points[i].elements[j];
+        }
+    }
+
+    for (start = 0; start < n; start += BLAS_GRAM_BLOCK)
+    {
+        width = n - start;
+        rows = (int)(width < BLAS_GRAM_BLOCK ? width : BLAS_GRAM_BLOCK);
+        cols = (int)width;
+        dgemm_("T", "N", &cols, &rows, &inner, &one, elements + start * dim, &inner, elements + start * dim, &inner, &zero, gram, &cols);
+        for (i = 0; i < (size_t)rows; i++)
+        {
+            for (j = i + 1; j < width; j++)
+            {
+                squared = norms[start + i] + norms[start + j] - 2.0 * gram[i * width + j];
+                dist_mat[start + i][start + j] = squared > .0 ? sqrt(squared) : .0;
+            }
+        }
+    }
+    status = 0;
+
+    free(copy);
+norms_cleanup:
+    free(norms);
+end:
+    return status;
+}
+
+#else /* Built without LAPACK: every caller keeps its native code */
+
+int blas_enabled(void)
+{
+    return 0;
+}
+
+int blas_multiply(const size_t n, const size_t m, const size_t p, double **left_mat, double **right_mat, double **result, const int transposed)
+{
+    (void)n, (void)m, (void)p, (void)left_mat, (void)right_mat, (void)result, (void)transposed;
+    return 1;
+}
+
+int blas_eigens(const size_t n, double **mat, eigen_t *eigens)
+{
+    (void)n, (void)mat, (void)eigens;
+    return 1;
+}
+
+int blas_top_eigens(const size_t n, double **mat, eigen_t *eigens, size_t *k)
+{
+    (void)n, (void)mat, (void)eigens, (void)k;
+    return 1;
+}
+
+int blas_distances(const size_t n, point_t *points, const size_t dim, double **dist_mat)
+{
+    (void)n, (void)points, (void)dim, (void)dist_mat;
+    return 1;
+}
+
+#endif /* SPKM_HAVE_LAPACK */
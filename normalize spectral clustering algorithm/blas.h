@@ -0,0 +1,23 @@
+#ifndef BLAS_H
+#define BLAS_H
+
+#include <stdlib.h>
+#include "eigen.h"
+#include "point.h"
+
+#define BLAS_MIN_PRODUCT 32  /* Products of fewer than BLAS_MIN_PRODUCT^3 multiply-adds stay native, packing would cost more */
+#define BLAS_GRAM_MIN_DIM 32 /* Smaller dimensions keep the exact per-pair distance kernels */
+#define BLAS_GRAM_BLOCK 64   /* Rows of the Gram matrix formed per dgemm call */
+
+/*
+ * Every routine returns 0 when it did the work and non-zero when the caller should run its native code
+ * instead: when the tree was built without SPKM_HAVE_LAPACK, when SPKM_BACKEND is "native", when the
+ * sizes do not fit a Fortran integer, or when LAPACK itself fails.
+ */
+int blas_enabled(void);
+int blas_multiply(const size_t n, const size_t m, const size_t p, double **left_mat, double **right_mat, double **result, const int transposed);
+int blas_eigens(const size_t n, double **mat, eigen_t *eigens);
+int blas_top_eigens(const size_t n, double **mat, eigen_t *eigens, size_t *k);
+int blas_distances(const size_t n, point_t *points, const size_t dim, double **dist_mat);
+
+#endif /* BLAS_H */
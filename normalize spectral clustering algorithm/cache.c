@@ -0,0 +1,179 @@
+/*A persistent cache of sorted eigendecompositions, keyed by the input points and the solver parameters*/
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cache.h"
+#include "jacobi.h"
+#include "blas.h"
+
+/*FNV-1a hash, chained through 'hash' so several buffers can be combined into one key*/
+unsigned long hash_bytes(unsigned long hash, const void *data, const size_t len)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    size_t i;
+    for (i = 0; i < len; i++)
+    {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/*The key covers the shape, every coordinate, the eigen solver, the affinity threshold and the Jacobi stopping conditions*/
+unsigned long cache_key(const size_t n, point_t *points, const size_t dim, const options_t *options)
+{
+    int solver = options->eigen_solver, exp_kernel = options->exp_kernel, backend = blas_enabled();
+    unsigned long hash = FNV_OFFSET;
+    unsigned long max_iterations = JACOBI_MAX_ITERATIONS;
+    double epsilon = JACOBI_EPSILON;
+    size_t i;
+
+    hash = hash_bytes(hash, &n, sizeof(n));
+    hash = hash_bytes(hash, &dim, sizeof(dim));
+    for (i = 0; i < n; i++)
+    {
+        hash = hash_bytes(hash, points[i].elements, dim * sizeof(double));
+    }
+    hash = hash_bytes(hash, &solver, sizeof(solver));
+    hash = hash_bytes(hash, &exp_kernel, sizeof(exp_kernel));
+    hash = hash_bytes(hash, &backend, sizeof(backend));
+    hash = hash_bytes(hash, &options->affinity_threshold, sizeof(options->affinity_threshold));
+    hash = hash_bytes(hash, &options->index_epsilon, sizeof(options->index_epsilon));
+    hash = hash_bytes(hash, &options->exp_flush, sizeof(options->exp_flush));
+    hash = hash_bytes(hash, &max_iterations, sizeof(max_iterations));
+    hash = hash_bytes(hash, &epsilon, sizeof(epsilon));
+    return hash;
+}
+
+/*Builds "<dir>/<key><suffix>"; the caller frees the result*/
+static char *cache_path(const char *dir, const unsigned long key, const char *suffix)
+{
+    char *path = malloc(strlen(dir) + strlen(suffix) + 2 + 2 * sizeof(unsigned long) + 16);
+    if (NULL == path)
+    {
+        return NULL;
+    }
+    sprintf(path, "%s/%0*lx%s", dir, (int)(2 * sizeof(unsigned long)), key, suffix);
+    return path;
+}
+
+/*Maps the cache file of 'key' and copies its eigenpairs into 'eigens'. Returns 0 on a hit*/
+int cache_load(const char *dir, const unsigned long key, const size_t n, const size_t dim, eigen_t *eigens)
+{
+    int result = -1, fd;
+    char *path;
+    struct stat file_stat;
+    size_t i, size;
+    void *map;
+    const cache_header_t *header;
+    const double *values, *vectors;
+
+    path = cache_path(dir, key, CACHE_FILE_SUFFIX);
+    if (NULL == path)
+    {
+        goto end;
+    }
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        goto path_cleanup;
+    }
+    size = sizeof(cache_header_t) + (n + n * n) * sizeof(double);
+    if (fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size != size)
+    {
+        goto fd_cleanup;
+    }
+    map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == map)
+    {
+        goto fd_cleanup;
+    }
+
+    header = (const cache_header_t *)map;
+    if (memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 && CACHE_VERSION == header->version &&
+        key == header->key && n == header->n && dim == header->dim) /* Guards against stale files and key collisions */
+    {
+        values = (const double *)(header + 1);
+        vectors = values + n;
+        for (i = 0; i < n; i++)
+        {
+            eigens[i].value = values[i];
+            memcpy(eigens[i].vector, vectors + i * n, n * sizeof(double));
+        }
+        result = 0;
+    }
+
+    munmap(map, size);
+fd_cleanup:
+    close(fd);
+path_cleanup:
+    free(path);
+end:
+    return result;
+}
+
+/*Writes the sorted eigenpairs to a temporary file and renames it into place, so readers never see a partial file*/
+int cache_store(const char *dir, const unsigned long key, const size_t n, const size_t dim, eigen_t *eigens)
+{
+    int result = -1;
+    char *path, *tmp_path, suffix[32];
+    FILE *file;
+    cache_header_t header;
+    size_t i, written;
+
+    path = cache_path(dir, key, CACHE_FILE_SUFFIX);
+    if (NULL == path)
+    {
+        goto end;
+    }
+    sprintf(suffix, "%s.%ld.tmp", CACHE_FILE_SUFFIX, (long)getpid());
+    tmp_path = cache_path(dir, key, suffix);
+    if (NULL == tmp_path)
+    {
+        goto path_cleanup;
+    }
+    file = fopen(tmp_path, "wb");
+    if (NULL == file)
+    {
+        goto tmp_path_cleanup;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.key = key;
+    header.n = n;
+    header.dim = dim;
+    written = fwrite(&header, sizeof(header), 1, file);
+    for (i = 0; i < n; i++)
+    {
+        written += fwrite(&eigens[i].value, sizeof(double), 1, file);
+    }
+    for (i = 0; i < n; i++)
+    {
+        written += fwrite(eigens[i].vector, sizeof(double), n, file) == n;
+    }
+
+    if (fclose(file) == 0 && 1 + 2 * n == written && rename(tmp_path, path) == 0)
+    {
+        result = 0;
+    }
+    else
+    {
+        remove(tmp_path);
+    }
+
+tmp_path_cleanup:
+    free(tmp_path);
+path_cleanup:
+    free(path);
+end:
+    return result;
+}
@@ -0,0 +1,30 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdlib.h>
+#include "eigen.h"
+#include "point.h"
+#include "options.h"
+
+#define CACHE_MAGIC "SPKMEIG"
+#define CACHE_VERSION 1
+#define CACHE_FILE_SUFFIX ".eig"
+#define FNV_OFFSET 0xcbf29ce484222325UL /* Initial 'hash' of hash_bytes() */
+#define FNV_PRIME 0x100000001b3UL
+
+/*On-disk layout: the header, then n eigenvalues, then n eigenvectors of n doubles each (sorted order)*/
+typedef struct cache_header_t
+{
+    char magic[8];
+    unsigned long version;
+    unsigned long key;
+    unsigned long n;
+    unsigned long dim;
+} cache_header_t;
+
+unsigned long hash_bytes(unsigned long hash, const void *data, const size_t len);
+unsigned long cache_key(const size_t n, point_t *points, const size_t dim, const options_t *options);
+int cache_load(const char *dir, const unsigned long key, const size_t n, const size_t dim, eigen_t *eigens);
+int cache_store(const char *dir, const unsigned long key, const size_t n, const size_t dim, eigen_t *eigens);
+
+#endif /* CACHE_H */
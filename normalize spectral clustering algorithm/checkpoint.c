@@ -0,0 +1,179 @@
+/*
+ * Periodic snapshots of long-running loops, so a run killed halfway resumes where it stopped. A snapshot is
+ * keyed like the eigen cache, by a hash of everything the loop started from, and is written the same way:
+ * to a temporary file renamed into place, so a crash while writing leaves the previous snapshot intact.
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "checkpoint.h"
+#include "cache.h"
+#include "options.h"
+
+int checkpoint_enabled(void)
+{
+    options_t options;
+    load_options(&options);
+    return NULL != options.checkpoint_dir;
+}
+
+/*Builds "<dir>/<key><suffix>"; the caller frees the result*/
+static char *checkpoint_path(const char *dir, const unsigned long key, const char *suffix)
+{
+    char *path = malloc(strlen(dir) + strlen(suffix) + 2 + 2 * sizeof(unsigned long) + 16);
+    if (NULL == path)
+    {
+        return NULL;
+    }
+    sprintf(path, "%s/%0*lx%s", dir, (int)(2 * sizeof(unsigned long)), key, suffix);
+    return path;
+}
+
+/*Prepares the snapshots of one loop. With SPKM_CHECKPOINT_DIR unset every other call is a no-op*/
+void checkpoint_open(checkpoint_t *checkpoint, const checkpoint_kind_e kind, const unsigned long key)
+{
+    options_t options;
+    const unsigned long kind_tag = kind;
+    load_options(&options);
+    checkpoint->kind = kind;
+    checkpoint->key = hash_bytes(key, &kind_tag, sizeof(kind_tag)); /* A Jacobi and a k-means snapshot never share a file */
+    checkpoint->interval = options.checkpoint_interval;
+    checkpoint->last_write = time(NULL);
+    checkpoint->path = NULL == options.checkpoint_dir ? NULL : checkpoint_path(options.checkpoint_dir, checkpoint->key, CHECKPOINT_FILE_SUFFIX);
+}
+
+/*Maps the snapshot of this loop, if there is one, and copies it into 'state' and 'mats'. Returns 0 on a hit*/
+int checkpoint_load(checkpoint_t *checkpoint, checkpoint_state_t *state, double ***mats, const size_t count, const size_t rows, const size_t cols)
+{
+    int result = -1, fd;
+    struct stat file_stat;
+    size_t m, i, size;
+    void *map;
+    const checkpoint_header_t *header;
+    const double *values;
+
+    if (NULL == checkpoint->path)
+    {
+        return -1;
+    }
+    fd = open(checkpoint->path, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    size = sizeof(checkpoint_header_t) + count * rows * cols * sizeof(double);
+    if (fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size != size)
+    {
+        goto fd_cleanup;
+    }
+    map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == map)
+    {
+        goto fd_cleanup;
+    }
+
+    header = (const checkpoint_header_t *)map;
+    if (memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) == 0 && CHECKPOINT_VERSION == header->version &&
+        (unsigned long)checkpoint->kind == header->kind && checkpoint->key == header->key && count == header->count &&
+        rows == header->rows && cols == header->cols)
+    {
+        *state = header->state;
+        values = (const double *)(header + 1);
+        for (m = 0; m < count; m++)
+        {
+            for (i = 0; i < rows; i++)
+            {
+                memcpy(mats[m][i], values + (m * rows + i) * cols, cols * sizeof(double));
+            }
+        }
+        result = 0;
+    }
+
+    munmap(map, size);
+fd_cleanup:
+    close(fd);
+    return result;
+}
+
+/*TRUE once SPKM_CHECKPOINT_INTERVAL seconds have passed since the last snapshot*/
+int checkpoint_due(checkpoint_t *checkpoint)
+{
+    return NULL != checkpoint->path && difftime(time(NULL), checkpoint->last_write) >= checkpoint->interval;
+}
+
+/*Replaces the snapshot of this loop. A failed write only costs a restarted run some of its progress*/
+int checkpoint_save(checkpoint_t *checkpoint, const checkpoint_state_t *state, double ***mats, const size_t count, const size_t rows, const size_t cols)
+{
+    int result = -1;
+    char *tmp_path;
+    FILE *file;
+    checkpoint_header_t header;
+    size_t m, i, written;
+
+    if (NULL == checkpoint->path)
+    {
+        return -1;
+    }
+    tmp_path = malloc(strlen(checkpoint->path) + 32);
+    if (NULL == tmp_path)
+    {
+        return -1;
+    }
+    sprintf(tmp_path, "%s.%ld.tmp", checkpoint->path, (long)getpid());
+    file = fopen(tmp_path, "wb");
+    if (NULL == file)
+    {
+        goto tmp_path_cleanup;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    header.version = CHECKPOINT_VERSION;
+    header.kind = checkpoint->kind;
+    header.key = checkpoint->key;
+    header.count = count;
+    header.rows = rows;
+    header.cols = cols;
+    header.state = *state;
+    written = fwrite(&header, sizeof(header), 1, file);
+    for (m = 0; m < count; m++)
+    {
+        for (i = 0; i < rows; i++)
+        {
+            written += fwrite(mats[m][i], sizeof(double), cols, file) == cols;
+        }
+    }
+
+    if (fclose(file) == 0 && 1 + count * rows == written && rename(tmp_path, checkpoint->path) == 0)
+    {
+        result = 0;
+    }
+    else
+    {
+        remove(tmp_path);
+    }
+    checkpoint->last_write = time(NULL);
+
+tmp_path_cleanup:
+    free(tmp_path);
+    return result;
+}
+
+/*Drops the snapshot of a loop that 'finished', so the next run with the same inputs starts afresh*/
+void checkpoint_close(checkpoint_t *checkpoint, const int finished)
+{
+    if (NULL != checkpoint->path && finished)
+    {
+        remove(checkpoint->path);
+    }
+    free(checkpoint->path);
+    checkpoint->path = NULL;
+}
@@ -0,0 +1,55 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdlib.h>
+#include <time.h>
+
+#define CHECKPOINT_MAGIC "SPKMCKP"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_FILE_SUFFIX ".ckp"
+#define CHECKPOINT_DEFAULT_INTERVAL 60.0 /* Seconds between writes when SPKM_CHECKPOINT_INTERVAL is not set */
+
+typedef enum checkpoint_kind_e
+{
+    JACOBI_CHECKPOINT = 0, /* The rotated matrix, then the accumulated eigenvectors */
+    FIT_CHECKPOINT = 1     /* The current centroids */
+} checkpoint_kind_e;
+
+/*Where a loop stands; enough, with its matrices, to carry on as if it had never stopped*/
+typedef struct checkpoint_state_t
+{
+    unsigned long iteration;
+    double off_diagonal; /* Jacobi's off(A)^2 */
+    double convergence;  /* Jacobi's last decrease of off(A)^2 */
+} checkpoint_state_t;
+
+/*On-disk layout: the header, then 'count' matrices of rows x cols doubles each, row after row*/
+typedef struct checkpoint_header_t
+{
+    char magic[8];
+    unsigned long version;
+    unsigned long kind;
+    unsigned long key;
+    unsigned long count;
+    unsigned long rows;
+    unsigned long cols;
+    checkpoint_state_t state;
+} checkpoint_header_t;
+
+typedef struct checkpoint_t
+{
+    char *path; /* NULL when checkpoints are disabled */
+    checkpoint_kind_e kind;
+    unsigned long key;
+    double interval;
+    time_t last_write;
+} checkpoint_t;
+
+int checkpoint_enabled(void);
+void checkpoint_open(checkpoint_t *checkpoint, const checkpoint_kind_e kind, const unsigned long key);
+int checkpoint_load(checkpoint_t *checkpoint, checkpoint_state_t *state, double ***mats, const size_t count, const size_t rows, const size_t cols);
+int checkpoint_due(checkpoint_t *checkpoint);
+int checkpoint_save(checkpoint_t *checkpoint, const checkpoint_state_t *state, double ***mats, const size_t count, const size_t rows, const size_t cols);
+void checkpoint_close(checkpoint_t *checkpoint, const int finished);
+
+#endif /* CHECKPOINT_H */
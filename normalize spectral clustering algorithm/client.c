@@ -0,0 +1,70 @@
+/*The client side of the server: sends one path job and copies the answer to 'out'*/
+#define _XOPEN_SOURCE 700
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "server.h"
+
+#define REPLY_CHUNK 4096
+
+error_e request_job(const char *socket_path, const goal_e goal, const size_t k, const char *path, FILE *out)
+{
+    error_e result = MALLOC_ERROR;
+    job_header_t header;
+    reply_header_t reply;
+    struct sockaddr_un address;
+    char *full_path, chunk[REPLY_CHUNK];
+    ssize_t count;
+    int fd;
+
+    /* The server resolves paths from its own working directory, so send an absolute one */
+    full_path = realpath(path, NULL);
+    if (NULL == full_path)
+    {
+        return INVALID_INPUT;
+    }
+    memset(&address, 0, sizeof(address));
+    if (strlen(socket_path) >= sizeof(address.sun_path))
+    {
+        goto path_cleanup;
+    }
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        goto path_cleanup;
+    }
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0)
+    {
+        goto fd_cleanup;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, JOB_MAGIC, sizeof(JOB_MAGIC));
+    header.goal = goal;
+    header.k = k;
+    header.source = PATH_SOURCE;
+    header.path_len = strlen(full_path);
+    if (write_full(fd, &header, sizeof(header)) != 0 || write_full(fd, full_path, header.path_len) != 0 ||
+        read_full(fd, &reply, sizeof(reply)) != 0)
+    {
+        goto fd_cleanup;
+    }
+    result = (error_e)reply.status;
+    while ((count = read(fd, chunk, sizeof(chunk))) > 0)
+    {
+        fwrite(chunk, 1, (size_t)count, out);
+    }
+
+fd_cleanup:
+    close(fd);
+path_cleanup:
+    free(full_path);
+    return result;
+}
@@ -1,9 +1,18 @@
 #!/bin/bash
 # Script to compile and execute a c program
 
-SRC_FILES="debug.c eigen.c input.c jacobi.c kmeans.c laplacian.c matrix.c point.c spkmeans.c"
+SRC_FILES="alloc.c batch.c bisect.c blas.c cache.c compress.c client.c deadline.c checkpoint.c debug.c dedup.c distance.c eigen.c expbatch.c graph.c incremental.c input.c jacobi.c kmeans.c laplacian.c matrix.c model.c operator.c options.c parallel.c pic.c pipeline.c point.c server.c solver.c sparse.c spatial.c spkmeans.c subspace.c sweep.c tridiag.c"
 # SRC_FILES="src/debug.c src/eigen.c src/input.c src/jacobi.c src/kmeans.c src/laplacian.c src/matrix.c src/point.c src/spkmeans.c"
 
+# Link a system BLAS/LAPACK when one is installed; without it the native kernels are used
+LAPACK_FLAGS=""
+for LIBS in "-lopenblas" "-llapack -lblas"; do
+    if echo 'void dsyevr_(void); int main(void) { dsyevr_(); return 0; }' | clang -x c - $LIBS -o /dev/null 2>/dev/null; then
+        LAPACK_FLAGS="-DSPKM_HAVE_LAPACK $LIBS"
+        break
+    fi
+done
+
 #gcc -ansi -Wall -Wextra -Werror -pedantic-errors debug.c input.c jacobi.c matrix.c point.c spkmeans.c types.c -lm -o spkmeans
-clang -ansi -Wall -Wextra -Werror -pedantic-errors $SRC_FILES -lm -o spkmeans
+clang -ansi -Wall -Wextra -Werror -pedantic-errors -O2 $SRC_FILES $LAPACK_FLAGS -lm -lpthread -o spkmeans
 
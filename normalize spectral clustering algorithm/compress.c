@@ -0,0 +1,580 @@
+/*
+ * W compressed for the iterative eigensolver: the affinities under a threshold are dropped, found with radius
+ * queries on a spatial index as in sparse.c, and the others are stored as float32, bfloat16 or float16 next to
+ * 32-bit columns, one block of rows at a time. Products with L_norm read the blocks directly, decoding the 16-bit
+ * patterns through a table, so W is built once and held in 6 to 8 bytes per kept affinity instead of 8 n^2.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include "compress.h"
+#include "operator.h"
+#include "matrix.h"
+#include "parallel.h"
+#include "spatial.h"
+#include "distance.h"
+#include "expbatch.h"
+#include "tridiag.h"
+
+#define COMPRESS_PATTERNS 65536 /* 16-bit patterns, each decoded once into the table */
+
+typedef struct compress_entry_t
+{
+    size_t column;
+    double value;
+} compress_entry_t;
+
+typedef struct compress_job_t
+{
+    compressed_graph_t *graph;
+    point_t *points;
+    size_t dim;
+    double threshold;
+    spatial_index_t *index; /* NULL without a threshold, when every row is evaluated in full */
+    double radius;
+    distance_kernel_t kernel;
+    exp_kernel_t exp_kernel;
+    double *errors;         /* The max_error of every block, or -1 for a block that could not allocate */
+} compress_job_t;
+
+typedef struct compressed_apply_job_t
+{
+    compressed_graph_t *graph;
+    size_t rows;
+    double **x, **scaled, **y;
+} compressed_apply_job_t;
+
+/*The nearest float16 of an affinity in [0, 1]: 1 + 10 bits times 2^(e - 15), or a multiple of 2^-24 below 2^-14*/
+static unsigned short encode_half(const double value)
+{
+    int exponent;
+    if (value <= .0)
+    {
+        return 0;
+    }
+    frexp(value, &exponent); /* value = m 2^exponent with m in [0.5, 1) */
+    if (exponent - 1 < -14)
+    {
+        return (unsigned short)floor(ldexp(value, 24) + .5);
+    }
+    return (unsigned short)(((exponent - 1 + 15) << 10) + (int)floor((ldexp(value, 1 - exponent) - 1) * 1024 + .5)); /* A carry out of the mantissa bumps the exponent */
+}
+
+static double decode_half(const unsigned int bits)
+{
+    const int exponent = (int)(bits >> 10);
+    const double mantissa = (double)(bits & 0x3ff);
+    return 0 == exponent ? ldexp(mantissa, -24) : ldexp(1024 + mantissa, exponent - 25);
+}
+
+/*The nearest bfloat16 of an affinity in [0, 1]: the top 16 bits of a float, so 1 + 7 bits times 2^(e - 127)*/
+static unsigned short encode_bfloat(const double value)
+{
+    int exponent;
+    if (value <= .0)
+    {
+        return 0;
+    }
+    frexp(value, &exponent);
+    if (exponent - 1 < -126)
+    {
+        return 0;
+    }
+    return (unsigned short)(((exponent - 1 + 127) << 7) + (int)floor((ldexp(value, 1 - exponent) - 1) * 128 + .5));
+}
+
+static double decode_bfloat(const unsigned int bits)
+{
+    const int exponent = (int)(bits >> 7);
+    return 0 == exponent ? .0 : ldexp(128 + (double)(bits & 0x7f), exponent - 134);
+}
+
+static int compare_compress_entries(const void *a, const void *b)
+{
+    const compress_entry_t *left = (const compress_entry_t *)a, *right = (const compress_entry_t *)b;
+    return (left->column > right->column) - (left->column < right->column);
+}
+
+/*The affinities of row i that are kept, columns ascending; 'row' has room for n entries and 'scratch' for n doubles*/
+static size_t kept_affinities(compress_job_t *job, const size_t i, neighbors_t *neighbors, compress_entry_t *row, double *scratch)
+{
+    const size_t n = job->graph->n;
+    size_t j, len = 0;
+    if (NULL != job->index)
+    {
+        for (j = 0; j < neighbors->len; j++)
+        {
+            if (neighbors->indices[j] != i)
+            {
+                row[len].column = neighbors->indices[j];
+                row[len++].value = exp(-neighbors->distances[j] / 2.0);
+            }
+        }
+        qsort(row, len, sizeof(compress_entry_t), compare_compress_entries);
+        return len;
+    }
+    for (j = 0; j < n; j++)
+    {
+        scratch[j] = -job->kernel.distance(job->points[i].elements, job->points[j].elements, job->dim) / 2.0;
+    }
+    exp_batch(&job->exp_kernel, scratch, n);
+    for (j = 0; j < n; j++)
+    {
+        if (j != i && scratch[j] > .0 && scratch[j] >= job->threshold)
+        {
+            row[len].column = j;
+            row[len++].value = scratch[j];
+        }
+    }
+    return len;
+}
+
+/*Builds one block of rows: finds the kept affinities, stores them in the precision and sums the degrees*/
+static void compress_task(void *arg, const size_t index)
+{
+    compress_job_t *job = (compress_job_t *)arg;
+    compressed_graph_t *graph = job->graph;
+    compressed_block_t *block = &graph->blocks[index];
+    const size_t start = index * COMPRESS_BLOCK, end = start + COMPRESS_BLOCK < graph->n ? start + COMPRESS_BLOCK : graph->n;
+    const size_t width = FLOAT32_PRECISION == graph->precision ? sizeof(float) : sizeof(unsigned short);
+    neighbors_t *neighbors = NULL;
+    compress_entry_t *row;
+    double *scratch, stored, error = .0;
+    size_t i, j, len, capacity = 0, nnz = 0;
+    void *grown;
+    unsigned short bits;
+
+    job->errors[index] = -1;
+    row = (compress_entry_t *)malloc(graph->n * sizeof(compress_entry_t));
+    scratch = (double *)malloc(graph->n * sizeof(double));
+    block->row_start = (size_t *)malloc((end - start + 1) * sizeof(size_t));
+    if (NULL == row || NULL == scratch || NULL == block->row_start)
+    {
+        goto end;
+    }
+    if (NULL != job->index)
+    {
+        neighbors = (neighbors_t *)calloc(end - start, sizeof(neighbors_t));
+        if (NULL == neighbors || spatial_radius(job->index, job->points + start, end - start, job->radius, neighbors) != 0)
+        {
+            goto end;
+        }
+    }
+    block->row_start[0] = 0;
+    for (i = start; i < end; i++)
+    {
+        len = kept_affinities(job, i, NULL != neighbors ? &neighbors[i - start] : NULL, row, scratch);
+        if (nnz + len > capacity)
+        {
+            capacity = 2 * capacity > nnz + len ? 2 * capacity : nnz + len;
+            grown = realloc(block->columns, capacity * sizeof(unsigned int));
+            if (NULL == grown)
+            {
+                goto end;
+            }
+            block->columns = (unsigned int *)grown;
+            grown = realloc(block->values, capacity * width);
+            if (NULL == grown)
+            {
+                goto end;
+            }
+            block->values = grown;
+        }
+        graph->degrees[i] = .0;
+        for (j = 0; j < len; j++)
+        {
+            if (FLOAT32_PRECISION == graph->precision)
+            {
+                ((float *)block->values)[nnz] = (float)row[j].value;
+                stored = ((float *)block->values)[nnz];
+            }
+            else
+            {
+                bits = BFLOAT16_PRECISION == graph->precision ? encode_bfloat(row[j].value) : encode_half(row[j].value);
+                ((unsigned short *)block->values)[nnz] = bits;
+                stored = graph->decode[bits];
+            }
+            error = fabs(stored - row[j].value) > error ? fabs(stored - row[j].value) : error;
+            if (stored > .0) /* Affinities that round to 0 are dropped like those under the threshold */
+            {
+                block->columns[nnz++] = (unsigned int)row[j].column;
+                graph->degrees[i] += stored;
+            }
+        }
+        block->row_start[i - start + 1] = nnz;
+    }
+    job->errors[index] = error;
+
+end:
+    if (NULL != neighbors)
+    {
+        free_neighbors(end - start, neighbors);
+        free(neighbors);
+    }
+    free(row);
+    free(scratch);
+}
+
+/*
+ * Compresses the W of the points. A positive 'threshold' drops the affinities under it, which are found without
+ * evaluating all n^2 pairs; with 0 every row is evaluated and only the affinities that round to 0 are dropped.
+ */
+int compress_graph(compressed_graph_t *graph, const size_t n, point_t *points, const size_t dim, const double threshold, const precision_e precision)
+{
+    int result = 1;
+    compress_job_t job;
+    spatial_index_t index;
+    options_t options;
+    const size_t blocks_len = (n + COMPRESS_BLOCK - 1) / COMPRESS_BLOCK;
+    size_t b, i;
+
+    memset(graph, 0, sizeof(*graph));
+    graph->n = n;
+    graph->precision = NO_COMPRESSION == precision ? FLOAT32_PRECISION : precision;
+    if (n > UINT_MAX || threshold > 1.0)
+    {
+        return 1;
+    }
+    graph->blocks = (compressed_block_t *)calloc(blocks_len > 0 ? blocks_len : 1, sizeof(compressed_block_t));
+    graph->degrees = (double *)malloc((n > 0 ? n : 1) * sizeof(double));
+    graph->scale = (double *)malloc((n > 0 ? n : 1) * sizeof(double));
+    job.errors = (double *)malloc((blocks_len > 0 ? blocks_len : 1) * sizeof(double));
+    if (FLOAT32_PRECISION != graph->precision)
+    {
+        graph->decode = (float *)malloc(COMPRESS_PATTERNS * sizeof(float));
+    }
+    if (NULL == graph->blocks || NULL == graph->degrees || NULL == graph->scale || NULL == job.errors ||
+        (FLOAT32_PRECISION != graph->precision && NULL == graph->decode))
+    {
+        goto end;
+    }
+    for (i = 0; NULL != graph->decode && i < COMPRESS_PATTERNS; i++)
+    {
+        graph->decode[i] = (float)(BFLOAT16_PRECISION == graph->precision ? decode_bfloat((unsigned int)i) : decode_half((unsigned int)i)); /* Both are exact in a float */
+    }
+
+    load_options(&options);
+    job.graph = graph;
+    job.points = points;
+    job.dim = dim;
+    job.threshold = threshold;
+    job.index = NULL;
+    job.radius = threshold > .0 ? -2.0 * log(threshold) : .0;
+    job.kernel = select_distance_kernel(dim);
+    job.exp_kernel = select_exp_kernel();
+    if (threshold > .0)
+    {
+        if (spatial_build(&index, points, n, dim, options.index_epsilon) != 0)
+        {
+            goto end;
+        }
+        job.index = &index;
+    }
+    if (parallel_for(blocks_len, compress_task, &job) != 0)
+    {
+        for (b = 0; b < blocks_len; b++)
+        {
+            compress_task(&job, b);
+        }
+    }
+    if (NULL != job.index)
+    {
+        spatial_free(&index);
+    }
+
+    for (b = 0; b < blocks_len; b++)
+    {
+        if (job.errors[b] < .0)
+        {
+            goto end;
+        }
+        graph->max_error = job.errors[b] > graph->max_error ? job.errors[b] : graph->max_error;
+        graph->nnz += graph->blocks[b].row_start[(b + 1) * COMPRESS_BLOCK < n ? COMPRESS_BLOCK : n - b * COMPRESS_BLOCK];
+    }
+    for (i = 0; i < n; i++)
+    {
+        graph->scale[i] = sqrt(1 / graph->degrees[i]);
+    }
+    result = 0;
+
+end:
+    free(job.errors);
+    if (0 != result)
+    {
+        free_compressed(graph);
+    }
+    return result;
+}
+
+/*The entries of one block of rows of every product*/
+static void compressed_apply_task(void *arg, const size_t index)
+{
+    compressed_apply_job_t *job = (compressed_apply_job_t *)arg;
+    compressed_graph_t *graph = job->graph;
+    compressed_block_t *block = &graph->blocks[index];
+    const size_t start = index * COMPRESS_BLOCK, end = start + COMPRESS_BLOCK < graph->n ? start + COMPRESS_BLOCK : graph->n;
+    const float *floats = (const float *)block->values;
+    const unsigned short *patterns = (const unsigned short *)block->values;
+    size_t i, j, r;
+    double sum;
+
+    for (i = start; i < end; i++)
+    {
+        for (r = 0; r < job->rows; r++)
+        {
+            sum = .0;
+            if (FLOAT32_PRECISION == graph->precision)
+            {
+                for (j = block->row_start[i - start]; j < block->row_start[i - start + 1]; j++)
+                {
+                    sum += floats[j] * job->scaled[r][block->columns[j]];
+                }
+            }
+            else
+            {
+                for (j = block->row_start[i - start]; j < block->row_start[i - start + 1]; j++)
+                {
+                    sum += graph->decode[patterns[j]] * job->scaled[r][block->columns[j]];
+                }
+            }
+            job->y[r][i] = job->x[r][i] - graph->scale[i] * sum;
+        }
+    }
+}
+
+/*y[r] = L_norm x[r] for each of the 'rows' vectors, with the compressed W; y must not share storage with x*/
+int compressed_apply(compressed_graph_t *graph, const size_t rows, double **x, double **y)
+{
+    compressed_apply_job_t job;
+    const size_t blocks_len = (graph->n + COMPRESS_BLOCK - 1) / COMPRESS_BLOCK;
+    size_t r, i;
+    job.scaled = (double **)malloc_matrix(rows, graph->n, sizeof(double));
+    if (NULL == job.scaled)
+    {
+        return 1;
+    }
+    for (r = 0; r < rows; r++)
+    {
+        for (i = 0; i < graph->n; i++)
+        {
+            job.scaled[r][i] = graph->scale[i] * x[r][i];
+        }
+    }
+    job.graph = graph;
+    job.rows = rows;
+    job.x = x;
+    job.y = y;
+    if (parallel_for(blocks_len, compressed_apply_task, &job) != 0)
+    {
+        for (i = 0; i < blocks_len; i++)
+        {
+            compressed_apply_task(&job, i);
+        }
+    }
+    free_matrix(rows, (void **)job.scaled);
+    return 0;
+}
+
+/*
+ * The bytes the compressed graph holds, the blocks' offsets included. The decoding table is left out: its
+ * COMPRESS_PATTERNS floats are the same for every graph, see compressed_table_bytes()
+ */
+size_t compressed_bytes(compressed_graph_t *graph)
+{
+    const size_t blocks_len = (graph->n + COMPRESS_BLOCK - 1) / COMPRESS_BLOCK;
+    const size_t width = FLOAT32_PRECISION == graph->precision ? sizeof(float) : sizeof(unsigned short);
+    size_t bytes = blocks_len * sizeof(compressed_block_t) + 2 * graph->n * sizeof(double);
+    return bytes + (graph->n + blocks_len) * sizeof(size_t) + graph->nnz * (sizeof(unsigned int) + width);
+}
+
+/*The bytes of the 16-bit decoding table, 0 for float32*/
+size_t compressed_table_bytes(compressed_graph_t *graph)
+{
+    return NULL != graph->decode ? COMPRESS_PATTERNS * sizeof(float) : 0;
+}
+
+void free_compressed(compressed_graph_t *graph)
+{
+    const size_t blocks_len = (graph->n + COMPRESS_BLOCK - 1) / COMPRESS_BLOCK;
+    size_t b;
+    for (b = 0; NULL != graph->blocks && b < blocks_len; b++)
+    {
+        free(graph->blocks[b].row_start);
+        free(graph->blocks[b].columns);
+        free(graph->blocks[b].values);
+    }
+    free(graph->blocks);
+    free(graph->decode);
+    free(graph->degrees);
+    free(graph->scale);
+    graph->blocks = NULL;
+    graph->decode = NULL;
+    graph->degrees = graph->scale = NULL;
+}
+
+static eigen_t *malloc_top_eigens(const size_t k, const size_t n)
+{
+    eigen_t *eigens = (eigen_t *)malloc((k > 0 ? k : 1) * sizeof(eigen_t));
+    size_t i;
+    for (i = 0; NULL != eigens && i < k; i++)
+    {
+        eigens[i].vector = (double *)malloc(n * sizeof(double));
+        if (NULL == eigens[i].vector)
+        {
+            free_eigens(i, eigens);
+            return NULL;
+        }
+    }
+    return eigens;
+}
+
+/*sin of the largest principal angle between the spans of two sets of k orthonormal vectors: sqrt(1 - s_min^2) of A B^T*/
+static int subspace_sine(const size_t n, const size_t k, eigen_t *a, eigen_t *b, double *sine)
+{
+    int result = 1;
+    double **left, **right, **cross, **gram;
+    eigen_t *singular;
+    size_t i, j, m;
+
+    left = (double **)malloc_matrix(k, n, sizeof(double));
+    right = (double **)malloc_matrix(k, n, sizeof(double));
+    cross = (double **)malloc_matrix(k, k, sizeof(double));
+    gram = (double **)malloc_matrix(k, k, sizeof(double));
+    singular = malloc_eigens(k);
+    if (NULL == left || NULL == right || NULL == cross || NULL == gram || NULL == singular)
+    {
+        goto end;
+    }
+    for (i = 0; i < k; i++)
+    {
+        memcpy(left[i], a[i].vector, n * sizeof(double));
+        memcpy(right[i], b[i].vector, n * sizeof(double));
+    }
+    multiply_transposed_blocked(k, n, k, left, right, cross);
+    for (i = 0; i < k; i++)
+    {
+        for (j = 0; j < k; j++)
+        {
+            gram[i][j] = .0;
+            for (m = 0; m < k; m++)
+            {
+                gram[i][j] += cross[m][i] * cross[m][j];
+            }
+        }
+    }
+    if (tridiag_eigens(k, gram, singular) != 0)
+    {
+        goto end;
+    }
+    *sine = 1.0;
+    for (i = 0; i < k; i++)
+    {
+        *sine = 1 - singular[i].value < *sine ? 1 - singular[i].value : *sine;
+    }
+    *sine = sqrt(*sine > .0 ? *sine : .0);
+    result = 0;
+
+end:
+    if (NULL != singular)
+    {
+        free_eigens(k, singular);
+    }
+    if (NULL != gram)
+    {
+        free_matrix(k, (void **)gram);
+    }
+    if (NULL != cross)
+    {
+        free_matrix(k, (void **)cross);
+    }
+    if (NULL != right)
+    {
+        free_matrix(k, (void **)right);
+    }
+    if (NULL != left)
+    {
+        free_matrix(k, (void **)left);
+    }
+    return result;
+}
+
+/*
+ * The k + 1 largest eigenpairs of L_norm from the compressed W and from the exact one, regenerated as by the
+ * matrix-free solver, compared: how far the eigenvalues and the eigengap after the k-th moved, and the largest
+ * angle between the two k-dimensional embeddings.
+ */
+int compress_report(const size_t n, point_t *points, const size_t dim, const size_t k, const double threshold, const precision_e precision, compress_report_t *report)
+{
+    int result = 1;
+    options_t options;
+    compressed_graph_t graph;
+    lnorm_operator_t exact, compressed;
+    eigen_t *exact_eigens, *compressed_eigens;
+    size_t i;
+
+    memset(report, 0, sizeof(*report));
+    if (0 == k || k + 1 > n)
+    {
+        return 1;
+    }
+    load_options(&options);
+    exact_eigens = malloc_top_eigens(k + 1, n);
+    compressed_eigens = malloc_top_eigens(k + 1, n);
+    if (NULL == exact_eigens || NULL == compressed_eigens)
+    {
+        goto eigens_cleanup;
+    }
+    if (compress_graph(&graph, n, points, dim, threshold, precision) != 0)
+    {
+        goto eigens_cleanup;
+    }
+    if (lnorm_operator_init_compressed(&compressed, &graph) != 0)
+    {
+        goto graph_cleanup;
+    }
+    if (lnorm_operator_init(&exact, n, points, dim) != 0)
+    {
+        goto compressed_cleanup;
+    }
+    if (lnorm_operator_eigens(&exact, exact_eigens, k + 1, options.oversample, NULL) != 0 ||
+        lnorm_operator_eigens(&compressed, compressed_eigens, k + 1, options.oversample, NULL) != 0 ||
+        subspace_sine(n, k, exact_eigens, compressed_eigens, &report->subspace_sine) != 0)
+    {
+        goto exact_cleanup;
+    }
+
+    report->nnz = graph.nnz;
+    report->bytes = compressed_bytes(&graph);
+    report->table_bytes = compressed_table_bytes(&graph);
+    report->dense_bytes = n * n * sizeof(double);
+    report->max_error = graph.max_error;
+    for (i = 0; i <= k; i++)
+    {
+        if (fabs(exact_eigens[i].value - compressed_eigens[i].value) > report->eigenvalue_error)
+        {
+            report->eigenvalue_error = fabs(exact_eigens[i].value - compressed_eigens[i].value);
+        }
+    }
+    report->eigengap = exact_eigens[k - 1].value - exact_eigens[k].value;
+    report->compressed_eigengap = compressed_eigens[k - 1].value - compressed_eigens[k].value;
+    result = 0;
+
+exact_cleanup:
+    lnorm_operator_free(&exact);
+compressed_cleanup:
+    lnorm_operator_free(&compressed);
+graph_cleanup:
+    free_compressed(&graph);
+eigens_cleanup:
+    if (NULL != exact_eigens)
+    {
+        free_eigens(k + 1, exact_eigens);
+    }
+    if (NULL != compressed_eigens)
+    {
+        free_eigens(k + 1, compressed_eigens);
+    }
+    return result;
+}
@@ -0,0 +1,55 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stdlib.h>
+#include "point.h"
+#include "options.h"
+
+#define COMPRESS_BLOCK 64 /* Rows per block of the compressed W, each built by one task and stored on its own */
+
+/*The stored affinities of COMPRESS_BLOCK consecutive rows of W, columns ascending within each row*/
+typedef struct compressed_block_t
+{
+    size_t *row_start;     /* Rows + 1 offsets into columns and values */
+    unsigned int *columns;
+    void *values;          /* floats, or the 16-bit patterns of the precision */
+} compressed_block_t;
+
+/*
+ * W without the affinities under a threshold and with the others in reduced precision. The degrees and D^-1/2
+ * are doubles summed from the stored values, so the diagonal of L_norm = I - D^-1/2 W D^-1/2 stays exact.
+ */
+typedef struct compressed_graph_t
+{
+    size_t n;
+    precision_e precision;
+    size_t nnz;
+    compressed_block_t *blocks;
+    float *decode;         /* The value of every 16-bit pattern, NULL for float32 */
+    double *degrees;
+    double *scale;         /* D^-1/2 */
+    double max_error;      /* Largest |stored - exact| over the stored affinities */
+} compressed_graph_t;
+
+/*The compressed and the exact top of the spectrum of L_norm, for judging whether a precision is good enough*/
+typedef struct compress_report_t
+{
+    size_t nnz;
+    size_t bytes;              /* Of the compressed W, degrees and D^-1/2 */
+    size_t table_bytes;        /* Of the fixed float16/bfloat16 decoding table, not in 'bytes' */
+    size_t dense_bytes;        /* Of a dense W */
+    double max_error;
+    double eigenvalue_error;   /* Largest |exact - compressed| over the first k + 1 eigenvalues */
+    double eigengap;           /* Exact lambda_k - lambda_k+1, which bounds how far the embedding may turn */
+    double compressed_eigengap;
+    double subspace_sine;      /* Sine of the largest principal angle between the exact and compressed k eigenvectors */
+} compress_report_t;
+
+int compress_graph(compressed_graph_t *graph, const size_t n, point_t *points, const size_t dim, const double threshold, const precision_e precision);
+int compressed_apply(compressed_graph_t *graph, const size_t rows, double **x, double **y);
+size_t compressed_bytes(compressed_graph_t *graph);
+size_t compressed_table_bytes(compressed_graph_t *graph);
+void free_compressed(compressed_graph_t *graph);
+int compress_report(const size_t n, point_t *points, const size_t dim, const size_t k, const double threshold, const precision_e precision, compress_report_t *report);
+
+#endif /* COMPRESS_H */
@@ -0,0 +1,49 @@
+/*Time budgets and cancellation for the iterative stages; a NULL deadline never expires*/
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "deadline.h"
+
+static double monotonic_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*Starts a budget of 'budget' seconds from now; a budget of 0 only allows cancellation*/
+void deadline_start(deadline_t *deadline, const double budget)
+{
+    deadline->expires = budget > .0 ? monotonic_seconds() + budget : .0;
+    deadline->cancelled = 0;
+    deadline->stopped = DEADLINE_LIVE;
+}
+
+void deadline_cancel(deadline_t *deadline)
+{
+    deadline->cancelled = 1;
+}
+
+/*DEADLINE_LIVE while work may go on, otherwise the reason to stop, which is also kept in 'stopped'*/
+int deadline_check(deadline_t *deadline)
+{
+    if (NULL == deadline)
+    {
+        return DEADLINE_LIVE;
+    }
+    if (deadline->cancelled)
+    {
+        deadline->stopped = DEADLINE_CANCELLED;
+    }
+    else if (deadline->expires > .0 && monotonic_seconds() >= deadline->expires)
+    {
+        deadline->stopped = DEADLINE_TIMED_OUT;
+    }
+    else
+    {
+        return DEADLINE_LIVE;
+    }
+    return deadline->stopped;
+}
@@ -0,0 +1,25 @@
+#ifndef DEADLINE_H
+#define DEADLINE_H
+
+#define DEADLINE_LIVE 0
+#define DEADLINE_TIMED_OUT 3 /* The same values as TIMED_OUT and CANCELLED in error_e */
+#define DEADLINE_CANCELLED 4
+#define DEADLINE_STOPPED(status) (DEADLINE_TIMED_OUT == (status) || DEADLINE_CANCELLED == (status))
+
+/*
+ * A wall-time budget and a cancellation flag shared by the iterative stages. Loops poll it once per sweep
+ * or iteration and, when it has expired, stop with the best result so far and return the reason. The flag
+ * may be raised from another thread; 'stopped' remembers whether any computation was cut short.
+ */
+typedef struct deadline_t
+{
+    double expires; /* Monotonic clock seconds, 0 when there is no time budget */
+    volatile int cancelled;
+    volatile int stopped; /* DEADLINE_LIVE, or why a computation was cut short */
+} deadline_t;
+
+void deadline_start(deadline_t *deadline, const double budget);
+void deadline_cancel(deadline_t *deadline);
+int deadline_check(deadline_t *deadline);
+
+#endif /* DEADLINE_H */
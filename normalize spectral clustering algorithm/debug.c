@@ -1,24 +1,104 @@
 #include <stdio.h>
+#include <math.h>
 
 #include "debug.h"
 #include "eigen.h"
 
-/*Function to print matrices*/
-void print_matrix(const size_t n, const size_t k, double **matrix)
+/*Function to print matrices, to any stream so the server can answer over its socket*/
+void fprint_matrix(FILE *stream, const size_t n, const size_t k, double **matrix)
 {
     size_t i, j;
     for (i = 0; i < n; i++)
     {
         for (j = 0; j < k; j++)
         {
-            printf("%.4f", matrix[i][j]);
+            fprintf(stream, "%.4f", matrix[i][j]);
             if (j < k - 1)
             {
-                printf(",");
+                fputc(',', stream);
+            }
+        }
+        fputc('\n', stream);
+    }
+}
+
+/*Prints the n*n diagonal matrix with 'diagonal' on its diagonal as fprint_matrix would, without the matrix itself*/
+void fprint_diagonal(FILE *stream, const size_t n, double *diagonal)
+{
+    size_t i, j;
+    for (i = 0; i < n; i++)
+    {
+        for (j = 0; j < n; j++)
+        {
+            if (i == j)
+            {
+                fprintf(stream, "%.4f", diagonal[i]);
+            }
+            else
+            {
+                fputs("0.0000", stream);
+            }
+            if (j < n - 1)
+            {
+                fputc(',', stream);
             }
         }
-        printf("\n");
+        fputc('\n', stream);
+    }
+}
+
+/*
+ * Writes 'value' to 'out' exactly as "%.4f" prints it and returns the length. value * 10^4 is rounded to an
+ * integer directly unless it lies within DEBUG_TIE_MARGIN of a tie, where the error of that product could pick
+ * the wrong side; ties, values of DEBUG_FIXED_MAX and up and non-finite values are left to sprintf.
+ */
+size_t sprint_fixed4(char *out, const double value)
+{
+    const int negative = value < .0 || (.0 == value && 1.0 / value < .0); /* printf keeps the sign of -0 */
+    const double scaled = (negative ? -value : value) * 10000.0;
+    double whole;
+    unsigned long digits, integral;
+    char reversed[16];
+    size_t len = 0, r = 0, i;
+
+    if (!(scaled < DEBUG_FIXED_MAX * 10000.0)) /* Also true for NaN */
+    {
+        return (size_t)sprintf(out, "%.4f", value);
+    }
+    whole = floor(scaled);
+    if (fabs(scaled - whole - 0.5) < DEBUG_TIE_MARGIN)
+    {
+        return (size_t)sprintf(out, "%.4f", value);
+    }
+    digits = (unsigned long)whole + (scaled - whole > 0.5 ? 1 : 0);
+    if (negative)
+    {
+        out[len++] = '-';
+    }
+    integral = digits / 10000;
+    do
+    {
+        reversed[r++] = (char)('0' + integral % 10);
+        integral /= 10;
+    } while (integral > 0);
+    while (r > 0)
+    {
+        out[len++] = reversed[--r];
+    }
+    out[len++] = '.';
+    for (i = 0; i < 4; i++)
+    {
+        out[len + 3 - i] = (char)('0' + digits % 10);
+        digits /= 10;
     }
+    len += 4;
+    out[len] = '\0';
+    return len;
+}
+
+void print_matrix(const size_t n, const size_t k, double **matrix)
+{
+    fprint_matrix(stdout, n, k, matrix);
 }
 
 /*Function to print arrays*/
@@ -37,28 +117,33 @@ void print_array(const size_t n, double *array)
 }
 
 /*Function for printing eigenvalues and eigenvectors*/
-void print_eigen(const size_t n, eigen_t *eigen)
+void fprint_eigen(FILE *stream, const size_t n, eigen_t *eigen)
 {
     size_t i, j;
     for (i = 0; i < n; i++)
     {
-        printf("%.4f", eigen[i].value);
+        fprintf(stream, "%.4f", eigen[i].value);
         if (i < n - 1)
         {
-            printf(",");
+            fputc(',', stream);
         }
     }
-    printf("\n");
+    fputc('\n', stream);
     for (i = 0; i < n; i++)
     {
         for (j = 0; j < n; j++)
         {
-            printf("%.4f", eigen[j].vector[i]);
+            fprintf(stream, "%.4f", eigen[j].vector[i]);
             if (j < n - 1)
             {
-                printf(",");
+                fputc(',', stream);
             }
         }
-        printf("\n");
+        fputc('\n', stream);
     }
 }
+
+void print_eigen(const size_t n, eigen_t *eigen)
+{
+    fprint_eigen(stdout, n, eigen);
+}
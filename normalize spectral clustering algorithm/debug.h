@@ -1,8 +1,16 @@
 #ifndef DEBUG_H
 #define DEBUG_H
 
+#include <stdio.h>
 #include "eigen.h"
 
+#define DEBUG_FIXED_MAX 1e5    /* Magnitudes sprint_fixed4() converts itself; value * 10^4 then fits a 32-bit unsigned long */
+#define DEBUG_TIE_MARGIN 1e-6  /* Far above the rounding error of value * 10^4 below DEBUG_FIXED_MAX * 10^4 */
+
+void fprint_matrix(FILE *stream, const size_t n, const size_t k, double **matrix);
+void fprint_diagonal(FILE *stream, const size_t n, double *diagonal);
+void fprint_eigen(FILE *stream, const size_t n, eigen_t *eigen);
+size_t sprint_fixed4(char *out, const double value);
 void print_matrix(const size_t n, const size_t k, double **matrix);
 void print_array(const size_t n, double *matrix);
 void print_eigen(const size_t n, eigen_t *eigen);
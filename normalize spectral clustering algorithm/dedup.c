@@ -0,0 +1,117 @@
+/*
+ * Collapses the rows of a point set that are equal, or that fall in the same cell of a grid of side 'quantum',
+ * into one point weighted by how many rows it stands for. The rows are hashed into an open-addressing table,
+ * so this takes O(n dim) time and leaves the points themselves in place.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "dedup.h"
+#include "cache.h"
+
+/*The coordinate rows are compared by: its grid cell, or the value itself with -0 folded into 0*/
+static double cell(const double value, const double quantum)
+{
+    return quantum > .0 ? floor(value / quantum + .5) : value + .0;
+}
+
+static unsigned long hash_point(const point_t point, const size_t dim, const double quantum)
+{
+    unsigned long hash = FNV_OFFSET;
+    double coordinate;
+    size_t j;
+    for (j = 0; j < dim; j++)
+    {
+        coordinate = cell(point.elements[j], quantum);
+        hash = hash_bytes(hash, &coordinate, sizeof(double));
+    }
+    return hash;
+}
+
+static int same_cell(const point_t a, const point_t b, const size_t dim, const double quantum)
+{
+    size_t j;
+    for (j = 0; j < dim; j++)
+    {
+        if (cell(a.elements[j], quantum) != cell(b.elements[j], quantum))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*Groups the n points in the order their groups first appear; a 'quantum' of 0 only collapses exact duplicates*/
+int dedup_points(point_t *points, const size_t n, const size_t dim, const double quantum, dedup_t *dedup)
+{
+    size_t *slots, slots_len = 2, i, slot, group;
+    memset(dedup, 0, sizeof(dedup_t));
+    while (slots_len < 2 * n)
+    {
+        slots_len *= 2;
+    }
+    slots = (size_t *)calloc(slots_len, sizeof(size_t)); /* A group plus one, 0 for an empty slot */
+    dedup->points = (point_t *)malloc((n > 0 ? n : 1) * sizeof(point_t));
+    dedup->weights = (double *)malloc((n > 0 ? n : 1) * sizeof(double));
+    dedup->groups = (size_t *)malloc((n > 0 ? n : 1) * sizeof(size_t));
+    if (NULL == slots || NULL == dedup->points || NULL == dedup->weights || NULL == dedup->groups)
+    {
+        free(slots);
+        dedup_free(dedup);
+        return 1;
+    }
+    dedup->n = n;
+    for (i = 0; i < n; i++)
+    {
+        slot = hash_point(points[i], dim, quantum) & (slots_len - 1);
+        while (0 != slots[slot] && !same_cell(points[i], dedup->points[slots[slot] - 1], dim, quantum))
+        {
+            slot = (slot + 1) & (slots_len - 1);
+        }
+        if (0 == slots[slot])
+        {
+            group = dedup->unique_len++;
+            slots[slot] = group + 1;
+            dedup->points[group] = points[i];
+            dedup->weights[group] = .0;
+        }
+        else
+        {
+            group = slots[slot] - 1;
+        }
+        dedup->weights[group] += 1;
+        dedup->groups[i] = group;
+    }
+    free(slots);
+    return 0;
+}
+
+/*Copies row groups[i] of the unique_len*cols matrix 'reduced' into row i of the n*cols matrix 'mat'*/
+void dedup_expand_rows(const dedup_t *dedup, const size_t cols, double **reduced, double **mat)
+{
+    size_t i;
+    for (i = 0; i < dedup->n; i++)
+    {
+        memcpy(mat[i], reduced[dedup->groups[i]], cols * sizeof(double));
+    }
+}
+
+void dedup_expand_labels(const dedup_t *dedup, size_t *reduced, size_t *labels)
+{
+    size_t i;
+    for (i = 0; i < dedup->n; i++)
+    {
+        labels[i] = reduced[dedup->groups[i]];
+    }
+}
+
+void dedup_free(dedup_t *dedup)
+{
+    free(dedup->points);
+    free(dedup->weights);
+    free(dedup->groups);
+    dedup->points = NULL;
+    dedup->weights = NULL;
+    dedup->groups = NULL;
+}
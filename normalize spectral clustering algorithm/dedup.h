@@ -0,0 +1,22 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include <stdlib.h>
+#include "point.h"
+
+/*The distinct points of a set, each standing for all the rows equal to it*/
+typedef struct dedup_t
+{
+    size_t n;          /* Rows of the original points */
+    size_t unique_len;
+    point_t *points;   /* The first row of every group; the elements are the original rows', not copies */
+    double *weights;   /* How many rows every group collapses */
+    size_t *groups;    /* The group of every original row */
+} dedup_t;
+
+int dedup_points(point_t *points, const size_t n, const size_t dim, const double quantum, dedup_t *dedup);
+void dedup_expand_rows(const dedup_t *dedup, const size_t cols, double **reduced, double **mat);
+void dedup_expand_labels(const dedup_t *dedup, size_t *reduced, size_t *labels);
+void dedup_free(dedup_t *dedup);
+
+#endif /* DEDUP_H */
@@ -0,0 +1,138 @@
+/*
+ * Distance kernels specialized for the common dimensions. They are unrolled so the loop and its bound check
+ * disappear and the compiler can pack the differences into vector registers. Up to 4 dimensions the terms
+ * are summed in index order, so the results match the generic loop bit for bit; the wider ones keep
+ * DISTANCE_BLOCK partial sums, which is what lets them vectorize.
+ */
+#include <stdlib.h>
+#include <math.h>
+
+#include "distance.h"
+
+#define SQUARE(x) ((x) * (x))
+#define TERM(i) SQUARE(p1[i] - p2[i])
+
+static double squared_2(const double *p1, const double *p2, const size_t dim)
+{
+    (void)dim;
+    return TERM(0) + TERM(1);
+}
+
+static double squared_3(const double *p1, const double *p2, const size_t dim)
+{
+    (void)dim;
+    return TERM(0) + TERM(1) + TERM(2);
+}
+
+static double squared_4(const double *p1, const double *p2, const size_t dim)
+{
+    (void)dim;
+    return TERM(0) + TERM(1) + TERM(2) + TERM(3);
+}
+
+static double squared_8(const double *p1, const double *p2, const size_t dim)
+{
+    double s0 = TERM(0) + TERM(4), s1 = TERM(1) + TERM(5), s2 = TERM(2) + TERM(6), s3 = TERM(3) + TERM(7);
+    (void)dim;
+    return (s0 + s1) + (s2 + s3);
+}
+
+static double squared_16(const double *p1, const double *p2, const size_t dim)
+{
+    double s0 = TERM(0) + TERM(4) + TERM(8) + TERM(12);
+    double s1 = TERM(1) + TERM(5) + TERM(9) + TERM(13);
+    double s2 = TERM(2) + TERM(6) + TERM(10) + TERM(14);
+    double s3 = TERM(3) + TERM(7) + TERM(11) + TERM(15);
+    (void)dim;
+    return (s0 + s1) + (s2 + s3);
+}
+
+/*Any dimension: blocks of DISTANCE_BLOCK coordinates into independent sums, then the remainder*/
+static double squared_blocked(const double *p1, const double *p2, const size_t dim)
+{
+    double sums[DISTANCE_BLOCK] = {.0, .0, .0, .0}, sum;
+    size_t i, j, blocked = dim - dim % DISTANCE_BLOCK;
+    if (dim < DISTANCE_BLOCK)
+    {
+        for (sum = .0, i = 0; i < dim; i++)
+        {
+            sum += TERM(i);
+        }
+        return sum;
+    }
+    for (i = 0; i < blocked; i += DISTANCE_BLOCK)
+    {
+        for (j = 0; j < DISTANCE_BLOCK; j++)
+        {
+            sums[j] += TERM(i + j);
+        }
+    }
+    for (; i < dim; i++)
+    {
+        sums[0] += TERM(i);
+    }
+    return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+
+static double distance_2(const double *p1, const double *p2, const size_t dim)
+{
+    return sqrt(squared_2(p1, p2, dim));
+}
+
+static double distance_3(const double *p1, const double *p2, const size_t dim)
+{
+    return sqrt(squared_3(p1, p2, dim));
+}
+
+static double distance_4(const double *p1, const double *p2, const size_t dim)
+{
+    return sqrt(squared_4(p1, p2, dim));
+}
+
+static double distance_8(const double *p1, const double *p2, const size_t dim)
+{
+    return sqrt(squared_8(p1, p2, dim));
+}
+
+static double distance_16(const double *p1, const double *p2, const size_t dim)
+{
+    return sqrt(squared_16(p1, p2, dim));
+}
+
+static double distance_blocked(const double *p1, const double *p2, const size_t dim)
+{
+    return sqrt(squared_blocked(p1, p2, dim));
+}
+
+distance_kernel_t select_distance_kernel(const size_t dim)
+{
+    distance_kernel_t kernel;
+    switch (dim)
+    {
+    case 2:
+        kernel.squared = squared_2;
+        kernel.distance = distance_2;
+        break;
+    case 3:
+        kernel.squared = squared_3;
+        kernel.distance = distance_3;
+        break;
+    case 4:
+        kernel.squared = squared_4;
+        kernel.distance = distance_4;
+        break;
+    case 8:
+        kernel.squared = squared_8;
+        kernel.distance = distance_8;
+        break;
+    case 16:
+        kernel.squared = squared_16;
+        kernel.distance = distance_16;
+        break;
+    default:
+        kernel.squared = squared_blocked;
+        kernel.distance = distance_blocked;
+        break;
+    }
+    return kernel;
+}
@@ -0,0 +1,19 @@
+#ifndef DISTANCE_H
+#define DISTANCE_H
+
+#include <stdlib.h>
+
+#define DISTANCE_BLOCK 4 /* Independent partial sums of the generic kernel */
+
+typedef double (*distance_fn)(const double *p1, const double *p2, const size_t dim);
+
+/*Squared and plain Euclidean distance for one dimension, picked once before a loop over many pairs*/
+typedef struct distance_kernel_t
+{
+    distance_fn squared;
+    distance_fn distance;
+} distance_kernel_t;
+
+distance_kernel_t select_distance_kernel(const size_t dim);
+
+#endif /* DISTANCE_H */
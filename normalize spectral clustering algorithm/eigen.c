@@ -16,6 +16,11 @@ eigen_t *malloc_eigens(const size_t n)
     for (i = 0; i < n; i++)
     {
         eigens[i].vector = malloc(n * sizeof(double));
+        if (NULL == eigens[i].vector)
+        {
+            free_eigens(i, eigens); /* The vectors allocated so far */
+            return NULL;
+        }
     }
     return eigens;
 }
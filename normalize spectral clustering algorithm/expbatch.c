@@ -0,0 +1,163 @@
+/*
+ * exp() over whole rows of arguments. x = n ln2 + r with |r| <= ln2 / 2 (ln2 split in two for an exact
+ * reduction), e^r from its degree 13 Taylor polynomial, whose truncation error is below 1e-17, and 2^n put
+ * straight into the exponent bits. The result is within EXP_MAX_ULP ulp of libm for arguments in
+ * [EXP_MIN_ARG, EXP_MAX_ARG]. The block loops have no branches and a fixed trip count, so the same C code is
+ * compiled once per instruction set and the variant matching the CPU is picked at runtime.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "expbatch.h"
+#include "options.h"
+
+#define LOG2E 1.4426950408889634
+#define LN2_HI 6.93147180369123816490e-01 /* ln2 with its low bits cleared, so n * LN2_HI is exact */
+#define LN2_LO 1.90821492927058770002e-10
+#define SHIFTER 6755399441055744.0 /* 1.5 * 2^52: adding it rounds to an integer kept in the low mantissa bits */
+#define SHIFTER_BITS 0x4338000000000000UL
+#define EXPONENT_BIAS 1023UL
+#define MANTISSA_BITS 52
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define EXP_ALWAYS_INLINE __inline__ __attribute__((always_inline))
+#define EXP_HAS_VARIANTS
+#else
+#define EXP_ALWAYS_INLINE
+#endif
+
+/*Evaluates EXP_BLOCK arguments in place*/
+static EXP_ALWAYS_INLINE void exp_block(double *block, const double cutoff)
+{
+    double args[EXP_BLOCK], x[EXP_BLOCK], shifted[EXP_BLOCK], scale[EXP_BLOCK], n, r;
+    unsigned long bits[EXP_BLOCK];
+    size_t j;
+    /* Each clamp gets its own loop: a single select per loop is what the vectorizer if-converts */
+    for (j = 0; j < EXP_BLOCK; j++)
+    {
+        args[j] = block[j];
+        x[j] = block[j] < cutoff ? cutoff : block[j]; /* Clamped so the reduction stays in range; the result is fixed below */
+    }
+    for (j = 0; j < EXP_BLOCK; j++)
+    {
+        x[j] = x[j] > EXP_MAX_ARG ? EXP_MAX_ARG : x[j];
+    }
+    for (j = 0; j < EXP_BLOCK; j++)
+    {
+        shifted[j] = x[j] * LOG2E + SHIFTER;
+        n = shifted[j] - SHIFTER;
+        r = (x[j] - n * LN2_HI) - n * LN2_LO;
+        block[j] = 1.0 + r * (1.0 + r * (1.0 / 2 + r * (1.0 / 6 + r * (1.0 / 24 + r * (1.0 / 120 + r * (1.0 / 720 +
+                   r * (1.0 / 5040 + r * (1.0 / 40320 + r * (1.0 / 362880 + r * (1.0 / 3628800 + r * (1.0 / 39916800 +
+                   r * (1.0 / 479001600 + r * (1.0 / 6227020800.0)))))))))))));
+    }
+    memcpy(bits, shifted, sizeof(bits));
+    for (j = 0; j < EXP_BLOCK; j++)
+    {
+        bits[j] = (bits[j] - SHIFTER_BITS + EXPONENT_BIAS) << MANTISSA_BITS;
+    }
+    memcpy(scale, bits, sizeof(scale));
+    for (j = 0; j < EXP_BLOCK; j++)
+    {
+        block[j] *= scale[j];
+    }
+    for (j = 0; j < EXP_BLOCK; j++)
+    {
+        block[j] = args[j] < cutoff ? .0 : block[j];
+    }
+    for (j = 0; j < EXP_BLOCK; j++)
+    {
+        block[j] = args[j] > EXP_MAX_ARG ? HUGE_VAL : block[j];
+    }
+}
+
+static EXP_ALWAYS_INLINE void exp_rows(double *values, const size_t len, const double cutoff)
+{
+    double block[EXP_BLOCK];
+    size_t i, j, width;
+    for (i = 0; i + EXP_BLOCK <= len; i += EXP_BLOCK)
+    {
+        exp_block(values + i, cutoff);
+    }
+    if (i < len)
+    {
+        width = len - i;
+        for (j = 0; j < EXP_BLOCK; j++)
+        {
+            block[j] = j < width ? values[i + j] : .0;
+        }
+        exp_block(block, cutoff);
+        memcpy(values + i, block, width * sizeof(double));
+    }
+}
+
+/*The reference: libm one value at a time, nothing flushed*/
+static void exp_batch_libm(double *values, const size_t len, const double cutoff)
+{
+    size_t i;
+    (void)cutoff;
+    for (i = 0; i < len; i++)
+    {
+        values[i] = exp(values[i]);
+    }
+}
+
+/*SSE2 is the x86-64 baseline, so this is also the portable variant*/
+static void exp_batch_sse2(double *values, const size_t len, const double cutoff)
+{
+    exp_rows(values, len, cutoff);
+}
+
+#ifdef EXP_HAS_VARIANTS
+__attribute__((target("avx2"))) static void exp_batch_avx2(double *values, const size_t len, const double cutoff)
+{
+    exp_rows(values, len, cutoff);
+}
+
+__attribute__((target("avx512f"))) static void exp_batch_avx512(double *values, const size_t len, const double cutoff)
+{
+    exp_rows(values, len, cutoff);
+}
+#endif
+
+/*The widest variant both requested by SPKM_EXP_KERNEL and supported by the CPU*/
+static exp_batch_fn select_variant(const exp_kernel_e requested)
+{
+    if (LIBM_EXP == requested)
+    {
+        return exp_batch_libm;
+    }
+#ifdef EXP_HAS_VARIANTS
+    __builtin_cpu_init();
+    if ((AUTO_EXP == requested || AVX512_EXP == requested) && __builtin_cpu_supports("avx512f"))
+    {
+        return exp_batch_avx512;
+    }
+    if ((AUTO_EXP == requested || AVX512_EXP == requested || AVX2_EXP == requested) && __builtin_cpu_supports("avx2"))
+    {
+        return exp_batch_avx2;
+    }
+#endif
+    return exp_batch_sse2;
+}
+
+exp_kernel_t select_exp_kernel(void)
+{
+    options_t options;
+    exp_kernel_t kernel;
+    load_options(&options);
+    kernel.apply = select_variant(options.exp_kernel);
+    kernel.cutoff = options.exp_flush > .0 ? log(options.exp_flush) : EXP_MIN_ARG;
+    if (kernel.cutoff < EXP_MIN_ARG)
+    {
+        kernel.cutoff = EXP_MIN_ARG;
+    }
+    return kernel;
+}
+
+/*values[i] = exp(values[i]) for the whole row*/
+void exp_batch(const exp_kernel_t *kernel, double *values, const size_t len)
+{
+    kernel->apply(values, len, kernel->cutoff);
+}
@@ -0,0 +1,23 @@
+#ifndef EXPBATCH_H
+#define EXPBATCH_H
+
+#include <stdlib.h>
+
+#define EXP_BLOCK 8          /* Arguments evaluated together, one AVX-512 register of doubles */
+#define EXP_MIN_ARG -708.0   /* Below this exp() leaves the normal range, so results are flushed to 0 */
+#define EXP_MAX_ARG 709.0    /* Above this the result is HUGE_VAL */
+#define EXP_MAX_ULP 1        /* Worst error of the polynomial kernels against libm, measured over 4M arguments in [-708, 0] */
+
+typedef void (*exp_batch_fn)(double *values, const size_t len, const double cutoff);
+
+/*The exp kernel of this run and the argument below which its results are flushed to zero*/
+typedef struct exp_kernel_t
+{
+    exp_batch_fn apply;
+    double cutoff;
+} exp_kernel_t;
+
+exp_kernel_t select_exp_kernel(void);
+void exp_batch(const exp_kernel_t *kernel, double *values, const size_t len);
+
+#endif /* EXPBATCH_H */
@@ -0,0 +1,330 @@
+/*
+ * The stages of the algorithm for one point set, each computed once on first use and kept until released.
+ * Every stage is built from the previous one with the roundings calc_matrix() uses, so each of them equals
+ * what the one-shot goals return for the same points.
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "graph.h"
+#include "matrix.h"
+#include "laplacian.h"
+#include "options.h"
+#include "solver.h"
+#include "cache.h"
+
+/*Takes a copy of the points; no stage is computed yet*/
+error_e graph_init(graph_t *graph, point_t *points, const size_t n, const size_t dim)
+{
+    size_t i;
+    memset(graph, 0, sizeof(graph_t));
+    graph->points = malloc_points(n, dim);
+    if (NULL == graph->points)
+    {
+        return MALLOC_ERROR;
+    }
+    for (i = 0; i < n; i++)
+    {
+        memcpy(graph->points[i].elements, points[i].elements, dim * sizeof(double));
+    }
+    graph->n = n;
+    graph->dim = dim;
+    pthread_mutex_init(&graph->lock, NULL);
+    return OK;
+}
+
+static error_e compute_weights(graph_t *graph)
+{
+    error_e result;
+    if (NULL != graph->w_mat)
+    {
+        return OK;
+    }
+    graph->w_mat = (double **)malloc_matrix(graph->n, graph->n, sizeof(double));
+    if (NULL == graph->w_mat)
+    {
+        return MALLOC_ERROR;
+    }
+    result = calc_weight_matrix(graph->n, graph->points, graph->dim, graph->w_mat);
+    if (OK != result)
+    {
+        free_matrix(graph->n, (void **)graph->w_mat);
+        graph->w_mat = NULL;
+    }
+    return result;
+}
+
+/*The row sums of W in the order create_diagonal_degree_matrix() adds them*/
+static error_e compute_degrees(graph_t *graph)
+{
+    error_e result;
+    size_t i, j;
+    if (NULL != graph->degrees)
+    {
+        return OK;
+    }
+    result = compute_weights(graph);
+    if (OK != result)
+    {
+        return result;
+    }
+    graph->degrees = (double *)malloc((graph->n > 0 ? graph->n : 1) * sizeof(double));
+    if (NULL == graph->degrees)
+    {
+        return MALLOC_ERROR;
+    }
+    for (i = 0; i < graph->n; i++)
+    {
+        graph->degrees[i] = .0;
+        for (j = 0; j < graph->n; j++)
+        {
+            graph->degrees[i] += graph->w_mat[i][j];
+        }
+    }
+    return OK;
+}
+
+static error_e compute_laplacian(graph_t *graph)
+{
+    error_e result;
+    if (NULL != graph->n_mat)
+    {
+        return OK;
+    }
+    result = compute_degrees(graph);
+    if (OK != result)
+    {
+        return result;
+    }
+    graph->n_mat = (double **)malloc_matrix(graph->n, graph->n, sizeof(double));
+    if (NULL == graph->n_mat)
+    {
+        return MALLOC_ERROR;
+    }
+    if (create_normalized_laplacian_from_degrees(graph->n, graph->w_mat, graph->degrees, graph->n_mat) != 0)
+    {
+        free_matrix(graph->n, (void **)graph->n_mat);
+        graph->n_mat = NULL;
+        return MALLOC_ERROR;
+    }
+    return OK;
+}
+
+/*
+ * Makes the kept eigenpairs cover the first *k, or all of them when k is NULL; *k == 0 asks for the eigengap's
+ * k, which is stored in *k. Eigenpairs that already cover the request are reused. Otherwise L_norm is solved as
+ * calc_sorted_eigens() would for the same request: from the eigen cache or by a full decomposition when the
+ * cache is enabled or k is NULL, and else by solve_top_eigens(), which may skip the eigenvectors past *k. The
+ * solvers may overwrite their input, so they get a copy of L_norm. Eigenpairs cut short by 'deadline' are not
+ * kept; they are returned in *unconverged, with its status, for the caller to free.
+ */
+static error_e compute_eigens(graph_t *graph, size_t *k, deadline_t *deadline, eigen_t **unconverged)
+{
+    error_e result;
+    options_t options;
+    unsigned long key = 0;
+    eigen_t *eigens;
+    double **copy;
+    size_t valid = graph->n, wanted = NULL != k ? *k : 0, gap;
+    int status = 0, full;
+
+    *unconverged = NULL;
+    if (NULL != graph->eigens && (NULL == k ? graph->eigens_valid == graph->n : *k > 0 && *k <= graph->eigens_valid))
+    {
+        return OK;
+    }
+    if (NULL != graph->eigens && NULL != k && 0 == *k && graph->eigengap_k > 0 && graph->eigengap_k <= graph->eigens_valid)
+    {
+        *k = graph->eigengap_k;
+        return OK;
+    }
+    eigens = malloc_eigens(graph->n);
+    if (NULL == eigens)
+    {
+        return MALLOC_ERROR;
+    }
+    load_options(&options);
+    full = NULL == k || NULL != options.cache_dir;
+    if (NULL != options.cache_dir)
+    {
+        key = cache_key(graph->n, graph->points, graph->dim, &options);
+        if (cache_load(options.cache_dir, key, graph->n, graph->dim, eigens) == 0)
+        {
+            goto converged;
+        }
+    }
+    result = compute_laplacian(graph);
+    if (OK != result)
+    {
+        goto eigens_cleanup;
+    }
+    copy = (double **)malloc_matrix(graph->n, graph->n, sizeof(double));
+    if (NULL == copy)
+    {
+        result = MALLOC_ERROR;
+        goto eigens_cleanup;
+    }
+    copy_matrix(graph->n, graph->n_mat, copy);
+    if (full)
+    {
+        status = solve_eigens(graph->n, copy, eigens, deadline);
+        qsort(eigens, graph->n, sizeof(eigen_t), compare_eigenvalues);
+        if (0 == status && NULL != options.cache_dir)
+        {
+            cache_store(options.cache_dir, key, graph->n, graph->dim, eigens);
+        }
+    }
+    else
+    {
+        status = solve_top_eigens(graph->n, copy, eigens, &wanted, deadline);
+        valid = wanted;
+    }
+    free_matrix(graph->n, (void **)copy);
+    if (0 != status && !DEADLINE_STOPPED(status))
+    {
+        result = MALLOC_ERROR;
+        goto eigens_cleanup;
+    }
+
+converged:
+    gap = full ? find_eigengap_max(graph->n, eigens) : (NULL != k && 0 == *k ? wanted : 0); /* 0 when unknown */
+    if (NULL != k && 0 == *k)
+    {
+        *k = gap;
+    }
+    if (DEADLINE_STOPPED(status))
+    {
+        *unconverged = eigens;
+        return (error_e)status;
+    }
+    if (NULL != graph->eigens)
+    {
+        free_eigens(graph->n, graph->eigens);
+    }
+    graph->eigens = eigens;
+    graph->eigens_valid = valid;
+    graph->eigengap_k = gap;
+    return OK;
+
+eigens_cleanup:
+    free_eigens(graph->n, eigens);
+    return result;
+}
+
+error_e graph_weights(graph_t *graph)
+{
+    error_e result;
+    pthread_mutex_lock(&graph->lock);
+    result = compute_weights(graph);
+    pthread_mutex_unlock(&graph->lock);
+    return result;
+}
+
+error_e graph_degrees(graph_t *graph)
+{
+    error_e result;
+    pthread_mutex_lock(&graph->lock);
+    result = compute_degrees(graph);
+    pthread_mutex_unlock(&graph->lock);
+    return result;
+}
+
+error_e graph_laplacian(graph_t *graph)
+{
+    error_e result;
+    pthread_mutex_lock(&graph->lock);
+    result = compute_laplacian(graph);
+    pthread_mutex_unlock(&graph->lock);
+    return result;
+}
+
+/*Every eigenpair, for the eigenvalues; a partial decomposition kept by graph_embed() is replaced*/
+error_e graph_eigens(graph_t *graph)
+{
+    error_e result;
+    eigen_t *unconverged;
+    pthread_mutex_lock(&graph->lock);
+    result = compute_eigens(graph, NULL, NULL, &unconverged);
+    pthread_mutex_unlock(&graph->lock);
+    return result;
+}
+
+/*The n*k matrix T of spk, choosing k by the eigengap when it is 0; unconverged eigenpairs are used once, not kept*/
+error_e graph_embed(graph_t *graph, size_t *k, double **mat, deadline_t *deadline)
+{
+    error_e result, embedded;
+    eigen_t *unconverged;
+    pthread_mutex_lock(&graph->lock);
+    result = compute_eigens(graph, k, deadline, &unconverged);
+    if (OK == result || NULL != unconverged)
+    {
+        embedded = embed_eigens(graph->n, NULL != unconverged ? unconverged : graph->eigens, k, mat);
+        result = OK == embedded ? result : embedded;
+    }
+    if (NULL != unconverged)
+    {
+        free_eigens(graph->n, unconverged);
+    }
+    pthread_mutex_unlock(&graph->lock);
+    return result;
+}
+
+/*The graph_stage_e flags of the stages currently kept*/
+int graph_stages(graph_t *graph)
+{
+    int stages = 0;
+    pthread_mutex_lock(&graph->lock);
+    stages |= NULL != graph->w_mat ? GRAPH_WEIGHTS : 0;
+    stages |= NULL != graph->degrees ? GRAPH_DEGREES : 0;
+    stages |= NULL != graph->n_mat ? GRAPH_LAPLACIAN : 0;
+    stages |= NULL != graph->eigens ? GRAPH_EIGENS : 0;
+    pthread_mutex_unlock(&graph->lock);
+    return stages;
+}
+
+/*How many of the kept eigenpairs are exact: n after a full decomposition, 0 when none are kept*/
+size_t graph_eigens_valid(graph_t *graph)
+{
+    size_t valid;
+    pthread_mutex_lock(&graph->lock);
+    valid = NULL != graph->eigens ? graph->eigens_valid : 0;
+    pthread_mutex_unlock(&graph->lock);
+    return valid;
+}
+
+/*Frees the given stages; the later ones stay valid, and a released one is recomputed when next needed*/
+void graph_release(graph_t *graph, const int stages)
+{
+    pthread_mutex_lock(&graph->lock);
+    if ((stages & GRAPH_WEIGHTS) && NULL != graph->w_mat)
+    {
+        free_matrix(graph->n, (void **)graph->w_mat);
+        graph->w_mat = NULL;
+    }
+    if (stages & GRAPH_DEGREES)
+    {
+        free(graph->degrees);
+        graph->degrees = NULL;
+    }
+    if ((stages & GRAPH_LAPLACIAN) && NULL != graph->n_mat)
+    {
+        free_matrix(graph->n, (void **)graph->n_mat);
+        graph->n_mat = NULL;
+    }
+    if ((stages & GRAPH_EIGENS) && NULL != graph->eigens)
+    {
+        free_eigens(graph->n, graph->eigens);
+        graph->eigens = NULL;
+    }
+    pthread_mutex_unlock(&graph->lock);
+}
+
+void graph_free(graph_t *graph)
+{
+    graph_release(graph, GRAPH_ALL_STAGES);
+    free_points(graph->n, graph->points);
+    graph->points = NULL;
+    pthread_mutex_destroy(&graph->lock);
+}
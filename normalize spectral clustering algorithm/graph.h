@@ -0,0 +1,47 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include <stdlib.h>
+#include <pthread.h>
+#include "point.h"
+#include "eigen.h"
+#include "deadline.h"
+#include "spkmeans.h"
+
+/*Bit flags naming the stages of a graph, for graph_stages() and graph_release()*/
+typedef enum graph_stage_e
+{
+    GRAPH_WEIGHTS = 1,
+    GRAPH_DEGREES = 2,
+    GRAPH_LAPLACIAN = 4,
+    GRAPH_EIGENS = 8,
+    GRAPH_ALL_STAGES = 15
+} graph_stage_e;
+
+/*A copy of the points and every stage computed from them so far; a NULL stage is computed on first use*/
+typedef struct graph_t
+{
+    size_t n;
+    size_t dim;
+    point_t *points;
+    double **w_mat;
+    double *degrees;      /* Row sums of w_mat, i.e. the diagonal of D */
+    double **n_mat;       /* L_norm */
+    eigen_t *eigens;      /* Eigenpairs of L_norm sorted as in section 1.3, of which the first 'eigens_valid' are exact */
+    size_t eigens_valid;  /* n after a full decomposition, else the k the partial one was asked for */
+    size_t eigengap_k;    /* The k chosen by the eigengap, 0 until one was chosen */
+    pthread_mutex_t lock; /* Held while a stage is computed or released */
+} graph_t;
+
+error_e graph_init(graph_t *graph, point_t *points, const size_t n, const size_t dim);
+error_e graph_weights(graph_t *graph);
+error_e graph_degrees(graph_t *graph);
+error_e graph_laplacian(graph_t *graph);
+error_e graph_eigens(graph_t *graph);
+error_e graph_embed(graph_t *graph, size_t *k, double **mat, deadline_t *deadline);
+int graph_stages(graph_t *graph);
+size_t graph_eigens_valid(graph_t *graph);
+void graph_release(graph_t *graph, const int stages);
+void graph_free(graph_t *graph);
+
+#endif /* GRAPH_H */
@@ -0,0 +1,248 @@
+/*
+ * Spectral clustering of a growing point set. Appending m points only evaluates the n*m + m*m new affinities
+ * and patches the degrees, in O(n*m) kernel evaluations, and restarts Jacobi from the previous eigenvectors
+ * instead of the unit matrix. The eigen step is not incremental: the new affinities change every old degree,
+ * so every entry of L_norm is rescaled, and the warm start rotates the whole of it into the old basis with two
+ * O(n^3) products before sweeping. A refresh therefore costs O(n^3) like a cold solve; what it saves are the
+ * Jacobi rotations, since the rotated matrix is already nearly diagonal.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "incremental.h"
+#include "jacobi.h"
+#include "matrix.h"
+#include "options.h"
+#include "solver.h"
+#include "distance.h"
+#include "expbatch.h"
+#include "blas.h"
+
+/*L_norm = I - D^-1/2 W D^-1/2 straight from W and the degrees, as section 1.1.3 but without forming D*/
+static void fill_normalized_laplacian(const size_t n, double **w_mat, double *degrees, double **n_mat)
+{
+    size_t i, j;
+    for (i = 0; i < n; i++)
+    {
+        for (j = 0; j < n; j++)
+        {
+            n_mat[i][j] = i == j ? 1.0 : -w_mat[i][j] / sqrt(degrees[i] * degrees[j]);
+        }
+    }
+}
+
+/*Recomputes the sorted eigenpairs of the current graph, warm-started from 'basis' when it is not NULL*/
+static error_e refresh_eigens(spk_state_t *state, double **basis, eigen_t *eigens)
+{
+    int result;
+    options_t options;
+    double **n_mat;
+
+    n_mat = (double **)malloc_matrix(state->n, state->n, sizeof(double));
+    if (NULL == n_mat)
+    {
+        return MALLOC_ERROR;
+    }
+    fill_normalized_laplacian(state->n, state->w_mat, state->degrees, n_mat);
+    load_options(&options);
+    if (NULL != basis && JACOBI_SOLVER == options.eigen_solver && !blas_enabled()) /* dsyevr beats even a warm Jacobi */
+    {
+        result = jacobi_warm(state->n, n_mat, basis, eigens);
+    }
+    else
+    {
+        result = solve_eigens(state->n, n_mat, eigens, NULL); /* Direct solvers gain nothing from a starting basis */
+    }
+    qsort(eigens, state->n, sizeof(eigen_t), compare_eigenvalues);
+    free_matrix(state->n, (void **)n_mat);
+    return 0 == result ? OK : MALLOC_ERROR;
+}
+
+/*Takes copies of the first n points and runs the full pipeline once*/
+error_e incremental_init(spk_state_t *state, point_t *points, const size_t n, const size_t dim)
+{
+    error_e result = MALLOC_ERROR;
+    size_t i, j;
+
+    state->n = n;
+    state->dim = dim;
+    state->points = malloc_points(n, dim);
+    state->w_mat = (double **)malloc_matrix(n, n, sizeof(double));
+    state->degrees = (double *)calloc(n, sizeof(double));
+    state->eigens = malloc_eigens(n);
+    if (NULL == state->points || NULL == state->w_mat || NULL == state->degrees || NULL == state->eigens)
+    {
+        goto error;
+    }
+    for (i = 0; i < n; i++)
+    {
+        memcpy(state->points[i].elements, points[i].elements, dim * sizeof(double));
+    }
+    create_weight_matrix(n, state->w_mat, state->points, dim);
+    for (i = 0; i < n; i++)
+    {
+        for (j = 0; j < n; j++)
+        {
+            state->degrees[i] += state->w_mat[i][j];
+        }
+    }
+    result = refresh_eigens(state, NULL, state->eigens);
+    if (OK == result)
+    {
+        return OK;
+    }
+
+error:
+    incremental_free(state);
+    return result;
+}
+
+/*
+ * Appends m points. Only the new rows and columns of W are evaluated; the old degrees are patched with the
+ * new columns. The previous eigenvectors, padded with the unit vectors of the new points, seed the solver.
+ * On failure the state is left as it was.
+ */
+error_e incremental_append(spk_state_t *state, point_t *points, const size_t m)
+{
+    error_e result = MALLOC_ERROR;
+    const size_t n = state->n, total = state->n + m;
+    const distance_kernel_t kernel = select_distance_kernel(state->dim);
+    const exp_kernel_t exp_kernel = select_exp_kernel();
+    point_t *new_points;
+    double *elements, **w_mat, **basis, *degrees, **old_w_mat, *old_degrees;
+    eigen_t *eigens;
+    size_t i, j;
+
+    if (0 == m)
+    {
+        return OK;
+    }
+    new_points = (point_t *)realloc(state->points, total * sizeof(point_t));
+    if (NULL == new_points)
+    {
+        return MALLOC_ERROR;
+    }
+    state->points = new_points;
+    /* The coordinates stay one block; growing it leaves the first n rows untouched should a later step fail */
+    elements = (double *)realloc(state->points[0].elements, total * state->dim * sizeof(double));
+    if (NULL == elements)
+    {
+        return MALLOC_ERROR;
+    }
+    for (i = 0; i < total; i++)
+    {
+        state->points[i].elements = elements + i * state->dim;
+    }
+    for (i = 0; i < m; i++)
+    {
+        memcpy(state->points[n + i].elements, points[i].elements, state->dim * sizeof(double));
+    }
+    w_mat = (double **)malloc_matrix(total, total, sizeof(double));
+    if (NULL == w_mat)
+    {
+        return MALLOC_ERROR;
+    }
+    degrees = (double *)malloc(total * sizeof(double));
+    if (NULL == degrees)
+    {
+        goto w_cleanup;
+    }
+    basis = (double **)malloc_matrix(total, total, sizeof(double));
+    if (NULL == basis)
+    {
+        goto degrees_cleanup;
+    }
+    eigens = malloc_eigens(total);
+    if (NULL == eigens)
+    {
+        goto basis_cleanup;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        memcpy(w_mat[i], state->w_mat[i], n * sizeof(double));
+        degrees[i] = state->degrees[i];
+    }
+    for (i = n; i < total; i++)
+    {
+        degrees[i] = .0;
+        w_mat[i][i] = .0;
+        for (j = 0; j < i; j++)
+        {
+            w_mat[i][j] = -kernel.distance(state->points[i].elements, state->points[j].elements, state->dim) / 2.0;
+        }
+        exp_batch(&exp_kernel, w_mat[i], i);
+        for (j = 0; j < i; j++)
+        {
+            w_mat[j][i] = w_mat[i][j];
+            degrees[i] += w_mat[i][j];
+            degrees[j] += w_mat[i][j];
+        }
+    }
+    for (i = 0; i < n; i++)
+    {
+        memcpy(basis[i], state->eigens[i].vector, n * sizeof(double));
+    }
+    for (i = n; i < total; i++)
+    {
+        basis[i][i] = 1.0;
+    }
+
+    old_w_mat = state->w_mat;
+    old_degrees = state->degrees;
+    state->n = total;
+    state->w_mat = w_mat;
+    state->degrees = degrees;
+    result = refresh_eigens(state, basis, eigens);
+    if (OK != result)
+    {
+        state->n = n;
+        state->w_mat = old_w_mat;
+        state->degrees = old_degrees;
+        free_eigens(total, eigens);
+        goto basis_cleanup;
+    }
+
+    free_eigens(n, state->eigens);
+    free_matrix(n, (void **)old_w_mat);
+    free(old_degrees);
+    state->eigens = eigens;
+    free_matrix(total, (void **)basis);
+    return OK;
+
+basis_cleanup:
+    free_matrix(total, (void **)basis);
+degrees_cleanup:
+    free(degrees);
+w_cleanup:
+    free_matrix(total, (void **)w_mat);
+    return result;
+}
+
+/*The row-normalized n*k matrix T of the current state, k chosen by the eigengap when it is 0*/
+error_e incremental_embed(spk_state_t *state, size_t *k, double **mat)
+{
+    return embed_eigens(state->n, state->eigens, k, mat);
+}
+
+void incremental_free(spk_state_t *state)
+{
+    if (NULL != state->points)
+    {
+        free_points(state->n, state->points);
+    }
+    if (NULL != state->w_mat)
+    {
+        free_matrix(state->n, (void **)state->w_mat);
+    }
+    free(state->degrees);
+    if (NULL != state->eigens)
+    {
+        free_eigens(state->n, state->eigens);
+    }
+    state->points = NULL;
+    state->w_mat = NULL;
+    state->degrees = NULL;
+    state->eigens = NULL;
+}
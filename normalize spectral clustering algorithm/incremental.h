@@ -0,0 +1,25 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <stdlib.h>
+#include "eigen.h"
+#include "point.h"
+#include "spkmeans.h"
+
+/*Everything an incremental refresh reuses from the previous one*/
+typedef struct spk_state_t
+{
+    size_t n;
+    size_t dim;
+    point_t *points;  /* Copies of every point seen so far */
+    double **w_mat;   /* The n*n weight matrix */
+    double *degrees;  /* Row sums of w_mat, i.e. the diagonal of D */
+    eigen_t *eigens;  /* Eigenpairs of the current L_norm, sorted as in section 1.3 */
+} spk_state_t;
+
+error_e incremental_init(spk_state_t *state, point_t *points, const size_t n, const size_t dim);
+error_e incremental_append(spk_state_t *state, point_t *points, const size_t m);
+error_e incremental_embed(spk_state_t *state, size_t *k, double **mat);
+void incremental_free(spk_state_t *state);
+
+#endif /* INCREMENTAL_H */
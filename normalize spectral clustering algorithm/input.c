@@ -49,11 +49,22 @@ size_t get_lines_count(char *filename)
     return lines;
 }
 
+/*Reads the next line of the file into 'point'*/
+void read_point(FILE *points_file, point_t *point, const size_t dim)
+{
+    size_t j;
+    for (j = 0; j < dim; j++)
+    {
+        fscanf(points_file, "%lf,", &(point->elements[j]));
+    }
+    fseek(points_file, 1, SEEK_CUR);
+}
+
 /*In this function we will read the text, and insert the points according to the format into the matrix*/
 int read_points(char *filename, point_t *points, const size_t points_len, const size_t dim)
 {
     FILE *points_file;
-    size_t i, j;
+    size_t i;
     points_file = fopen(filename, "r");
     if (NULL == points_file)
     {
@@ -62,11 +73,7 @@ int read_points(char *filename, point_t *points, const size_t points_len, const
 
     for (i = 0; i < points_len; i++)
     {
-        for (j = 0; j < dim; j++)
-        {
-            fscanf(points_file, "%lf,", &(points[i].elements[j]));
-        }
-        fseek(points_file, 1, SEEK_CUR);
+        read_point(points_file, &points[i], dim);
     }
     fclose(points_file);
     return 0;
@@ -5,9 +5,9 @@
 #include "matrix.h"
 #include "debug.h"
 #include "eigen.h"
-
-#define MAX_ITERATIONS 100
-#define EPSILON 0.00001
+#include "cache.h"
+#include "checkpoint.h"
+#include "parallel.h"
 
 /*Functions that return the values of θ, t, c, s according to the format in section 1.2.1-4*/
 double get_tetha(double **mat, const mat_index_t index)
@@ -80,28 +80,104 @@ void transform_rotation(const size_t n, double **mat, double **result, const siz
     result[i][j] = result[j][i] = 0.0;
 }
 
-/*function for sum of squares of all off-diagonal elements of A and A' respectively as described in 1.2.1-5*/
-double square_off_diagonal(const size_t n, double **mat)
+typedef struct off_diagonal_job_t
 {
+    size_t n;
+    double **mat;
+} off_diagonal_job_t;
+
+/*The squared off-diagonal entries of rows [begin, end)*/
+static double square_off_diagonal_rows(void *arg, const size_t begin, const size_t end)
+{
+    off_diagonal_job_t *job = (off_diagonal_job_t *)arg;
     size_t i, j;
     double result = 0.0;
-    for (i = 0; i < n; i++)
+    for (i = begin; i < end; i++)
     {
-        for (j = 0; j < n; j++)
+        for (j = 0; j < job->n; j++)
         {
             if (i != j)
             {
-                result += pow(mat[i][j], 2.0);
+                result += pow(job->mat[i][j], 2.0);
             }
         }
     }
     return result;
 }
 
+/*
+ * function for sum of squares of all off-diagonal elements of A and A' respectively as described in 1.2.1-5.
+ * Summed per JACOBI_REDUCE_GRAIN rows, in row order, so the value does not depend on the thread count
+ */
+double square_off_diagonal(const size_t n, double **mat)
+{
+    off_diagonal_job_t job;
+    double result;
+    job.n = n;
+    job.mat = mat;
+    if (parallel_reduce(n, JACOBI_REDUCE_GRAIN, square_off_diagonal_rows, &job, &result) != 0)
+    {
+        result = square_off_diagonal_rows(&job, 0, n);
+    }
+    return result;
+}
+
 /*Jacobian algorithm as shown in section 1.2.1*/
 int jacobi(const size_t n, double **mat, eigen_t *eigens)
 {
-    int result;
+    return jacobi_warm(n, mat, NULL, eigens);
+}
+
+/*
+ * Jacobi started from an orthonormal 'basis' (basis[i] is the i-th vector) instead of the unit matrix:
+ * the rotations are applied to B A B^T and accumulated onto B, so a basis close to the eigenvectors
+ * leaves only a few rotations to do. A NULL basis is the unit matrix.
+ */
+int jacobi_warm(const size_t n, double **mat, double **basis, eigen_t *eigens)
+{
+    return jacobi_until(n, mat, basis, eigens, NULL);
+}
+
+/*Hashes the matrix and rotations a run starts from, with the limits it runs under*/
+static unsigned long jacobi_key(const size_t n, double **mat, double **vectors)
+{
+    const double epsilon = JACOBI_EPSILON;
+    const unsigned long max_iterations = JACOBI_MAX_ITERATIONS;
+    unsigned long key = hash_bytes(FNV_OFFSET, &n, sizeof(n));
+    size_t i;
+    key = hash_bytes(key, &epsilon, sizeof(epsilon));
+    key = hash_bytes(key, &max_iterations, sizeof(max_iterations));
+    for (i = 0; i < n; i++)
+    {
+        key = hash_bytes(key, mat[i], n * sizeof(double));
+        key = hash_bytes(key, vectors[i], n * sizeof(double));
+    }
+    return key;
+}
+
+static void jacobi_save(checkpoint_t *checkpoint, const size_t n, const size_t iter, const double a_off_diag, const double convergence,
+                        double **mat, double **vectors)
+{
+    checkpoint_state_t state;
+    double **snapshot[2];
+    state.iteration = iter;
+    state.off_diagonal = a_off_diag;
+    state.convergence = convergence;
+    snapshot[0] = mat;
+    snapshot[1] = vectors;
+    checkpoint_save(checkpoint, &state, snapshot, 2, n, n);
+}
+
+/*
+ * jacobi_warm(), polling 'deadline' before every rotation. When it expires the current diagonal and accumulated
+ * rotations are returned as they are, with DEADLINE_TIMED_OUT or DEADLINE_CANCELLED instead of 0.
+ */
+int jacobi_until(const size_t n, double **mat, double **basis, eigen_t *eigens, deadline_t *deadline)
+{
+    checkpoint_t checkpoint;
+    checkpoint_state_t state;
+    double **snapshot[2];
+    int result, stopped = DEADLINE_LIVE;
     mat_index_t index;
     double **mat_cpy, **mat_tag, **rotation_mat, **vectors, **e_vectors, **temp;
     double tetha, t, c, s;
@@ -139,14 +215,37 @@ int jacobi(const size_t n, double **mat, eigen_t *eigens)
         result = 1;
         goto vectors_cleanup;
     }
-    init_eye_matrix(n, vectors); /* For the first iteration, we will set vectors to be the unit matrix */
-    copy_matrix(n, mat, mat_cpy);
+    if (NULL == basis)
+    {
+        init_eye_matrix(n, vectors); /* For the first iteration, we will set vectors to be the unit matrix */
+        copy_matrix(n, mat, mat_cpy);
+    }
+    else
+    {
+        transpose(n, basis, vectors);
+        multiply_blocked(n, n, n, basis, mat, mat_tag);
+        multiply_transposed_blocked(n, n, n, mat_tag, basis, mat_cpy);
+    }
 
     iter = 0;
     a_tag_off_diag = 0.0;
     convergence = a_off_diag = square_off_diagonal(n, mat_cpy);
-    while (convergence > EPSILON && iter < MAX_ITERATIONS) /* Algorithm stopping conditions as shown in section 1.2.1 -5 */
+    checkpoint_open(&checkpoint, JACOBI_CHECKPOINT, checkpoint_enabled() ? jacobi_key(n, mat_cpy, vectors) : 0);
+    snapshot[0] = mat_cpy;
+    snapshot[1] = vectors;
+    if (checkpoint_load(&checkpoint, &state, snapshot, 2, n, n) == 0) /* A run with the same input was interrupted: resume it */
     {
+        iter = state.iteration;
+        a_off_diag = state.off_diagonal;
+        convergence = state.convergence;
+    }
+    while (convergence > JACOBI_EPSILON && iter < JACOBI_MAX_ITERATIONS) /* Algorithm stopping conditions as shown in section 1.2.1 -5 */
+    {
+        stopped = deadline_check(deadline);
+        if (DEADLINE_LIVE != stopped)
+        {
+            break;
+        }
 
         index = find_max_off_diagonal(n, mat_cpy); /* Extracting i & j (pivot indexes) */
         i = index.i;
@@ -176,7 +275,16 @@ int jacobi(const size_t n, double **mat, eigen_t *eigens)
         }
 
         iter++;
+        if (checkpoint_due(&checkpoint))
+        {
+            jacobi_save(&checkpoint, n, iter, a_off_diag, convergence, mat_cpy, vectors);
+        }
+    }
+    if (DEADLINE_LIVE != stopped)
+    {
+        jacobi_save(&checkpoint, n, iter, a_off_diag, convergence, mat_cpy, vectors);
     }
+    checkpoint_close(&checkpoint, DEADLINE_LIVE == stopped);
 
     /*Here we will enter the eigens and the eigenvectors we got from the vectors matrix*/
     for (i = 0; i < n; i++)
@@ -187,6 +295,7 @@ int jacobi(const size_t n, double **mat, eigen_t *eigens)
             eigens[i].vector[j] = vectors[j][i];
         }
     }
+    result = stopped;
 
     free_matrix(n, (void **)e_vectors);
 vectors_cleanup:
@@ -3,6 +3,11 @@
 
 #include <stdlib.h>
 #include "eigen.h"
+#include "deadline.h"
+
+#define JACOBI_MAX_ITERATIONS 100
+#define JACOBI_EPSILON 0.00001
+#define JACOBI_REDUCE_GRAIN 64 /* Rows per partial sum of the off-diagonal norm */
 
 typedef struct mat_index_t
 {
@@ -11,5 +16,7 @@ typedef struct mat_index_t
 } mat_index_t;
 
 int jacobi(const size_t n, double **mat, eigen_t *eigens);
+int jacobi_warm(const size_t n, double **mat, double **basis, eigen_t *eigens);
+int jacobi_until(const size_t n, double **mat, double **basis, eigen_t *eigens, deadline_t *deadline);
 
 #endif /* JACOBI_H */
@@ -4,6 +4,12 @@
 #include <math.h>
 #include "kmeans.h"
 #include "point.h"
+#include "parallel.h"
+#include "distance.h"
+#include "cache.h"
+#include "checkpoint.h"
+#include "options.h"
+#include "dedup.h"
 
 #define DELIM ','
 #define EPSILON 0.01
@@ -18,18 +24,19 @@
 typedef struct clustered_point
 {
     point_t point;
+    double weight; /* How many equal rows it stands for */
     size_t cluster;
 } clustered_point_t;
 
-/* Assistive function for K-means - checks the closest cluster for a specific observation (vector) */
-size_t find_closest_cluster(point_t point, cluster_t *centroids, size_t k, size_t dim)
+/*The argmin over squared distances, with the kernel already picked for 'dim'*/
+static size_t closest_cluster(point_t point, cluster_t *centroids, size_t k, size_t dim, distance_fn squared)
 {
     size_t i;
     double distance, max_distance = DBL_MAX;
     size_t selected = k + 1;
     for (i = 0; i < k; i++)
     {
-        distance = calc_distance(point, centroids[i].centroid, dim);
+        distance = squared(point.elements, centroids[i].centroid.elements, dim);
         if (distance < max_distance)
         {
             max_distance = distance;
@@ -39,16 +46,23 @@ size_t find_closest_cluster(point_t point, cluster_t *centroids, size_t k, size_
     return selected;
 }
 
+/* Assistive function for K-means - checks the closest cluster for a specific observation (vector) */
+size_t find_closest_cluster(point_t point, cluster_t *centroids, size_t k, size_t dim)
+{
+    return closest_cluster(point, centroids, k, dim, select_distance_kernel(dim).squared);
+}
+
 
 int assign_to_clusters(clustered_point_t *points, size_t points_len, cluster_t *clusters, size_t k, size_t dim)
 {
+    const distance_fn squared = select_distance_kernel(dim).squared;
     size_t closest;
     size_t i;
     for (i = 0; i < points_len; i++)
     {
-        closest = find_closest_cluster(points[i].point, clusters, k, dim);
+        closest = closest_cluster(points[i].point, clusters, k, dim, squared);
         points[i].cluster = closest;
-        clusters[closest].size++;
+        clusters[closest].size += points[i].weight;
     }
     return FUNC_SUCCESS;
 }
@@ -79,7 +93,7 @@ double update_centroids(clustered_point_t *points, size_t points_len, cluster_t
         cluster = points[i].cluster;
         for (j = 0; j < dim; j++)
         {
-            axis_sum[cluster * dim + j] += points[i].point.elements[j] / clusters[cluster].size;
+            axis_sum[cluster * dim + j] += points[i].weight * points[i].point.elements[j] / clusters[cluster].size;
         }
     }
     for (i = 0; i < k; i++)
@@ -107,10 +121,73 @@ end:
 
 int fit(point_t *points, const size_t points_len, point_t *clusters, const size_t k, const size_t max_iter, const size_t dim, const float epsilon)
 {
-    int result = FUNC_SUCCESS;
+    return fit_with_stats(points, points_len, clusters, k, max_iter, dim, epsilon, NULL);
+}
+
+/*Labels every point with its closest final centroid and sums the squared distances*/
+static void collect_stats(clustered_point_t *points, size_t points_len, cluster_t *clusters, size_t k, size_t dim, fit_stats_t *stats)
+{
+    const distance_fn squared = select_distance_kernel(dim).squared;
+    size_t i, closest;
+    stats->inertia = .0;
+    for (i = 0; i < points_len; i++)
+    {
+        closest = closest_cluster(points[i].point, clusters, k, dim, squared);
+        stats->inertia += points[i].weight * squared(points[i].point.elements, clusters[closest].centroid.elements, dim);
+        if (NULL != stats->labels)
+        {
+            stats->labels[i] = closest;
+        }
+    }
+}
+
+int fit_with_stats(point_t *points, const size_t points_len, point_t *clusters, const size_t k, const size_t max_iter, const size_t dim, const float epsilon, fit_stats_t *stats)
+{
+    return fit_until(points, points_len, clusters, k, max_iter, dim, epsilon, stats, NULL);
+}
+
+/*Hashes the points and initial centroids a fit starts from, with the limits it runs under*/
+static unsigned long fit_key(point_t *points, const double *weights, const size_t points_len, point_t *clusters, const size_t k, const size_t max_iter, const size_t dim, const float epsilon)
+{
+    unsigned long key = hash_bytes(FNV_OFFSET, &points_len, sizeof(points_len));
     size_t i;
+    key = hash_bytes(key, &k, sizeof(k));
+    key = hash_bytes(key, &max_iter, sizeof(max_iter));
+    key = hash_bytes(key, &dim, sizeof(dim));
+    key = hash_bytes(key, &epsilon, sizeof(epsilon));
+    for (i = 0; i < points_len; i++)
+    {
+        key = hash_bytes(key, points[i].elements, dim * sizeof(double));
+    }
+    if (NULL != weights)
+    {
+        key = hash_bytes(key, weights, points_len * sizeof(double));
+    }
+    for (i = 0; i < k; i++)
+    {
+        key = hash_bytes(key, clusters[i].elements, dim * sizeof(double));
+    }
+    return key;
+}
+
+static void fit_save(checkpoint_t *checkpoint, const size_t iteration, const double max_delta, double **centroids, const size_t k, const size_t dim)
+{
+    checkpoint_state_t state;
+    state.iteration = iteration;
+    state.off_diagonal = .0;
+    state.convergence = max_delta;
+    checkpoint_save(checkpoint, &state, &centroids, 1, k, dim);
+}
+
+/*fit_until() on points standing for weights[i] equal rows each, or one each when 'weights' is NULL*/
+static int fit_weighted(point_t *points, const double *weights, const size_t points_len, point_t *clusters, const size_t k, const size_t max_iter, const size_t dim, const float epsilon, fit_stats_t *stats, deadline_t *deadline)
+{
+    int result = FUNC_SUCCESS;
+    size_t i, start = 0;
     clustered_point_t *clustered_points;
-    double max_delta;
+    double max_delta = .0, **centroids = NULL;
+    checkpoint_t checkpoint;
+    checkpoint_state_t state;
 
     cluster_t *k_clusters;
     k_clusters = (cluster_t *)malloc(k * sizeof(cluster_t));
@@ -134,24 +211,352 @@ int fit(point_t *points, const size_t points_len, point_t *clusters, const size_
     for (i = 0; i < points_len; i++)
     {
         clustered_points[i].point = points[i];
+        clustered_points[i].weight = NULL != weights ? weights[i] : 1;
     }
-    for (i = 0; i < max_iter; i++)
+    checkpoint_open(&checkpoint, FIT_CHECKPOINT, checkpoint_enabled() ? fit_key(points, weights, points_len, clusters, k, max_iter, dim, epsilon) : 0);
+    if (NULL != checkpoint.path)
     {
+        centroids = (double **)malloc(k * sizeof(double *)); /* The centroids as the rows of one matrix; without it the fit just does not checkpoint */
+        for (i = 0; NULL != centroids && i < k; i++)
+        {
+            centroids[i] = clusters[i].elements;
+        }
+        if (NULL != centroids && checkpoint_load(&checkpoint, &state, &centroids, 1, k, dim) == 0) /* An interrupted fit: resume it */
+        {
+            start = state.iteration;
+            max_delta = state.convergence;
+        }
+    }
+    for (i = start; i < max_iter; i++)
+    {
+        result = deadline_check(deadline);
+        if (DEADLINE_LIVE != result)
+        {
+            break;
+        }
         assign_to_clusters(clustered_points, points_len, k_clusters, k, dim);
         max_delta = update_centroids(clustered_points, points_len, k_clusters, k, dim);
         if (max_delta < .0)
         {
-            return FUNC_FAILED;
+            result = FUNC_FAILED;
+            goto clustered_points_cleanup;
         }
         else if (max_delta <= epsilon)
         {
+            i++;
             break;
         }
+        if (NULL != centroids && checkpoint_due(&checkpoint))
+        {
+            fit_save(&checkpoint, i + 1, max_delta, centroids, k, dim);
+        }
+    }
+    if (NULL != centroids && DEADLINE_STOPPED(result))
+    {
+        fit_save(&checkpoint, i, max_delta, centroids, k, dim);
+    }
+    if (NULL != stats)
+    {
+        stats->iterations = i;
+        collect_stats(clustered_points, points_len, k_clusters, k, dim, stats);
     }
 
+clustered_points_cleanup:
+    checkpoint_close(&checkpoint, !DEADLINE_STOPPED(result));
+    free(centroids);
     free(clustered_points);
 k_clusters_cleanup:
     free(k_clusters);
 end:
     return result;
 }
+
+/*
+ * The same, polling 'deadline' before every iteration. When it expires the centroids of the last completed
+ * iteration are kept, the stats describe them, and DEADLINE_TIMED_OUT or DEADLINE_CANCELLED is returned.
+ * With SPKM_DEDUP equal points are fitted once, weighted by their count, and the labels expanded back.
+ */
+int fit_until(point_t *points, const size_t points_len, point_t *clusters, const size_t k, const size_t max_iter, const size_t dim, const float epsilon, fit_stats_t *stats, deadline_t *deadline)
+{
+    int result;
+    options_t options;
+    dedup_t dedup;
+    fit_stats_t reduced;
+
+    load_options(&options);
+    if (!options.dedup || dedup_points(points, points_len, dim, .0, &dedup) != 0) /* Without the table every row is fitted */
+    {
+        return fit_weighted(points, NULL, points_len, clusters, k, max_iter, dim, epsilon, stats, deadline);
+    }
+    if (dedup.unique_len == points_len)
+    {
+        dedup_free(&dedup);
+        return fit_weighted(points, NULL, points_len, clusters, k, max_iter, dim, epsilon, stats, deadline);
+    }
+    reduced.labels = NULL;
+    if (NULL != stats && NULL != stats->labels)
+    {
+        reduced.labels = (size_t *)malloc(dedup.unique_len * sizeof(size_t));
+        if (NULL == reduced.labels)
+        {
+            result = MALLOC_FAILED;
+            goto dedup_cleanup;
+        }
+    }
+    result = fit_weighted(dedup.points, dedup.weights, dedup.unique_len, clusters, k, max_iter, dim, epsilon, NULL != stats ? &reduced : NULL, deadline);
+    if (NULL != stats && (FUNC_SUCCESS == result || DEADLINE_STOPPED(result)))
+    {
+        stats->inertia = reduced.inertia;
+        stats->iterations = reduced.iterations;
+        if (NULL != stats->labels)
+        {
+            dedup_expand_labels(&dedup, reduced.labels, stats->labels);
+        }
+    }
+    free(reduced.labels);
+
+dedup_cleanup:
+    dedup_free(&dedup);
+    return result;
+}
+
+/*A 64-bit linear congruential generator, so seeding is reproducible and every thread can own its state*/
+static double random_uniform(unsigned long *state)
+{
+    *state = *state * 6364136223846793005UL + 1442695040888963407UL;
+    return (double)(*state >> 11) / 9007199254740992.0;
+}
+
+/*
+ * K-means++ seeding of points standing for weights[i] rows each (one each when NULL): every row is as likely as
+ * the others to be the first centroid, and each next one is drawn proportionally to its squared distance from
+ * the chosen ones
+ */
+static int seed_weighted(point_t *points, const double *weights, const size_t points_len, const size_t dim, const size_t k, const unsigned long seed, size_t *indices)
+{
+    const distance_fn squared = select_distance_kernel(dim).squared;
+    size_t i, j;
+    unsigned long state = seed;
+    double *min_distance, distance, total, target;
+
+    if (0 == points_len || 0 == k || k > points_len)
+    {
+        return FUNC_FAILED;
+    }
+    min_distance = (double *)malloc(points_len * sizeof(double));
+    if (NULL == min_distance)
+    {
+        return MALLOC_FAILED;
+    }
+    total = .0;
+    for (i = 0; i < points_len; i++)
+    {
+        min_distance[i] = DBL_MAX;
+        total += NULL != weights ? weights[i] : 1;
+    }
+
+    if (NULL == weights)
+    {
+        indices[0] = (size_t)(random_uniform(&state) * points_len);
+    }
+    else
+    {
+        target = random_uniform(&state) * total;
+        for (i = 0; i < points_len - 1 && target >= weights[i]; i++)
+        {
+            target -= weights[i];
+        }
+        indices[0] = i;
+    }
+    for (j = 1; j < k; j++)
+    {
+        total = .0;
+        for (i = 0; i < points_len; i++)
+        {
+            distance = squared(points[i].elements, points[indices[j - 1]].elements, dim);
+            if (distance < min_distance[i])
+            {
+                min_distance[i] = distance;
+            }
+            total += (NULL != weights ? weights[i] : 1) * min_distance[i];
+        }
+        target = random_uniform(&state) * total;
+        for (i = 0; i < points_len - 1 && target >= (NULL != weights ? weights[i] : 1) * min_distance[i]; i++)
+        {
+            target -= (NULL != weights ? weights[i] : 1) * min_distance[i];
+        }
+        indices[j] = i;
+    }
+
+    free(min_distance);
+    return FUNC_SUCCESS;
+}
+
+int kmeanspp(point_t *points, const size_t points_len, const size_t dim, const size_t k, const unsigned long seed, size_t *indices)
+{
+    return seed_weighted(points, NULL, points_len, dim, k, seed, indices);
+}
+
+typedef struct restart_job_t
+{
+    point_t *points;
+    double *weights; /* NULL unless equal points were collapsed */
+    size_t points_len;
+    size_t k;
+    size_t max_iter;
+    size_t dim;
+    float epsilon;
+    point_t **centroids; /* One set of k centroids per run */
+    size_t **labels;     /* One labelling per run */
+    restart_stats_t *runs;
+    deadline_t *deadline;
+} restart_job_t;
+
+/*A single restart: its own k-means++ seeding followed by a full fit, reading the shared points only*/
+static void restart_task(void *arg, const size_t index)
+{
+    restart_job_t *job = (restart_job_t *)arg;
+    restart_stats_t *run = &job->runs[index];
+    fit_stats_t stats;
+    size_t *seeds, i, j;
+
+    run->status = MALLOC_FAILED;
+    run->inertia = DBL_MAX;
+    run->iterations = 0;
+    seeds = (size_t *)malloc(job->k * sizeof(size_t));
+    job->centroids[index] = malloc_points(job->k, job->dim);
+    job->labels[index] = (size_t *)malloc(job->points_len * sizeof(size_t));
+    if (NULL == seeds || NULL == job->centroids[index] || NULL == job->labels[index])
+    {
+        goto end;
+    }
+    run->status = seed_weighted(job->points, job->weights, job->points_len, job->dim, job->k, run->seed, seeds);
+    if (FUNC_SUCCESS != run->status)
+    {
+        goto end;
+    }
+    for (i = 0; i < job->k; i++)
+    {
+        for (j = 0; j < job->dim; j++)
+        {
+            job->centroids[index][i].elements[j] = job->points[seeds[i]].elements[j];
+        }
+    }
+    stats.labels = job->labels[index];
+    run->status = fit_weighted(job->points, job->weights, job->points_len, job->centroids[index], job->k, job->max_iter, job->dim, job->epsilon, &stats, job->deadline);
+    if (FUNC_SUCCESS == run->status || DEADLINE_STOPPED(run->status))
+    {
+        run->inertia = stats.inertia;
+        run->iterations = stats.iterations;
+    }
+end:
+    free(seeds);
+}
+
+/*
+ * Runs 'restarts' independently seeded fits concurrently and keeps the one with the lowest inertia.
+ * The winning centroids are copied into 'clusters' and, when 'labels' is not NULL, its labelling too.
+ * Runs cut short by 'deadline' still compete, and the reason they stopped is returned. With SPKM_DEDUP the
+ * runs fit the distinct points, weighted by their count, when there are at least k of them.
+ */
+int fit_restarts(point_t *points, const size_t points_len, point_t *clusters, const size_t k, const size_t max_iter, const size_t dim, const float epsilon, const size_t restarts, const unsigned long seed, size_t *labels, restart_stats_t *runs, size_t *best, deadline_t *deadline)
+{
+    int result = FUNC_SUCCESS;
+    restart_job_t job;
+    options_t options;
+    dedup_t dedup;
+    size_t r, i, j;
+
+    if (0 == restarts || 0 == k || k > points_len)
+    {
+        return FUNC_FAILED;
+    }
+    load_options(&options);
+    dedup.n = 0;
+    if (options.dedup && dedup_points(points, points_len, dim, .0, &dedup) == 0 && (dedup.unique_len == points_len || dedup.unique_len < k))
+    {
+        dedup_free(&dedup);
+        dedup.n = 0; /* Nothing to collapse, or too few distinct points to seed k centroids */
+    }
+    job.centroids = (point_t **)calloc(restarts, sizeof(point_t *));
+    job.labels = (size_t **)calloc(restarts, sizeof(size_t *));
+    if (NULL == job.centroids || NULL == job.labels)
+    {
+        result = MALLOC_FAILED;
+        goto end;
+    }
+    job.points = dedup.n > 0 ? dedup.points : points;
+    job.weights = dedup.n > 0 ? dedup.weights : NULL;
+    job.points_len = dedup.n > 0 ? dedup.unique_len : points_len;
+    job.k = k;
+    job.max_iter = max_iter;
+    job.dim = dim;
+    job.epsilon = epsilon;
+    job.runs = runs;
+    job.deadline = deadline;
+    for (r = 0; r < restarts; r++)
+    {
+        runs[r].seed = seed + r * 0x9e3779b97f4a7c15UL; /* Spreads consecutive runs apart in the generator's sequence */
+    }
+    if (parallel_for(restarts, restart_task, &job) != 0)
+    {
+        result = MALLOC_FAILED;
+        goto end;
+    }
+
+    *best = restarts;
+    for (r = 0; r < restarts; r++)
+    {
+        if ((FUNC_SUCCESS == runs[r].status || DEADLINE_STOPPED(runs[r].status)) && (restarts == *best || runs[r].inertia < runs[*best].inertia))
+        {
+            *best = r;
+        }
+        if (DEADLINE_STOPPED(runs[r].status))
+        {
+            result = runs[r].status;
+        }
+    }
+    if (restarts == *best)
+    {
+        result = runs[0].status;
+        goto end;
+    }
+    for (i = 0; i < k; i++)
+    {
+        for (j = 0; j < dim; j++)
+        {
+            clusters[i].elements[j] = job.centroids[*best][i].elements[j];
+        }
+    }
+    if (NULL != labels && dedup.n > 0)
+    {
+        dedup_expand_labels(&dedup, job.labels[*best], labels);
+    }
+    else if (NULL != labels)
+    {
+        for (i = 0; i < points_len; i++)
+        {
+            labels[i] = job.labels[*best][i];
+        }
+    }
+
+end:
+    for (r = 0; NULL != job.centroids && r < restarts; r++)
+    {
+        if (NULL != job.centroids[r])
+        {
+            free_points(k, job.centroids[r]);
+        }
+    }
+    for (r = 0; NULL != job.labels && r < restarts; r++)
+    {
+        free(job.labels[r]);
+    }
+    free(job.centroids);
+    free(job.labels);
+    if (dedup.n > 0)
+    {
+        dedup_free(&dedup);
+    }
+    return result;
+}
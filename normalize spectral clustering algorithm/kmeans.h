@@ -2,13 +2,34 @@
 #define KMEANS_H
 
 #include "point.h"
+#include "deadline.h"
 
 typedef struct cluster
 {
     point_t centroid;
-    size_t size;
+    double size; /* The total weight of its points, which is their count unless they were collapsed */
 } cluster_t;
 
+typedef struct fit_stats_t
+{
+    size_t *labels; /* Optional, points_len entries; filled with the final assignment */
+    double inertia;  /* Sum of squared distances of the points to their centroids */
+    size_t iterations;
+} fit_stats_t;
+
+typedef struct restart_stats_t
+{
+    unsigned long seed;
+    double inertia;
+    size_t iterations;
+    int status; /* 0, or DEADLINE_TIMED_OUT / DEADLINE_CANCELLED for a run cut short, whose stats are still valid */
+} restart_stats_t;
+
+size_t find_closest_cluster(point_t point, cluster_t *centroids, size_t k, size_t dim);
 int fit(point_t *points, const size_t points_len, point_t *clusters, const size_t k, const size_t max_iter, const size_t dim, const float epsilon);
+int fit_with_stats(point_t *points, const size_t points_len, point_t *clusters, const size_t k, const size_t max_iter, const size_t dim, const float epsilon, fit_stats_t *stats);
+int fit_until(point_t *points, const size_t points_len, point_t *clusters, const size_t k, const size_t max_iter, const size_t dim, const float epsilon, fit_stats_t *stats, deadline_t *deadline);
+int fit_restarts(point_t *points, const size_t points_len, point_t *clusters, const size_t k, const size_t max_iter, const size_t dim, const float epsilon, const size_t restarts, const unsigned long seed, size_t *labels, restart_stats_t *runs, size_t *best, deadline_t *deadline);
+int kmeanspp(point_t *points, const size_t points_len, const size_t dim, const size_t k, const unsigned long seed, size_t *indices);
 
 #endif /* KMEANS_H */
@@ -52,3 +52,79 @@ l_mat_cleanup:
 end:
     return result;
 }
+
+/*
+ * L_norm from W and its row sums without forming D or L. Each entry gets the roundings of
+ * create_laplacian_matrix() followed by create_normalized_laplacian_matrix(), so the result is the same.
+ */
+int create_normalized_laplacian_from_degrees(const size_t n, double **w_mat, double *degrees, double **n_mat)
+{
+    const int diagonal = TRUE == is_diagonal(n, w_mat); /* multiply_mat() then only writes the diagonal */
+    double *scale;
+    size_t i, j;
+    scale = (double *)malloc((n > 0 ? n : 1) * sizeof(double));
+    if (NULL == scale)
+    {
+        return 1;
+    }
+    for (i = 0; i < n; i++)
+    {
+        scale[i] = sqrt(1 / degrees[i]);
+    }
+    for (i = 0; i < n; i++)
+    {
+        for (j = 0; j < n; j++)
+        {
+            if (i == j)
+            {
+                n_mat[i][j] = scale[i] * degrees[i] * scale[i];
+            }
+            else
+            {
+                n_mat[i][j] = diagonal ? .0 : scale[i] * -w_mat[i][j] * scale[j];
+            }
+        }
+    }
+    free(scale);
+    return 0;
+}
+
+/*
+ * L_norm of a point set restricted to the vectors that are constant on every group of equal points, as an n*n
+ * matrix over the groups with weights[u] rows each. Every row of group u has degree
+ * d_u = sum_v weights[v] w_uv + weights[u] - 1, the last term being its affinities of exp(0) = 1 to the rows
+ * equal to it. With y_u = sqrt(weights[u]) x_u the restriction is symmetric: 1 - (weights[u] - 1) / d_u on the
+ * diagonal and -sqrt(weights[u] / d_u) w_uv sqrt(weights[v] / d_v) elsewhere.
+ */
+int create_collapsed_laplacian(const size_t n, double **w_mat, double *weights, double **n_mat)
+{
+    double *degrees, *scale;
+    size_t i, j;
+    degrees = (double *)malloc((n > 0 ? n : 1) * sizeof(double));
+    scale = (double *)malloc((n > 0 ? n : 1) * sizeof(double));
+    if (NULL == degrees || NULL == scale)
+    {
+        free(degrees);
+        free(scale);
+        return 1;
+    }
+    for (i = 0; i < n; i++)
+    {
+        degrees[i] = weights[i] - 1;
+        for (j = 0; j < n; j++)
+        {
+            degrees[i] += weights[j] * w_mat[i][j];
+        }
+        scale[i] = sqrt(weights[i] / degrees[i]);
+    }
+    for (i = 0; i < n; i++)
+    {
+        for (j = 0; j < n; j++)
+        {
+            n_mat[i][j] = i != j ? scale[i] * -w_mat[i][j] * scale[j] : 1 - (weights[i] - 1) / degrees[i];
+        }
+    }
+    free(degrees);
+    free(scale);
+    return 0;
+}
@@ -3,5 +3,7 @@
 
 int create_laplacian_matrix(const size_t n, double **w_mat, double **d_mat, double **l_mat);
 int create_normalized_laplacian_matrix(const size_t n, double **l_mat, double **n_mat);
+int create_normalized_laplacian_from_degrees(const size_t n, double **w_mat, double *degrees, double **n_mat);
+int create_collapsed_laplacian(const size_t n, double **w_mat, double *weights, double **n_mat);
 
 #endif /* LAPLACIAN_H */
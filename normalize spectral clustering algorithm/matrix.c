@@ -3,6 +3,9 @@
 #include <stdlib.h>
 #include <math.h>
 #include "matrix.h"
+#include "parallel.h"
+#include "blas.h"
+#include "alloc.h"
 
 double row_norm(const size_t n, double **mat, const size_t row);
 
@@ -10,21 +13,23 @@ double row_norm(const size_t n, double **mat, const size_t row);
 void **malloc_matrix(const size_t n, const size_t k, size_t elem_size)
 {
     size_t i;
-    void **matrix = malloc(n * sizeof(void *));
+    char *values;
+    void **matrix = malloc((n > 0 ? n : 1) * sizeof(void *));
     if (NULL == matrix)
     {
         return NULL;
     }
-    for (i = 0; i < n; i++)
+    values = (char *)alloc_block(n * k * elem_size, MATRIX_TILE * k * elem_size); /* One block, placed along the row tiles of the products */
+    if (NULL == values)
     {
-        matrix[i] = calloc(k, elem_size);
+        free(matrix);
+        return NULL;
     }
-
-    /* void *values = calloc(n * k, elem_size);
     for (i = 0; i < n; i++)
     {
-        matrix[i] = values + i * n * elem_size;
-    } */
+        matrix[i] = values + i * k * elem_size;
+    }
+    matrix[0] = values; /* Also for n == 0, so free_matrix() always finds the block */
 
     return matrix;
 }
@@ -32,11 +37,8 @@ void **malloc_matrix(const size_t n, const size_t k, size_t elem_size)
 /*A function to free the memory space for a matrix*/
 void free_matrix(const size_t n, void **matrix)
 {
-    size_t i;
-    for (i = 0; i < n; i++)
-    {
-        free(matrix[i]);
-    }
+    (void)n;
+    free_block(matrix[0]);
     free(matrix);
 }
 
@@ -104,7 +106,7 @@ void multiply_mat(const size_t n, double **left_mat, double **right_mat, double
             }
         }
     }
-    else
+    else if (blas_multiply(n, n, n, left_mat, right_mat, result, FALSE) != 0)
     {
         for (i = 0; i < n; i++)
         {
@@ -120,6 +122,105 @@ void multiply_mat(const size_t n, double **left_mat, double **right_mat, double
     }
 }
 
+typedef struct product_job_t
+{
+    size_t n, m, p;
+    size_t col_tiles;
+    int transposed;
+    double **left_mat, **right_mat, **result;
+} product_job_t;
+
+/*Computes one MATRIX_TILE x MATRIX_TILE tile of the result, so the tiles can be shared out between threads*/
+static void product_tile(void *arg, const size_t index)
+{
+    product_job_t *job = (product_job_t *)arg;
+    size_t i, j, k, i_end, j_end;
+    const size_t i_start = (index / job->col_tiles) * MATRIX_TILE, j_start = (index % job->col_tiles) * MATRIX_TILE;
+    double factor, sum, *row;
+
+    i_end = i_start + MATRIX_TILE < job->n ? i_start + MATRIX_TILE : job->n;
+    j_end = j_start + MATRIX_TILE < job->p ? j_start + MATRIX_TILE : job->p;
+    for (i = i_start; i < i_end; i++)
+    {
+        row = job->result[i];
+        if (job->transposed)
+        {
+            for (j = j_start; j < j_end; j++)
+            {
+                sum = .0;
+                for (k = 0; k < job->m; k++)
+                {
+                    sum += job->left_mat[i][k] * job->right_mat[j][k]; /* Both operands are read along their rows */
+                }
+                row[j] = sum;
+            }
+            continue;
+        }
+        for (j = j_start; j < j_end; j++)
+        {
+            row[j] = .0;
+        }
+        for (k = 0; k < job->m; k++)
+        {
+            factor = job->left_mat[i][k];
+            for (j = j_start; j < j_end; j++)
+            {
+                row[j] += factor * job->right_mat[k][j];
+            }
+        }
+    }
+}
+
+static void multiply_tiles(product_job_t *job)
+{
+    size_t row_tiles = (job->n + MATRIX_TILE - 1) / MATRIX_TILE;
+    job->col_tiles = (job->p + MATRIX_TILE - 1) / MATRIX_TILE;
+    if (parallel_for(row_tiles * job->col_tiles, product_tile, job) != 0)
+    {
+        size_t i;
+        for (i = 0; i < row_tiles * job->col_tiles; i++)
+        {
+            product_tile(job, i);
+        }
+    }
+}
+
+/*Tiled, multithreaded product of an n*m and an m*p matrix into the n*p 'result'*/
+void multiply_blocked(const size_t n, const size_t m, const size_t p, double **left_mat, double **right_mat, double **result)
+{
+    product_job_t job;
+    job.n = n;
+    job.m = m;
+    job.p = p;
+    if (0 == blas_multiply(n, m, p, left_mat, right_mat, result, FALSE))
+    {
+        return;
+    }
+    job.transposed = FALSE;
+    job.left_mat = left_mat;
+    job.right_mat = right_mat;
+    job.result = result;
+    multiply_tiles(&job);
+}
+
+/*The same for left * right^T, where 'right_mat' is p*m*/
+void multiply_transposed_blocked(const size_t n, const size_t m, const size_t p, double **left_mat, double **right_mat, double **result)
+{
+    product_job_t job;
+    job.n = n;
+    job.m = m;
+    job.p = p;
+    if (0 == blas_multiply(n, m, p, left_mat, right_mat, result, TRUE))
+    {
+        return;
+    }
+    job.transposed = TRUE;
+    job.left_mat = left_mat;
+    job.right_mat = right_mat;
+    job.result = result;
+    multiply_tiles(&job);
+}
+
 /*Matrix copy function*/
 void copy_matrix(const size_t n, double **src, double **dst)
 {
@@ -3,11 +3,14 @@
 
 #define TRUE 1
 #define FALSE 0
+#define MATRIX_TILE 64 /* Rows and columns per tile of the blocked products */
 
 void **malloc_matrix(const size_t n, const size_t k, size_t elem_size);
 void free_matrix(const size_t n, void **matrix);
 
 void multiply_mat(const size_t n, double **left_mat, double **right_mat, double **result);
+void multiply_blocked(const size_t n, const size_t m, const size_t p, double **left_mat, double **right_mat, double **result);
+void multiply_transposed_blocked(const size_t n, const size_t m, const size_t p, double **left_mat, double **right_mat, double **result);
 int is_diagonal(const size_t n, double **mat);
 
 int transpose(const size_t n, double **mat, double **transposed);
@@ -0,0 +1,240 @@
+/*
+ * Out-of-sample labelling through the Nystrom extension. L_norm = I - D^-1/2 W D^-1/2, so an eigenvector u
+ * with eigenvalue value satisfies u(i) = sum_j w_ij u(j) / (sqrt(d_i d_j) (1 - value)). Evaluating the right
+ * side for a new point x only needs its affinities to the training points; the sqrt(d_x) factor is dropped
+ * since the embedded row is normalized anyway. A query equal to a training point is taken to be that point,
+ * the first one in training order, and reproduces its row: only it is left out, as W's zero diagonal leaves it
+ * out of its own row, while its duplicates keep their affinity of exp(0) = 1.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+#include "model.h"
+#include "eigen.h"
+#include "matrix.h"
+#include "parallel.h"
+#include "distance.h"
+#include "expbatch.h"
+
+#define MIN_SPECTRAL_DISTANCE 1e-12 /* Keeps 1 - value away from zero for eigenvalues at 1 */
+#define PREDICT_BLOCK 64            /* Queries handled per parallel task */
+
+typedef struct predict_job_t
+{
+    spk_model_t *model;
+    point_t *queries;
+    size_t queries_len;
+    size_t *labels;
+    exp_kernel_t exp_kernel;
+} predict_job_t;
+
+/*Embeds one query into 'row' and returns its closest centroid*/
+static size_t predict_one(spk_model_t *model, point_t query, double *weights, double *row, distance_fn distance_to,
+                          const exp_kernel_t *exp_kernel)
+{
+    size_t i, j, self = model->n;
+    double norm, sum, distance;
+    point_t embedded;
+    for (i = 0; i < model->n; i++)
+    {
+        distance = distance_to(query.elements, model->points[i].elements, model->dim);
+        weights[i] = -distance / 2.0;
+        self = model->n == self && distance <= .0 ? i : self;
+    }
+    if (self < model->n)
+    {
+        weights[self] = -HUGE_VAL; /* W has a zero diagonal, so a training point is not its own neighbour */
+    }
+    exp_batch(exp_kernel, weights, model->n);
+    norm = .0;
+    for (j = 0; j < model->k; j++)
+    {
+        sum = .0;
+        for (i = 0; i < model->n; i++)
+        {
+            sum += weights[i] * model->extension[j][i];
+        }
+        row[j] = sum;
+        norm += sum * sum;
+    }
+    norm = sqrt(norm);
+    for (j = 0; norm > .0 && j < model->k; j++)
+    {
+        row[j] /= norm;
+    }
+    embedded.elements = row;
+    return find_closest_cluster(embedded, model->clusters, model->k, model->k);
+}
+
+static void predict_task(void *arg, const size_t index)
+{
+    predict_job_t *job = (predict_job_t *)arg;
+    const distance_fn distance = select_distance_kernel(job->model->dim).distance;
+    size_t q, end = (index + 1) * PREDICT_BLOCK;
+    double *weights;
+    weights = (double *)malloc((job->model->n + job->model->k) * sizeof(double));
+    if (NULL == weights)
+    {
+        for (q = index * PREDICT_BLOCK; q < end && q < job->queries_len; q++)
+        {
+            job->labels[q] = job->model->k; /* Out of range marks a query that could not be labelled */
+        }
+        return;
+    }
+    for (q = index * PREDICT_BLOCK; q < end && q < job->queries_len; q++)
+    {
+        job->labels[q] = predict_one(job->model, job->queries[q], weights, weights + job->model->n, distance, &job->exp_kernel);
+    }
+    free(weights);
+}
+
+/*Fits the model: the sorted eigenpairs, the embedding of the training points and k-means over it*/
+error_e model_fit(spk_model_t *model, point_t *points, const size_t n, const size_t dim, size_t k, const size_t max_iter, const float epsilon, const size_t restarts, const unsigned long seed)
+{
+    error_e result = MALLOC_ERROR;
+    eigen_t *eigens;
+    double **t_mat, spectral_distance;
+    point_t *embedded;
+    restart_stats_t *runs;
+    size_t i, j, best;
+
+    memset(model, 0, sizeof(*model));
+    if (0 == n || k > n)
+    {
+        return INVALID_INPUT;
+    }
+    eigens = malloc_eigens(n);
+    if (NULL == eigens)
+    {
+        return MALLOC_ERROR;
+    }
+    result = calc_sorted_eigens(n, points, dim, eigens, &k, NULL);
+    if (OK != result)
+    {
+        goto eigens_cleanup;
+    }
+    result = MALLOC_ERROR;
+
+    model->n = n;
+    model->dim = dim;
+    model->k = k;
+    model->points = malloc_points(n, dim);
+    model->degrees = (double *)malloc(n * sizeof(double));
+    model->values = (double *)malloc(k * sizeof(double));
+    model->extension = (double **)malloc_matrix(k, n, sizeof(double));
+    model->clusters = (cluster_t *)malloc(k * sizeof(cluster_t));
+    model->labels = (size_t *)malloc(n * sizeof(size_t));
+    model->centroids = malloc_points(k, k);
+    t_mat = (double **)malloc_matrix(n, k, sizeof(double));
+    embedded = (point_t *)malloc(n * sizeof(point_t));
+    runs = (restart_stats_t *)malloc((restarts > 0 ? restarts : 1) * sizeof(restart_stats_t));
+    if (NULL == model->points || NULL == model->degrees || NULL == model->values || NULL == model->extension ||
+        NULL == model->clusters || NULL == model->labels || NULL == model->centroids || NULL == t_mat || NULL == embedded || NULL == runs)
+    {
+        goto fit_cleanup;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        memcpy(model->points[i].elements, points[i].elements, dim * sizeof(double));
+    }
+    if (0 != create_degree_vector(n, model->degrees, model->points, dim))
+    {
+        goto fit_cleanup;
+    }
+    for (j = 0; j < k; j++)
+    {
+        model->values[j] = eigens[j].value;
+        spectral_distance = 1.0 - eigens[j].value;
+        if (fabs(spectral_distance) < MIN_SPECTRAL_DISTANCE)
+        {
+            spectral_distance = spectral_distance < .0 ? -MIN_SPECTRAL_DISTANCE : MIN_SPECTRAL_DISTANCE;
+        }
+        for (i = 0; i < n; i++)
+        {
+            model->extension[j][i] = eigens[j].vector[i] / (sqrt(model->degrees[i]) * spectral_distance);
+        }
+    }
+
+    embed_eigens(n, eigens, &k, t_mat);
+    for (i = 0; i < n; i++)
+    {
+        embedded[i].elements = t_mat[i];
+    }
+    if (fit_restarts(embedded, n, model->centroids, k, max_iter, k, epsilon, restarts > 0 ? restarts : 1, seed, model->labels, runs, &best, NULL) != 0)
+    {
+        goto fit_cleanup;
+    }
+    for (i = 0; i < k; i++)
+    {
+        model->clusters[i].centroid = model->centroids[i];
+        model->clusters[i].size = 0;
+    }
+    result = OK;
+
+fit_cleanup:
+    free(runs);
+    free(embedded);
+    if (NULL != t_mat)
+    {
+        free_matrix(n, (void **)t_mat);
+    }
+    if (OK != result)
+    {
+        model_free(model);
+    }
+eigens_cleanup:
+    free_eigens(n, eigens);
+    return result;
+}
+
+/*Labels a batch of new points, sharing the batch out over the worker threads*/
+error_e model_predict(spk_model_t *model, point_t *queries, const size_t queries_len, size_t *labels)
+{
+    predict_job_t job;
+    size_t i;
+    job.model = model;
+    job.queries = queries;
+    job.queries_len = queries_len;
+    job.labels = labels;
+    job.exp_kernel = select_exp_kernel();
+    if (queries_len <= PREDICT_BLOCK)
+    {
+        predict_task(&job, 0); /* A single block is not worth waking threads for */
+    }
+    else if (parallel_for((queries_len + PREDICT_BLOCK - 1) / PREDICT_BLOCK, predict_task, &job) != 0)
+    {
+        return MALLOC_ERROR;
+    }
+    for (i = 0; i < queries_len; i++)
+    {
+        if (labels[i] >= model->k)
+        {
+            return MALLOC_ERROR;
+        }
+    }
+    return OK;
+}
+
+void model_free(spk_model_t *model)
+{
+    if (NULL != model->points)
+    {
+        free_points(model->n, model->points);
+    }
+    free(model->degrees);
+    free(model->values);
+    if (NULL != model->extension)
+    {
+        free_matrix(model->k, (void **)model->extension);
+    }
+    if (NULL != model->centroids)
+    {
+        free_points(model->k, model->centroids);
+    }
+    free(model->clusters);
+    free(model->labels);
+    memset(model, 0, sizeof(*model));
+}
@@ -0,0 +1,28 @@
+#ifndef MODEL_H
+#define MODEL_H
+
+#include <stdlib.h>
+#include "point.h"
+#include "kmeans.h"
+#include "spkmeans.h"
+
+/*A fitted spectral clustering that can label new points without refitting*/
+typedef struct spk_model_t
+{
+    size_t n;
+    size_t dim;
+    size_t k;
+    point_t *points;      /* The training points */
+    double *degrees;      /* Diagonal of D over the training points */
+    double *values;       /* The k eigenvalues of L_norm used for the embedding */
+    double **extension;   /* extension[j][i] = u_j(i) / (sqrt(d_i) * (1 - value_j)), the Nystrom weights */
+    point_t *centroids;   /* k centroids in the k-dimensional embedding */
+    cluster_t *clusters;  /* The centroids as find_closest_cluster expects them */
+    size_t *labels;       /* Labels of the training points */
+} spk_model_t;
+
+error_e model_fit(spk_model_t *model, point_t *points, const size_t n, const size_t dim, size_t k, const size_t max_iter, const float epsilon, const size_t restarts, const unsigned long seed);
+error_e model_predict(spk_model_t *model, point_t *queries, const size_t queries_len, size_t *labels);
+void model_free(spk_model_t *model);
+
+#endif /* MODEL_H */
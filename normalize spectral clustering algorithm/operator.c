@@ -0,0 +1,352 @@
+/*
+ * The normalized graph Laplacian as an operator. Iterative eigensolvers only need products L_norm x, and those
+ * can be formed from the points directly: the affinities are recomputed a tile at a time, used for every vector
+ * of the block at once and dropped, so memory is O(n dim + n block) instead of the n*n of the dense L_norm.
+ * Vectors are kept as rows, as in subspace.c, and every product recomputes all n^2 affinities, which is what
+ * the memory is traded for.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "operator.h"
+#include "matrix.h"
+#include "parallel.h"
+#include "subspace.h"
+#include "tridiag.h"
+
+typedef struct operator_job_t
+{
+    lnorm_operator_t *op;
+    size_t rows;
+    double **x, **scaled, **y;
+} operator_job_t;
+
+int lnorm_operator_init(lnorm_operator_t *op, const size_t n, point_t *points, const size_t dim)
+{
+    size_t i;
+    op->n = n;
+    op->dim = dim;
+    op->points = points;
+    op->kernel = select_distance_kernel(dim);
+    op->exp_kernel = select_exp_kernel();
+    op->compressed = NULL;
+    op->scale = (double *)malloc((n > 0 ? n : 1) * sizeof(double));
+    if (NULL == op->scale)
+    {
+        return 1;
+    }
+    if (create_degree_vector(n, op->scale, points, dim) != 0)
+    {
+        lnorm_operator_free(op);
+        return 1;
+    }
+    for (i = 0; i < n; i++)
+    {
+        op->scale[i] = sqrt(1 / op->scale[i]);
+    }
+    return 0;
+}
+
+/*The operator of a compressed W, whose degrees it takes D^-1/2 from; the graph must outlive it*/
+int lnorm_operator_init_compressed(lnorm_operator_t *op, compressed_graph_t *graph)
+{
+    op->n = graph->n;
+    op->dim = 0;
+    op->points = NULL;
+    op->compressed = graph;
+    op->scale = (double *)malloc((graph->n > 0 ? graph->n : 1) * sizeof(double));
+    if (NULL == op->scale)
+    {
+        return 1;
+    }
+    memcpy(op->scale, graph->scale, graph->n * sizeof(double));
+    return 0;
+}
+
+void lnorm_operator_free(lnorm_operator_t *op)
+{
+    free(op->scale);
+    op->scale = NULL;
+}
+
+/*The affinities between points [i_start, i_end) and [j_start, j_end), with W's zero diagonal*/
+static void affinity_tile(lnorm_operator_t *op, const size_t i_start, const size_t i_end, const size_t j_start, const size_t j_end,
+                          double tile[OPERATOR_TILE][OPERATOR_TILE])
+{
+    size_t i, j;
+    for (i = i_start; i < i_end; i++)
+    {
+        for (j = j_start; j < j_end; j++)
+        {
+            tile[i - i_start][j - j_start] = -op->kernel.distance(op->points[i].elements, op->points[j].elements, op->dim) / 2.0;
+        }
+        exp_batch(&op->exp_kernel, tile[i - i_start], j_end - j_start);
+        if (i >= j_start && i < j_end)
+        {
+            tile[i - i_start][i - j_start] = .0;
+        }
+    }
+}
+
+/*The entries [i_start, i_start + OPERATOR_TILE) of every product, from one row of tiles*/
+static void apply_task(void *arg, const size_t index)
+{
+    operator_job_t *job = (operator_job_t *)arg;
+    lnorm_operator_t *op = job->op;
+    double tile[OPERATOR_TILE][OPERATOR_TILE], sum;
+    const size_t i_start = index * OPERATOR_TILE, i_end = i_start + OPERATOR_TILE < op->n ? i_start + OPERATOR_TILE : op->n;
+    size_t i, j, r, j_start, j_end;
+
+    for (r = 0; r < job->rows; r++)
+    {
+        memset(job->y[r] + i_start, 0, (i_end - i_start) * sizeof(double));
+    }
+    for (j_start = 0; j_start < op->n; j_start += OPERATOR_TILE)
+    {
+        j_end = j_start + OPERATOR_TILE < op->n ? j_start + OPERATOR_TILE : op->n;
+        affinity_tile(op, i_start, i_end, j_start, j_end, tile);
+        for (r = 0; r < job->rows; r++)
+        {
+            for (i = i_start; i < i_end; i++)
+            {
+                sum = .0;
+                for (j = j_start; j < j_end; j++)
+                {
+                    sum += tile[i - i_start][j - j_start] * job->scaled[r][j];
+                }
+                job->y[r][i] += sum;
+            }
+        }
+    }
+    for (r = 0; r < job->rows; r++)
+    {
+        for (i = i_start; i < i_end; i++)
+        {
+            job->y[r][i] = job->x[r][i] - op->scale[i] * job->y[r][i];
+        }
+    }
+}
+
+/*y[r] = L_norm x[r] for each of the 'rows' vectors; y must not share storage with x*/
+int lnorm_operator_apply(lnorm_operator_t *op, const size_t rows, double **x, double **y)
+{
+    operator_job_t job;
+    const size_t tiles = (op->n + OPERATOR_TILE - 1) / OPERATOR_TILE;
+    size_t r, i;
+    if (NULL != op->compressed)
+    {
+        return compressed_apply(op->compressed, rows, x, y);
+    }
+    job.scaled = (double **)malloc_matrix(rows, op->n, sizeof(double));
+    if (NULL == job.scaled)
+    {
+        return 1;
+    }
+    for (r = 0; r < rows; r++)
+    {
+        for (i = 0; i < op->n; i++)
+        {
+            job.scaled[r][i] = op->scale[i] * x[r][i];
+        }
+    }
+    job.op = op;
+    job.rows = rows;
+    job.x = x;
+    job.y = y;
+    if (parallel_for(tiles, apply_task, &job) != 0)
+    {
+        for (i = 0; i < tiles; i++)
+        {
+            apply_task(&job, i);
+        }
+    }
+    free_matrix(rows, (void **)job.scaled);
+    return 0;
+}
+
+/*
+ * Replaces the block x with p(L_norm) x, p the degree OPERATOR_FILTER_DEGREE Chebyshev polynomial of [0, cut]:
+ * it stays within [-1, 1] over the unwanted part of the spectrum and grows fast above it. 'work' and 'spare'
+ * are scratch blocks of the same shape; the three pointers come back permuted, with the result in *x.
+ */
+static int chebyshev_filter(lnorm_operator_t *op, const size_t rows, const double cut, double ***x, double ***work, double ***spare)
+{
+    const double center = cut / 2.0, radius = cut / 2.0;
+    double **previous = *x, **current = *work, **next = *spare, **swap;
+    size_t degree, r, i;
+    if (lnorm_operator_apply(op, rows, previous, current) != 0)
+    {
+        return 1;
+    }
+    for (r = 0; r < rows; r++)
+    {
+        for (i = 0; i < op->n; i++)
+        {
+            current[r][i] = (current[r][i] - center * previous[r][i]) / radius;
+        }
+    }
+    for (degree = 2; degree <= OPERATOR_FILTER_DEGREE; degree++)
+    {
+        if (lnorm_operator_apply(op, rows, current, next) != 0)
+        {
+            return 1;
+        }
+        for (r = 0; r < rows; r++)
+        {
+            for (i = 0; i < op->n; i++)
+            {
+                next[r][i] = 2.0 * (next[r][i] - center * current[r][i]) / radius - previous[r][i]; /* T_j+1 = 2 t T_j - T_j-1 */
+            }
+        }
+        swap = previous;
+        previous = current;
+        current = next;
+        next = swap;
+    }
+    *x = current;
+    *work = previous;
+    *spare = next;
+    return 0;
+}
+
+/*B = Q L_norm Q^T and its eigenpairs, largest first; 'z' receives L_norm applied to the rows of q*/
+static int rayleigh_ritz(lnorm_operator_t *op, const size_t l, double **q, double **z, double **b, eigen_t *small)
+{
+    size_t i, j;
+    if (lnorm_operator_apply(op, l, q, z) != 0)
+    {
+        return 1;
+    }
+    multiply_transposed_blocked(l, op->n, l, z, q, b);
+    for (i = 0; i < l; i++)
+    {
+        for (j = 0; j < i; j++)
+        {
+            b[i][j] = b[j][i] = 0.5 * (b[i][j] + b[j][i]);
+        }
+    }
+    if (tridiag_eigens(l, b, small) != 0)
+    {
+        return 1;
+    }
+    qsort(small, l, sizeof(eigen_t), compare_eigenvalues);
+    return 0;
+}
+
+/*max |L_norm v - value v| over the first k Ritz pairs, v = S Q, from z = Q L_norm without another product*/
+static double max_residual(const size_t n, const size_t l, const size_t k, double **q, double **z, eigen_t *small)
+{
+    size_t i, j, m;
+    double worst = .0, norm, entry;
+    for (i = 0; i < k; i++)
+    {
+        norm = .0;
+        for (j = 0; j < n; j++)
+        {
+            entry = .0;
+            for (m = 0; m < l; m++)
+            {
+                entry += small[i].vector[m] * (z[m][j] - small[i].value * q[m][j]);
+            }
+            norm += entry * entry;
+        }
+        worst = norm > worst ? norm : worst;
+    }
+    return sqrt(worst);
+}
+
+/*
+ * The k largest eigenpairs of L_norm, sorted as in section 1.3, by Chebyshev-filtered block power iteration on
+ * k + oversample vectors. The top of L_norm's spectrum is crowded, so plain power iteration barely separates
+ * it; the filter damps everything below the smallest Ritz value of the block instead. It stops once the k
+ * wanted Ritz pairs have residuals of at most OPERATOR_TOLERANCE, after OPERATOR_MAX_ITERATIONS, or when 'deadline'
+ * expires, whose status is then returned.
+ */
+int lnorm_operator_eigens(lnorm_operator_t *op, eigen_t *eigens, const size_t k, const size_t oversample, deadline_t *deadline)
+{
+    int result = 1, stopped = DEADLINE_LIVE, converged = 0;
+    const size_t n = op->n, l = k + oversample < n ? k + oversample : n;
+    double **q, **z, **t, **b, **s;
+    eigen_t *small;
+    size_t i, iter;
+
+    q = (double **)malloc_matrix(l, n, sizeof(double));
+    if (NULL == q)
+    {
+        goto end;
+    }
+    z = (double **)malloc_matrix(l, n, sizeof(double));
+    if (NULL == z)
+    {
+        goto q_cleanup;
+    }
+    t = (double **)malloc_matrix(l, n, sizeof(double));
+    if (NULL == t)
+    {
+        goto z_cleanup;
+    }
+    b = (double **)malloc_matrix(l, l, sizeof(double));
+    if (NULL == b)
+    {
+        goto t_cleanup;
+    }
+    small = malloc_eigens(l);
+    if (NULL == small)
+    {
+        goto b_cleanup;
+    }
+    s = (double **)malloc_matrix(k, l, sizeof(double));
+    if (NULL == s)
+    {
+        goto small_cleanup;
+    }
+
+    random_gaussian_block(l, n, q, 0);
+    orthonormalize_rows(l, n, q);
+    if (rayleigh_ritz(op, l, q, z, b, small) != 0)
+    {
+        goto s_cleanup;
+    }
+    for (iter = 0; !converged && iter < OPERATOR_MAX_ITERATIONS && DEADLINE_LIVE == stopped; iter++)
+    {
+        if (chebyshev_filter(op, l, small[l - 1].value, &q, &z, &t) != 0)
+        {
+            goto s_cleanup;
+        }
+        orthonormalize_rows(l, n, q);
+        if (rayleigh_ritz(op, l, q, z, b, small) != 0)
+        {
+            goto s_cleanup;
+        }
+        converged = max_residual(n, l, k, q, z, small) <= OPERATOR_TOLERANCE;
+        stopped = deadline_check(deadline);
+    }
+
+    for (i = 0; i < k; i++)
+    {
+        eigens[i].value = small[i].value;
+        memcpy(s[i], small[i].vector, l * sizeof(double));
+    }
+    multiply_blocked(k, l, n, s, q, z); /* The Ritz vectors, in the basis the last projection was taken in */
+    for (i = 0; i < k; i++)
+    {
+        memcpy(eigens[i].vector, z[i], n * sizeof(double));
+    }
+    result = stopped;
+
+s_cleanup:
+    free_matrix(k, (void **)s);
+small_cleanup:
+    free_eigens(l, small);
+b_cleanup:
+    free_matrix(l, (void **)b);
+t_cleanup:
+    free_matrix(l, (void **)t);
+z_cleanup:
+    free_matrix(l, (void **)z);
+q_cleanup:
+    free_matrix(l, (void **)q);
+end:
+    return result;
+}
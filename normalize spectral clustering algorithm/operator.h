@@ -0,0 +1,34 @@
+#ifndef OPERATOR_H
+#define OPERATOR_H
+
+#include <stdlib.h>
+#include "point.h"
+#include "eigen.h"
+#include "distance.h"
+#include "expbatch.h"
+#include "deadline.h"
+#include "compress.h"
+
+#define OPERATOR_TILE 64                /* Points per side of the affinity tiles, 32 KiB of doubles */
+#define OPERATOR_FILTER_DEGREE 8        /* Products per Chebyshev filter, and so per block power iteration */
+#define OPERATOR_MAX_ITERATIONS 100     /* Filtered iterations before the Ritz pairs are returned as they are */
+#define OPERATOR_TOLERANCE 1e-12        /* Largest residual norm of a wanted Ritz pair at convergence */
+
+/*L_norm = I - D^-1/2 W D^-1/2 held as the points and D^-1/2 only; W is regenerated tile by tile on every product*/
+typedef struct lnorm_operator_t
+{
+    size_t n, dim;
+    point_t *points;
+    double *scale; /* The diagonal of D^-1/2 */
+    distance_kernel_t kernel;
+    exp_kernel_t exp_kernel;
+    compressed_graph_t *compressed; /* When set, products read this W instead of regenerating it; not owned */
+} lnorm_operator_t;
+
+int lnorm_operator_init(lnorm_operator_t *op, const size_t n, point_t *points, const size_t dim);
+int lnorm_operator_init_compressed(lnorm_operator_t *op, compressed_graph_t *graph);
+void lnorm_operator_free(lnorm_operator_t *op);
+int lnorm_operator_apply(lnorm_operator_t *op, const size_t rows, double **x, double **y);
+int lnorm_operator_eigens(lnorm_operator_t *op, eigen_t *eigens, const size_t k, const size_t oversample, deadline_t *deadline);
+
+#endif /* OPERATOR_H */
@@ -0,0 +1,199 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "options.h"
+#include "subspace.h"
+#include "checkpoint.h"
+
+/*Returns the value of an environment variable, or NULL if it is missing or empty*/
+static const char *get_env(const char *name)
+{
+    const char *value = getenv(name);
+    if (NULL == value || '\0' == value[0])
+    {
+        return NULL;
+    }
+    return value;
+}
+
+/*Returns a non-negative integer setting, or 'fallback' when it is missing or malformed*/
+static size_t get_env_size(const char *name, const size_t fallback)
+{
+    const char *value = get_env(name);
+    char *end;
+    long parsed;
+    if (NULL == value)
+    {
+        return fallback;
+    }
+    parsed = strtol(value, &end, 10);
+    if ('\0' != *end || parsed < 0)
+    {
+        return fallback;
+    }
+    return (size_t)parsed;
+}
+
+/*Returns a non-negative real setting, or 'fallback' when it is missing or malformed*/
+static double get_env_double(const char *name, const double fallback)
+{
+    const char *value = get_env(name);
+    char *end;
+    double parsed;
+    if (NULL == value)
+    {
+        return fallback;
+    }
+    parsed = strtod(value, &end);
+    if ('\0' != *end || parsed < .0)
+    {
+        return fallback;
+    }
+    return parsed;
+}
+
+/*"jacobi" (the default), "ql" for Householder tridiagonalization followed by implicit QL, "subspace", or "matrix-free"*/
+static eigen_solver_e get_env_solver(const char *name)
+{
+    const char *value = get_env(name);
+    if (NULL != value && strcmp(value, "ql") == 0)
+    {
+        return TRIDIAG_QL_SOLVER;
+    }
+    if (NULL != value && strcmp(value, "subspace") == 0)
+    {
+        return SUBSPACE_SOLVER;
+    }
+    if (NULL != value && strcmp(value, "matrix-free") == 0)
+    {
+        return MATRIX_FREE_SOLVER;
+    }
+    return JACOBI_SOLVER;
+}
+
+/*"auto" (the default), "libm" for exact reference output, or one of "sse2", "avx2", "avx512"*/
+static exp_kernel_e get_env_exp_kernel(const char *name)
+{
+    const char *value = get_env(name);
+    if (NULL == value)
+    {
+        return AUTO_EXP;
+    }
+    if (strcmp(value, "libm") == 0)
+    {
+        return LIBM_EXP;
+    }
+    if (strcmp(value, "sse2") == 0)
+    {
+        return SSE2_EXP;
+    }
+    if (strcmp(value, "avx2") == 0)
+    {
+        return AVX2_EXP;
+    }
+    if (strcmp(value, "avx512") == 0)
+    {
+        return AVX512_EXP;
+    }
+    return AUTO_EXP;
+}
+
+/*"blas" (the default, when the build linked one) or "native" to compare against the hand-written kernels*/
+static backend_e get_env_backend(const char *name)
+{
+    const char *value = get_env(name);
+    if (NULL != value && strcmp(value, "native") == 0)
+    {
+        return NATIVE_BACKEND;
+    }
+    return BLAS_BACKEND;
+}
+
+/*"transparent" (the default), "explicit" for the reserved MAP_HUGETLB pool, or "off"*/
+static huge_pages_e get_env_huge_pages(const char *name)
+{
+    const char *value = get_env(name);
+    if (NULL != value && strcmp(value, "explicit") == 0)
+    {
+        return EXPLICIT_HUGE_PAGES;
+    }
+    if (NULL != value && strcmp(value, "off") == 0)
+    {
+        return NO_HUGE_PAGES;
+    }
+    return TRANSPARENT_HUGE_PAGES;
+}
+
+/*"first-touch" (the default), "interleave", or "local" for the placement calloc would give*/
+static placement_e get_env_placement(const char *name)
+{
+    const char *value = get_env(name);
+    if (NULL != value && strcmp(value, "interleave") == 0)
+    {
+        return INTERLEAVE_PLACEMENT;
+    }
+    if (NULL != value && strcmp(value, "local") == 0)
+    {
+        return LOCAL_PLACEMENT;
+    }
+    return FIRST_TOUCH_PLACEMENT;
+}
+
+/*"exact" collapses equal points, a positive number the points in the same cell of a grid that fine; else it is off*/
+static size_t get_env_dedup(const char *name, double *quantum)
+{
+    const char *value = get_env(name);
+    *quantum = .0;
+    if (NULL != value && strcmp(value, "exact") == 0)
+    {
+        return 1;
+    }
+    *quantum = get_env_double(name, .0);
+    return *quantum > .0;
+}
+
+/*"float32", "bfloat16" or "float16" for the stored affinities of a compressed W; anything else keeps W dense*/
+precision_e get_precision(const char *value)
+{
+    if (NULL != value && strcmp(value, "float32") == 0)
+    {
+        return FLOAT32_PRECISION;
+    }
+    if (NULL != value && strcmp(value, "bfloat16") == 0)
+    {
+        return BFLOAT16_PRECISION;
+    }
+    if (NULL != value && strcmp(value, "float16") == 0)
+    {
+        return FLOAT16_PRECISION;
+    }
+    return NO_COMPRESSION;
+}
+
+/*All the opt-in runtime settings are read from the environment, so the CLI and the spkm module share them*/
+void load_options(options_t *options)
+{
+    options->cache_dir = get_env(CACHE_DIR_ENV);
+    options->num_threads = get_env_size(NUM_THREADS_ENV, 0);
+    options->eigen_solver = get_env_solver(EIGEN_SOLVER_ENV);
+    options->oversample = get_env_size(OVERSAMPLE_ENV, SUBSPACE_DEFAULT_OVERSAMPLE);
+    options->power_iters = get_env_size(POWER_ITERS_ENV, SUBSPACE_DEFAULT_POWER_ITERS);
+    options->socket_path = get_env(SOCKET_ENV);
+    options->server_memory = get_env_size(SERVER_MEMORY_ENV, SERVER_DEFAULT_MEMORY);
+    options->affinity_threshold = get_env_double(AFFINITY_THRESHOLD_ENV, .0);
+    options->index_epsilon = get_env_double(INDEX_EPSILON_ENV, .0);
+    options->exp_kernel = get_env_exp_kernel(EXP_KERNEL_ENV);
+    options->exp_flush = get_env_double(EXP_FLUSH_ENV, .0);
+    options->backend = get_env_backend(BACKEND_ENV);
+    options->time_budget = get_env_double(TIME_BUDGET_ENV, .0);
+    options->checkpoint_dir = get_env(CHECKPOINT_DIR_ENV);
+    options->checkpoint_interval = get_env_double(CHECKPOINT_INTERVAL_ENV, CHECKPOINT_DEFAULT_INTERVAL);
+    options->huge_pages = get_env_huge_pages(HUGE_PAGES_ENV);
+    options->placement = get_env_placement(NUMA_ENV);
+    options->alloc_stats = get_env_size(ALLOC_STATS_ENV, 0);
+    options->pipeline = get_env_size(PIPELINE_ENV, 0);
+    options->dedup = get_env_dedup(DEDUP_ENV, &options->dedup_quantum);
+    options->compress = get_precision(get_env(COMPRESS_ENV));
+    options->batch_output = get_env(BATCH_OUTPUT_ENV);
+    options->pic_vectors = get_env_size(PIC_VECTORS_ENV, 1);
+}
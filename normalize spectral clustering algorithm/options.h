@@ -0,0 +1,108 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <stdlib.h>
+
+#define CACHE_DIR_ENV "SPKM_CACHE_DIR"
+#define NUM_THREADS_ENV "SPKM_NUM_THREADS"
+#define EIGEN_SOLVER_ENV "SPKM_EIGEN_SOLVER"
+#define OVERSAMPLE_ENV "SPKM_OVERSAMPLE"
+#define POWER_ITERS_ENV "SPKM_POWER_ITERS"
+#define SOCKET_ENV "SPKM_SOCKET"
+#define SERVER_MEMORY_ENV "SPKM_SERVER_MEMORY"
+#define AFFINITY_THRESHOLD_ENV "SPKM_AFFINITY_THRESHOLD"
+#define INDEX_EPSILON_ENV "SPKM_INDEX_EPSILON"
+#define EXP_KERNEL_ENV "SPKM_EXP_KERNEL"
+#define EXP_FLUSH_ENV "SPKM_EXP_FLUSH"
+#define BACKEND_ENV "SPKM_BACKEND"
+#define TIME_BUDGET_ENV "SPKM_TIME_BUDGET"
+#define CHECKPOINT_DIR_ENV "SPKM_CHECKPOINT_DIR"
+#define CHECKPOINT_INTERVAL_ENV "SPKM_CHECKPOINT_INTERVAL"
+#define HUGE_PAGES_ENV "SPKM_HUGE_PAGES"
+#define NUMA_ENV "SPKM_NUMA"
+#define ALLOC_STATS_ENV "SPKM_ALLOC_STATS"
+#define PIPELINE_ENV "SPKM_PIPELINE"
+#define DEDUP_ENV "SPKM_DEDUP"
+#define COMPRESS_ENV "SPKM_COMPRESS"
+#define BATCH_OUTPUT_ENV "SPKM_BATCH_OUTPUT"
+#define PIC_VECTORS_ENV "SPKM_PIC_VECTORS"
+
+#define SERVER_DEFAULT_MEMORY (256UL << 20) /* Bytes of datasets and decompositions the server keeps warm */
+
+typedef enum eigen_solver_e
+{
+    JACOBI_SOLVER = 0,
+    TRIDIAG_QL_SOLVER = 1,
+    SUBSPACE_SOLVER = 2,
+    MATRIX_FREE_SOLVER = 3 /* Block power iteration on L_norm regenerated from the points; the others when k is chosen by the eigengap */
+} eigen_solver_e;
+
+typedef enum exp_kernel_e
+{
+    AUTO_EXP = 0, /* The widest SIMD variant the CPU supports */
+    LIBM_EXP = 1, /* Exact libm exp(), for reference output */
+    SSE2_EXP = 2,
+    AVX2_EXP = 3,
+    AVX512_EXP = 4
+} exp_kernel_e;
+
+typedef enum backend_e
+{
+    BLAS_BACKEND = 0,  /* The system BLAS/LAPACK, when the build linked one */
+    NATIVE_BACKEND = 1 /* The hand-written kernels, which are always the fallback */
+} backend_e;
+
+typedef enum huge_pages_e
+{
+    TRANSPARENT_HUGE_PAGES = 0, /* madvise(MADV_HUGEPAGE), which the kernel may or may not honour */
+    EXPLICIT_HUGE_PAGES = 1,    /* MAP_HUGETLB from the reserved pool, falling back to transparent ones */
+    NO_HUGE_PAGES = 2
+} huge_pages_e;
+
+typedef enum placement_e
+{
+    FIRST_TOUCH_PLACEMENT = 0, /* Pages are first touched by the workers of the row partition */
+    INTERLEAVE_PLACEMENT = 1,  /* Pages are spread round-robin over every NUMA node */
+    LOCAL_PLACEMENT = 2        /* Pages land wherever they are first written, as with calloc */
+} placement_e;
+
+typedef enum precision_e
+{
+    NO_COMPRESSION = 0,
+    FLOAT32_PRECISION = 1,
+    BFLOAT16_PRECISION = 2, /* 8 significant bits, the exponent range of a float */
+    FLOAT16_PRECISION = 3   /* 11 significant bits; affinities under 2^-25 round to 0 */
+} precision_e;
+
+typedef struct options_t
+{
+    const char *cache_dir; /* NULL when the eigen cache is disabled */
+    size_t num_threads;    /* 0 means one thread per online core */
+    eigen_solver_e eigen_solver;
+    size_t oversample;  /* Extra vectors carried by the subspace solver beyond k */
+    size_t power_iters; /* Power iterations of the subspace solver */
+    const char *socket_path; /* When set, the CLI sends its job to the server listening there */
+    size_t server_memory;
+    double affinity_threshold; /* 0 keeps the dense W; otherwise smaller affinities are dropped via a spatial index */
+    double index_epsilon;      /* Approximation of the spatial index queries, 0 is exact */
+    exp_kernel_e exp_kernel;
+    double exp_flush; /* Affinities below this are flushed to 0 by the batch exp kernels */
+    backend_e backend;
+    double time_budget; /* Milliseconds for the CLI's iterative stages, 0 for no limit */
+    const char *checkpoint_dir; /* NULL when Jacobi and k-means do not checkpoint */
+    double checkpoint_interval; /* Seconds between checkpoints */
+    huge_pages_e huge_pages;
+    placement_e placement;
+    size_t alloc_stats; /* Non-zero makes the CLI print its allocation statistics to stderr */
+    size_t pipeline;    /* Non-zero overlaps parsing, computation and output for the wam and lnorm goals of the CLI */
+    size_t dedup;         /* Non-zero runs spk and the k-means fits on the distinct points, weighted by their multiplicity */
+    double dedup_quantum; /* Side of the grid cells whose points spk collapses, 0 for exact duplicates only */
+    precision_e compress; /* Precision of the compressed W that spk with a given k multiplies by, or NO_COMPRESSION */
+    const char *batch_output; /* The indexed file of the CLI's batch command, NULL for one output file per problem */
+    size_t pic_vectors;       /* Columns of the pic embedding, each iterated from its own start */
+} options_t;
+
+void load_options(options_t *options);
+precision_e get_precision(const char *value);
+
+#endif /* OPTIONS_H */
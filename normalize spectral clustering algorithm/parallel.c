@@ -0,0 +1,338 @@
+/*
+ * One pool of worker threads for the whole process, shared by every stage, by the server's jobs and by the
+ * Python threads calling into spkm, so concurrent loops split the cores instead of each starting its own.
+ * A loop is split into one contiguous range per participant. Each takes 'grain' indices at a time from the
+ * front of its own range, and once that is empty steals the back half of the fullest other range. The
+ * calling thread always participates and can finish its loop alone, so a loop started from inside another
+ * loop's task, or while every worker is busy, cannot deadlock. Idle workers sleep on a condition variable.
+ */
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "parallel.h"
+#include "options.h"
+
+typedef struct parallel_range_t
+{
+    size_t begin, end;
+    pthread_mutex_t lock;
+} parallel_range_t;
+
+typedef struct parallel_job_t
+{
+    parallel_task_t task;
+    void *arg;
+    size_t grain;
+    size_t ranges_len;        /* The caller's range first, then one per worker allowed to join */
+    parallel_range_t *ranges;
+    size_t remaining;         /* Indices not yet finished, guarded by the pool lock */
+    size_t active;            /* Workers inside the job, guarded by the pool lock */
+    int exhausted;            /* Set once a participant found nothing left to claim or steal */
+    struct parallel_job_t *next;
+} parallel_job_t;
+
+typedef struct parallel_pool_t
+{
+    pthread_mutex_t lock;
+    pthread_cond_t work; /* Signalled when a job is posted */
+    pthread_cond_t done; /* Signalled when a job finishes or a worker leaves one */
+    parallel_job_t *jobs;
+    size_t workers_len;
+} parallel_pool_t;
+
+static parallel_pool_t pool = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, 0};
+
+/*The number of worker threads, from SPKM_NUM_THREADS or else the cores this process may run on*/
+size_t get_num_threads(void)
+{
+    options_t options;
+    long cores;
+#ifdef CPU_COUNT
+    cpu_set_t allowed;
+#endif
+    load_options(&options);
+    if (options.num_threads > 0)
+    {
+        return options.num_threads;
+    }
+#ifdef CPU_COUNT
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0 && CPU_COUNT(&allowed) > 0)
+    {
+        return (size_t)CPU_COUNT(&allowed); /* Respects taskset, cgroup cpusets and the like */
+    }
+#endif
+    cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (size_t)cores : 1;
+}
+
+/*Claims the next grain of indices for the participant owning 'ranges[own]', stealing when its range is empty*/
+static int claim(parallel_job_t *job, const size_t own, size_t *begin, size_t *end)
+{
+    parallel_range_t *mine = &job->ranges[own], *victim;
+    size_t i, best, best_left, left, middle, stolen_end;
+    while (1)
+    {
+        pthread_mutex_lock(&mine->lock);
+        if (mine->begin < mine->end)
+        {
+            *begin = mine->begin;
+            *end = mine->end - mine->begin > job->grain ? mine->begin + job->grain : mine->end;
+            mine->begin = *end;
+            pthread_mutex_unlock(&mine->lock);
+            return 1;
+        }
+        pthread_mutex_unlock(&mine->lock);
+
+        best = own;
+        best_left = 0;
+        for (i = 0; i < job->ranges_len; i++)
+        {
+            if (i == own)
+            {
+                continue;
+            }
+            pthread_mutex_lock(&job->ranges[i].lock);
+            left = job->ranges[i].end > job->ranges[i].begin ? job->ranges[i].end - job->ranges[i].begin : 0;
+            pthread_mutex_unlock(&job->ranges[i].lock);
+            if (left > best_left)
+            {
+                best = i;
+                best_left = left;
+            }
+        }
+        if (best == own)
+        {
+            return 0;
+        }
+        victim = &job->ranges[best];
+        pthread_mutex_lock(&victim->lock);
+        if (victim->begin >= victim->end)
+        {
+            pthread_mutex_unlock(&victim->lock);
+            continue;
+        }
+        middle = victim->begin + (victim->end - victim->begin) / 2;
+        stolen_end = victim->end;
+        victim->end = middle;
+        pthread_mutex_unlock(&victim->lock);
+        pthread_mutex_lock(&mine->lock);
+        mine->begin = middle;
+        mine->end = stolen_end;
+        pthread_mutex_unlock(&mine->lock);
+    }
+}
+
+/*Runs grains of the job until none are left to claim or steal*/
+static void participate(parallel_job_t *job, const size_t own)
+{
+    size_t begin, end, i;
+    while (claim(job, own, &begin, &end))
+    {
+        for (i = begin; i < end; i++)
+        {
+            job->task(job->arg, i);
+        }
+        pthread_mutex_lock(&pool.lock);
+        job->remaining -= end - begin;
+        if (0 == job->remaining)
+        {
+            pthread_cond_broadcast(&pool.done);
+        }
+        pthread_mutex_unlock(&pool.lock);
+    }
+    pthread_mutex_lock(&pool.lock);
+    job->exhausted = 1;
+    pthread_mutex_unlock(&pool.lock);
+}
+
+/*A posted job worker 'id' may still help with, or NULL; called with the pool lock held*/
+static parallel_job_t *find_job(const size_t id)
+{
+    parallel_job_t *job;
+    for (job = pool.jobs; NULL != job; job = job->next)
+    {
+        if (!job->exhausted && id < job->ranges_len)
+        {
+            return job;
+        }
+    }
+    return NULL;
+}
+
+static void *parallel_worker(void *arg)
+{
+    const size_t id = (size_t)arg; /* Workers are numbered from 1; range 0 belongs to the caller */
+    parallel_job_t *job;
+    pthread_mutex_lock(&pool.lock);
+    while (1)
+    {
+        job = find_job(id);
+        if (NULL == job)
+        {
+            pthread_cond_wait(&pool.work, &pool.lock);
+            continue;
+        }
+        job->active++;
+        pthread_mutex_unlock(&pool.lock);
+        participate(job, id);
+        pthread_mutex_lock(&pool.lock);
+        job->active--;
+        pthread_cond_broadcast(&pool.done);
+    }
+    return NULL;
+}
+
+/*Starts workers until the pool has 'wanted'; returns how many it has. Called with the pool lock held*/
+static size_t grow_pool(const size_t wanted)
+{
+    pthread_t thread;
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED); /* Workers live as long as the process */
+    while (pool.workers_len < wanted &&
+           pthread_create(&thread, &attributes, parallel_worker, (void *)(pool.workers_len + 1)) == 0)
+    {
+        pool.workers_len++;
+    }
+    pthread_attr_destroy(&attributes);
+    return pool.workers_len;
+}
+
+/*
+ * Runs task(arg, i) for every i < count, 'grain' consecutive indices at a time, on the caller and up to
+ * get_num_threads() - 1 pool workers. Returns once every index is done.
+ */
+int parallel_for_grain(const size_t count, const size_t grain, parallel_task_t task, void *arg)
+{
+    parallel_job_t job, **link;
+    size_t threads_len, i;
+
+    threads_len = get_num_threads();
+    if (threads_len > (count + grain - 1) / (grain > 0 ? grain : 1))
+    {
+        threads_len = (count + grain - 1) / (grain > 0 ? grain : 1);
+    }
+    if (threads_len <= 1)
+    {
+        for (i = 0; i < count; i++)
+        {
+            task(arg, i);
+        }
+        return 0;
+    }
+
+    job.ranges = (parallel_range_t *)malloc(threads_len * sizeof(parallel_range_t));
+    if (NULL == job.ranges)
+    {
+        return 1;
+    }
+    job.task = task;
+    job.arg = arg;
+    job.grain = grain > 0 ? grain : 1;
+    job.remaining = count;
+    job.active = 0;
+    job.exhausted = 0;
+    job.next = NULL;
+
+    pthread_mutex_lock(&pool.lock);
+    job.ranges_len = 1 + grow_pool(threads_len - 1);
+    if (job.ranges_len > threads_len)
+    {
+        job.ranges_len = threads_len;
+    }
+    for (i = 0; i < job.ranges_len; i++)
+    {
+        job.ranges[i].begin = count * i / job.ranges_len; /* Contiguous ranges, the row partition alloc.c touches */
+        job.ranges[i].end = count * (i + 1) / job.ranges_len;
+        pthread_mutex_init(&job.ranges[i].lock, NULL);
+    }
+    for (link = &pool.jobs; NULL != *link; link = &(*link)->next)
+    {
+    }
+    *link = &job;
+    pthread_cond_broadcast(&pool.work);
+    pthread_mutex_unlock(&pool.lock);
+
+    participate(&job, 0);
+
+    pthread_mutex_lock(&pool.lock);
+    while (job.remaining > 0 || job.active > 0)
+    {
+        pthread_cond_wait(&pool.done, &pool.lock);
+    }
+    for (link = &pool.jobs; &job != *link; link = &(*link)->next)
+    {
+    }
+    *link = job.next;
+    pthread_mutex_unlock(&pool.lock);
+
+    for (i = 0; i < job.ranges_len; i++)
+    {
+        pthread_mutex_destroy(&job.ranges[i].lock);
+    }
+    free(job.ranges);
+    return 0;
+}
+
+int parallel_for(const size_t count, parallel_task_t task, void *arg)
+{
+    return parallel_for_grain(count, 1, task, arg);
+}
+
+typedef struct reduce_job_t
+{
+    parallel_reduce_t reduce;
+    void *arg;
+    size_t count, grain;
+    double *partials;
+} reduce_job_t;
+
+static void reduce_task(void *arg, const size_t index)
+{
+    reduce_job_t *job = (reduce_job_t *)arg;
+    const size_t begin = index * job->grain, end = begin + job->grain < job->count ? begin + job->grain : job->count;
+    job->partials[index] = job->reduce(job->arg, begin, end);
+}
+
+/*
+ * The sum of reduce(arg, begin, end) over consecutive 'grain'-sized ranges covering [0, count). The partial
+ * sums are added in index order, so the result does not depend on the number of threads.
+ */
+int parallel_reduce(const size_t count, const size_t grain, parallel_reduce_t reduce, void *arg, double *result)
+{
+    reduce_job_t job;
+    size_t chunks, i;
+    job.grain = grain > 0 ? grain : 1;
+    chunks = (count + job.grain - 1) / job.grain;
+    if (chunks <= 1)
+    {
+        *result = reduce(arg, 0, count);
+        return 0;
+    }
+    job.partials = (double *)malloc(chunks * sizeof(double));
+    if (NULL == job.partials)
+    {
+        return 1;
+    }
+    job.reduce = reduce;
+    job.arg = arg;
+    job.count = count;
+    if (parallel_for(chunks, reduce_task, &job) != 0)
+    {
+        for (i = 0; i < chunks; i++)
+        {
+            reduce_task(&job, i); /* The same ranges in turn, so the sum is unchanged */
+        }
+    }
+    *result = .0;
+    for (i = 0; i < chunks; i++)
+    {
+        *result += job.partials[i];
+    }
+    free(job.partials);
+    return 0;
+}
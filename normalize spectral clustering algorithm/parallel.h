@@ -0,0 +1,14 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdlib.h>
+
+typedef void (*parallel_task_t)(void *arg, const size_t index);
+typedef double (*parallel_reduce_t)(void *arg, const size_t begin, const size_t end);
+
+size_t get_num_threads(void);
+int parallel_for(const size_t count, parallel_task_t task, void *arg);
+int parallel_for_grain(const size_t count, const size_t grain, parallel_task_t task, void *arg);
+int parallel_reduce(const size_t count, const size_t grain, parallel_reduce_t reduce, void *arg, double *result);
+
+#endif /* PARALLEL_H */
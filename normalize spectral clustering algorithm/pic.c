@@ -0,0 +1,377 @@
+/*
+ * Power iteration clustering: a few vectors of n values, each iterated as v <- D^-1 W v / |D^-1 W v|_1, take
+ * the place of the k eigenvectors of spk. The random walk mixes within clusters long before it mixes between
+ * them, so after a handful of products every cluster sits on its own level of v. Each vector stops once its
+ * acceleration, the largest change of v_t - v_t-1 from one iteration to the next, falls under PIC_EPSILON / n,
+ * and before v flattens into the constant vector. A product costs O(nnz) with the sparse W of
+ * SPKM_AFFINITY_THRESHOLD and O(n^2) with the dense one, and no eigenproblem is solved at all.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "pic.h"
+#include "matrix.h"
+#include "options.h"
+#include "sparse.h"
+#include "operator.h"
+#include "compress.h"
+#include "parallel.h"
+
+typedef enum pic_storage_e
+{
+    DENSE_STORAGE = 0,    /* W in full */
+    SPARSE_STORAGE = 1,   /* The affinities of at least SPKM_AFFINITY_THRESHOLD, in compressed sparse rows */
+    OPERATOR_STORAGE = 2  /* L_norm regenerated from the points, or read from the SPKM_COMPRESS W */
+} pic_storage_e;
+
+/*D^-1 W in whichever form the options ask for*/
+typedef struct pic_graph_t
+{
+    size_t n;
+    pic_storage_e storage;
+    double **w;
+    sparse_t sparse;
+    lnorm_operator_t op;
+    compressed_graph_t compressed;
+    int is_compressed;
+    double *degrees;
+    double **scaled, **lnorm; /* D^1/2 x and L_norm D^1/2 x for the operator, one row per vector */
+} pic_graph_t;
+
+typedef struct pic_product_job_t
+{
+    pic_graph_t *graph;
+    double **x, **y;
+    size_t rows;
+} pic_product_job_t;
+
+/*A 64-bit linear congruential generator, so seeding is reproducible*/
+static double random_uniform(unsigned long *state)
+{
+    *state = *state * 6364136223846793005UL + 1442695040888963407UL;
+    return (double)(*state >> 11) / 9007199254740992.0;
+}
+
+/*SPKM_PIC_VECTORS, at most n*/
+size_t pic_columns(const size_t n)
+{
+    options_t options;
+    load_options(&options);
+    return options.pic_vectors < n ? options.pic_vectors : n;
+}
+
+static void free_graph(pic_graph_t *graph, const size_t rows)
+{
+    if (NULL != graph->w)
+    {
+        free_matrix(graph->n, (void **)graph->w);
+    }
+    if (SPARSE_STORAGE == graph->storage)
+    {
+        free_sparse(&graph->sparse);
+    }
+    if (OPERATOR_STORAGE == graph->storage)
+    {
+        lnorm_operator_free(&graph->op);
+        if (NULL != graph->scaled)
+        {
+            free_matrix(rows, (void **)graph->scaled);
+        }
+        if (NULL != graph->lnorm)
+        {
+            free_matrix(rows, (void **)graph->lnorm);
+        }
+    }
+    if (graph->is_compressed)
+    {
+        free_compressed(&graph->compressed);
+    }
+    free(graph->degrees);
+}
+
+/*
+ * Builds W once. With SPKM_COMPRESS, or SPKM_EIGEN_SOLVER=matrix-free and no threshold, only the points and
+ * D^-1/2 are kept, as for spk, and D^-1 W x is D^-1/2 (I - L_norm) D^1/2 x.
+ */
+static int build_graph(pic_graph_t *graph, const size_t n, point_t *points, const size_t dim, const size_t rows)
+{
+    options_t options;
+    size_t i, j;
+
+    load_options(&options);
+    memset(graph, 0, sizeof(*graph));
+    graph->n = n;
+    graph->degrees = (double *)malloc(n * sizeof(double));
+    if (NULL == graph->degrees)
+    {
+        return 1;
+    }
+    if (NO_COMPRESSION != options.compress || (MATRIX_FREE_SOLVER == options.eigen_solver && options.affinity_threshold <= .0))
+    {
+        if (NO_COMPRESSION != options.compress)
+        {
+            if (compress_graph(&graph->compressed, n, points, dim, options.affinity_threshold, options.compress) != 0)
+            {
+                return 1;
+            }
+            graph->is_compressed = 1;
+        }
+        if ((graph->is_compressed ? lnorm_operator_init_compressed(&graph->op, &graph->compressed) : lnorm_operator_init(&graph->op, n, points, dim)) != 0)
+        {
+            return 1;
+        }
+        graph->storage = OPERATOR_STORAGE;
+        graph->scaled = (double **)malloc_matrix(rows, n, sizeof(double));
+        graph->lnorm = (double **)malloc_matrix(rows, n, sizeof(double));
+        if (NULL == graph->scaled || NULL == graph->lnorm)
+        {
+            return 1;
+        }
+        for (i = 0; i < n; i++)
+        {
+            graph->degrees[i] = graph->op.scale[i] > .0 ? 1 / (graph->op.scale[i] * graph->op.scale[i]) : .0;
+        }
+        return 0;
+    }
+    if (options.affinity_threshold > .0)
+    {
+        if (create_weight_sparse(n, &graph->sparse, points, dim, options.affinity_threshold, options.index_epsilon) != 0)
+        {
+            return 1;
+        }
+        graph->storage = SPARSE_STORAGE;
+        sparse_degrees(&graph->sparse, graph->degrees);
+        return 0;
+    }
+    graph->w = (double **)malloc_matrix(n, n, sizeof(double));
+    if (NULL == graph->w || calc_weight_matrix(n, points, dim, graph->w) != OK)
+    {
+        return 1;
+    }
+    for (i = 0; i < n; i++)
+    {
+        graph->degrees[i] = .0;
+        for (j = 0; j < n; j++)
+        {
+            graph->degrees[i] += graph->w[i][j];
+        }
+    }
+    return 0;
+}
+
+/*y[r] = D^-1 W x[r] on one block of rows; a point without affinities keeps its value*/
+static void product_task(void *arg, const size_t block)
+{
+    pic_product_job_t *job = (pic_product_job_t *)arg;
+    pic_graph_t *graph = job->graph;
+    const size_t end = (block + 1) * PIC_ROW_GRAIN < graph->n ? (block + 1) * PIC_ROW_GRAIN : graph->n;
+    size_t i, j, r;
+    double sum;
+
+    for (r = 0; r < job->rows; r++)
+    {
+        for (i = block * PIC_ROW_GRAIN; i < end; i++)
+        {
+            if (graph->degrees[i] <= .0)
+            {
+                job->y[r][i] = job->x[r][i];
+                continue;
+            }
+            sum = .0;
+            if (SPARSE_STORAGE == graph->storage)
+            {
+                for (j = graph->sparse.row_start[i]; j < graph->sparse.row_start[i + 1]; j++)
+                {
+                    sum += graph->sparse.values[j] * job->x[r][graph->sparse.columns[j]];
+                }
+            }
+            else
+            {
+                for (j = 0; j < graph->n; j++)
+                {
+                    sum += graph->w[i][j] * job->x[r][j];
+                }
+            }
+            job->y[r][i] = sum / graph->degrees[i];
+        }
+    }
+}
+
+/*y[r] = D^-1 W x[r] for each of the 'rows' vectors*/
+static int apply_walk(pic_graph_t *graph, const size_t rows, double **x, double **y)
+{
+    pic_product_job_t job;
+    const double *scale = graph->op.scale;
+    size_t i, r;
+
+    if (OPERATOR_STORAGE != graph->storage)
+    {
+        job.graph = graph;
+        job.x = x;
+        job.y = y;
+        job.rows = rows;
+        return parallel_for((graph->n + PIC_ROW_GRAIN - 1) / PIC_ROW_GRAIN, product_task, &job);
+    }
+    for (r = 0; r < rows; r++)
+    {
+        for (i = 0; i < graph->n; i++)
+        {
+            graph->scaled[r][i] = scale[i] > .0 ? x[r][i] / scale[i] : .0;
+        }
+    }
+    if (lnorm_operator_apply(&graph->op, rows, graph->scaled, graph->lnorm) != 0)
+    {
+        return 1;
+    }
+    for (r = 0; r < rows; r++)
+    {
+        for (i = 0; i < graph->n; i++)
+        {
+            y[r][i] = scale[i] > .0 ? scale[i] * (graph->scaled[r][i] - graph->lnorm[r][i]) : x[r][i];
+        }
+    }
+    return 0;
+}
+
+/*The first vector starts from d / vol(V), as the walk's stationary distribution does, the others at random*/
+static void start_vectors(pic_graph_t *graph, const size_t rows, double **v)
+{
+    unsigned long state;
+    double total;
+    size_t i, r;
+    for (r = 0; r < rows; r++)
+    {
+        state = r;
+        total = .0;
+        for (i = 0; i < graph->n; i++)
+        {
+            v[r][i] = 0 == r ? graph->degrees[i] : random_uniform(&state);
+            total += v[r][i];
+        }
+        for (i = 0; i < graph->n; i++)
+        {
+            v[r][i] = total > .0 ? v[r][i] / total : 1.0 / graph->n;
+        }
+    }
+}
+
+/*
+ * The embedding of SPKM_PIC_VECTORS power iteration vectors, one column each, every column rescaled to [0, 1]
+ * so that the levels survive the CLI's four decimals. *k is set to the number of columns.
+ */
+error_e pic_embedding(const size_t n, point_t *points, const size_t dim, double **mat, size_t *k, deadline_t *deadline)
+{
+    const size_t rows = pic_columns(n);
+    const double epsilon = PIC_EPSILON / n;
+    error_e result = OK;
+    pic_graph_t graph;
+    double **v = NULL, **next = NULL, **delta = NULL, **active_v = NULL, **active_next = NULL;
+    double total, change, acceleration, low, high;
+    size_t *active = NULL, active_len, iteration, i, r, a;
+    int stopped;
+
+    if (0 == rows)
+    {
+        return INVALID_INPUT;
+    }
+    if (build_graph(&graph, n, points, dim, rows) != 0)
+    {
+        result = MALLOC_ERROR;
+        goto cleanup;
+    }
+    v = (double **)malloc_matrix(rows, n, sizeof(double));
+    next = (double **)malloc_matrix(rows, n, sizeof(double));
+    delta = (double **)malloc_matrix(rows, n, sizeof(double));
+    active_v = (double **)malloc(rows * sizeof(double *));
+    active_next = (double **)malloc(rows * sizeof(double *));
+    active = (size_t *)malloc(rows * sizeof(size_t));
+    if (NULL == v || NULL == next || NULL == delta || NULL == active_v || NULL == active_next || NULL == active)
+    {
+        result = MALLOC_ERROR;
+        goto cleanup;
+    }
+    start_vectors(&graph, rows, v);
+    active_len = rows;
+    for (r = 0; r < rows; r++)
+    {
+        active[r] = r;
+        memset(delta[r], 0, n * sizeof(double)); /* No change yet before the first iteration */
+    }
+
+    for (iteration = 0; iteration < PIC_MAX_ITERATIONS && active_len > 0; iteration++)
+    {
+        stopped = deadline_check(deadline);
+        if (DEADLINE_STOPPED(stopped))
+        {
+            result = (error_e)stopped;
+            break;
+        }
+        for (a = 0; a < active_len; a++)
+        {
+            active_v[a] = v[active[a]];
+            active_next[a] = next[active[a]];
+        }
+        if (apply_walk(&graph, active_len, active_v, active_next) != 0)
+        {
+            result = MALLOC_ERROR;
+            goto cleanup;
+        }
+        for (a = 0, r = 0; a < active_len; a++)
+        {
+            total = .0;
+            for (i = 0; i < n; i++)
+            {
+                total += fabs(active_next[a][i]);
+            }
+            acceleration = .0;
+            for (i = 0; i < n; i++)
+            {
+                active_next[a][i] = total > .0 ? active_next[a][i] / total : active_v[a][i];
+                change = active_next[a][i] - active_v[a][i];
+                acceleration = fabs(change - delta[active[a]][i]) > acceleration ? fabs(change - delta[active[a]][i]) : acceleration;
+                delta[active[a]][i] = change;
+                active_v[a][i] = active_next[a][i];
+            }
+            if (0 == iteration || acceleration > epsilon)
+            {
+                active[r++] = active[a]; /* The first change has no previous one to compare with */
+            }
+        }
+        active_len = r;
+    }
+
+    for (r = 0; r < rows; r++)
+    {
+        low = high = v[r][0];
+        for (i = 1; i < n; i++)
+        {
+            low = v[r][i] < low ? v[r][i] : low;
+            high = v[r][i] > high ? v[r][i] : high;
+        }
+        for (i = 0; i < n; i++)
+        {
+            mat[i][r] = high > low ? (v[r][i] - low) / (high - low) : .0;
+        }
+    }
+    *k = rows;
+
+cleanup:
+    free(active);
+    free(active_next);
+    free(active_v);
+    if (NULL != delta)
+    {
+        free_matrix(rows, (void **)delta);
+    }
+    if (NULL != next)
+    {
+        free_matrix(rows, (void **)next);
+    }
+    if (NULL != v)
+    {
+        free_matrix(rows, (void **)v);
+    }
+    free_graph(&graph, rows);
+    return result;
+}
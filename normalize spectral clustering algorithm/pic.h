@@ -0,0 +1,15 @@
+#ifndef PIC_H
+#define PIC_H
+
+#include <stdlib.h>
+#include "point.h"
+#include "spkmeans.h"
+
+#define PIC_MAX_ITERATIONS 1000 /* Products before the vectors are used as they are */
+#define PIC_EPSILON 1e-5        /* Divided by n, the largest change of v_t - v_t-1 between iterations at convergence */
+#define PIC_ROW_GRAIN 64        /* Rows per task of the products */
+
+size_t pic_columns(const size_t n);
+error_e pic_embedding(const size_t n, point_t *points, const size_t dim, double **mat, size_t *k, deadline_t *deadline);
+
+#endif /* PIC_H */
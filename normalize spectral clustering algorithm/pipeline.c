@@ -0,0 +1,399 @@
+/*
+ * The wam and lnorm goals of the CLI as three overlapping stages instead of parse, compute, print in turn.
+ * A parser thread reads the points PIPELINE_BLOCK at a time, and as each block arrives the pool computes its
+ * affinities with every point before it, so once the last line is read only that block's tiles are left.
+ * The output rows are then formatted a block at a time on the pool and passed through a queue of
+ * PIPELINE_DEPTH blocks to a writer thread, which writes one block while the next ones are formatted.
+ * No row can be printed before the last point is read, since every row of W and L_norm depends on all of them.
+ * Every affinity, degree and entry is computed with the same operations, in the same order, as calc_matrix()
+ * and fprint_matrix() use, so the output is byte-identical, and W is the only n*n matrix.
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "pipeline.h"
+#include "input.h"
+#include "matrix.h"
+#include "options.h"
+#include "parallel.h"
+#include "distance.h"
+#include "expbatch.h"
+#include "blas.h"
+#include "debug.h"
+
+typedef struct parse_stage_t
+{
+    char *filename;
+    point_t *points;
+    size_t n, dim;
+    size_t parsed; /* Points read so far, guarded by 'lock' */
+    int failed;
+    pthread_mutex_t lock;
+    pthread_cond_t progress;
+} parse_stage_t;
+
+typedef struct row_text_t
+{
+    char *text;
+    size_t len, capacity;
+} row_text_t;
+
+typedef struct write_stage_t
+{
+    FILE *stream;
+    row_text_t rows[PIPELINE_DEPTH][PIPELINE_BLOCK];
+    size_t rows_len[PIPELINE_DEPTH];
+    size_t formatted, written; /* Blocks handed to the writer and blocks it wrote, guarded by 'lock' */
+    int closed;                /* No more blocks will be formatted */
+    pthread_mutex_t lock;
+    pthread_cond_t ready;   /* Signalled when a block is formatted or the queue is closed */
+    pthread_cond_t drained; /* Signalled when a block is written */
+} write_stage_t;
+
+typedef struct graph_job_t
+{
+    goal_e goal;
+    size_t n, dim;
+    point_t *points;
+    size_t begin, end; /* The block of points, or of output rows, being processed */
+    double **w;
+    double *degrees, *scale; /* lnorm only: the diagonal of D and of D^-1/2 */
+    int diagonal;            /* lnorm only: whether W has no non-zero off-diagonal entry, see multiply_mat() */
+    distance_kernel_t kernel;
+    exp_kernel_t exp_kernel;
+    row_text_t *rows;
+    int failed; /* Set by a formatting task that could not grow its row, read after the loop */
+} graph_job_t;
+
+/*SPKM_PIPELINE applies to wam and lnorm, unless W would be built from a BLAS Gram matrix, which needs every point at once*/
+int pipeline_supported(const goal_e goal, const size_t dim)
+{
+    options_t options;
+    load_options(&options);
+    if (!options.pipeline || options.affinity_threshold > .0)
+    {
+        return 0;
+    }
+    if (dim >= BLAS_GRAM_MIN_DIM && blas_enabled())
+    {
+        return 0;
+    }
+    return WEIGHT_MATRIX == goal || NORMALIZED_GRAPH_LAPLACIAN == goal;
+}
+
+static void publish_parsed(parse_stage_t *stage, const size_t parsed, const int failed)
+{
+    pthread_mutex_lock(&stage->lock);
+    stage->parsed = parsed;
+    stage->failed = failed;
+    pthread_cond_broadcast(&stage->progress);
+    pthread_mutex_unlock(&stage->lock);
+}
+
+/*The parser thread, reading the points as read_points() does and publishing them a block at a time*/
+static void *parse_points(void *arg)
+{
+    parse_stage_t *stage = (parse_stage_t *)arg;
+    FILE *file = fopen(stage->filename, "r");
+    size_t i;
+    if (NULL == file)
+    {
+        publish_parsed(stage, 0, 1);
+        return NULL;
+    }
+    for (i = 0; i < stage->n; i++)
+    {
+        read_point(file, &stage->points[i], stage->dim);
+        if ((i + 1) % PIPELINE_BLOCK == 0 || i + 1 == stage->n)
+        {
+            publish_parsed(stage, i + 1, 0);
+        }
+    }
+    fclose(file);
+    return NULL;
+}
+
+/*Blocks until the parser has read 'count' points; non-zero when it failed instead*/
+static int wait_parsed(parse_stage_t *stage, const size_t count)
+{
+    int failed;
+    pthread_mutex_lock(&stage->lock);
+    while (stage->parsed < count && !stage->failed)
+    {
+        pthread_cond_wait(&stage->progress, &stage->lock);
+    }
+    failed = stage->failed;
+    pthread_mutex_unlock(&stage->lock);
+    return failed;
+}
+
+/*Row i of W against the points [begin, end) after i, and the mirrored column, as in create_weight_matrix()*/
+static void affinity_task(void *arg, const size_t i)
+{
+    graph_job_t *job = (graph_job_t *)arg;
+    const size_t start = i + 1 > job->begin ? i + 1 : job->begin;
+    size_t j;
+    if (start >= job->end)
+    {
+        return;
+    }
+    for (j = start; j < job->end; j++)
+    {
+        job->w[i][j] = -job->kernel.distance(job->points[i].elements, job->points[j].elements, job->dim) / 2.0;
+    }
+    exp_batch(&job->exp_kernel, job->w[i] + start, job->end - start);
+    for (j = start; j < job->end; j++)
+    {
+        job->w[j][i] = job->w[i][j];
+    }
+}
+
+/*The degree of point i summed over its row, as create_diagonal_degree_matrix() does, and its D^-1/2 entry*/
+static void degree_task(void *arg, const size_t i)
+{
+    graph_job_t *job = (graph_job_t *)arg;
+    size_t j;
+    job->degrees[i] = .0;
+    for (j = 0; j < job->n; j++)
+    {
+        job->degrees[i] += job->w[i][j];
+    }
+    job->scale[i] = sqrt(1 / job->degrees[i]);
+}
+
+/*
+ * Entry (i, j) of L_norm with the roundings of create_normalized_laplacian_matrix(): multiply_mat() forms
+ * (D^-1/2 L) D^-1/2, and when L is diagonal it only writes the diagonal, leaving +0 elsewhere.
+ */
+static double lnorm_entry(graph_job_t *job, const size_t i, const size_t j)
+{
+    if (i == j)
+    {
+        return job->scale[i] * job->degrees[i] * job->scale[i];
+    }
+    if (job->diagonal)
+    {
+        return .0;
+    }
+    return job->scale[i] * -job->w[i][j] * job->scale[j];
+}
+
+/*Formats output row begin + index into the queue slot, as fprint_matrix() would print it*/
+static void format_task(void *arg, const size_t index)
+{
+    graph_job_t *job = (graph_job_t *)arg;
+    row_text_t *row = &job->rows[index];
+    const size_t i = job->begin + index;
+    char entry[PIPELINE_ENTRY_MAX], *grown;
+    size_t j, len;
+    double value;
+    row->len = 0;
+    for (j = 0; j < job->n; j++)
+    {
+        value = WEIGHT_MATRIX == job->goal ? job->w[i][j] : lnorm_entry(job, i, j);
+        len = sprint_fixed4(entry, value);
+        entry[len++] = j < job->n - 1 ? ',' : '\n';
+        if (row->len + len > row->capacity)
+        {
+            grown = (char *)realloc(row->text, 2 * (row->len + len) + 8 * job->n);
+            if (NULL == grown)
+            {
+                job->failed = 1;
+                return;
+            }
+            row->text = grown;
+            row->capacity = 2 * (row->len + len) + 8 * job->n;
+        }
+        memcpy(row->text + row->len, entry, len);
+        row->len += len;
+    }
+}
+
+static void write_block(write_stage_t *stage, const size_t slot)
+{
+    size_t r;
+    for (r = 0; r < stage->rows_len[slot]; r++)
+    {
+        fwrite(stage->rows[slot][r].text, 1, stage->rows[slot][r].len, stage->stream);
+    }
+}
+
+/*The writer thread: writes the formatted blocks in order until the queue is closed and empty*/
+static void *write_rows(void *arg)
+{
+    write_stage_t *stage = (write_stage_t *)arg;
+    size_t slot;
+    pthread_mutex_lock(&stage->lock);
+    while (1)
+    {
+        while (stage->written == stage->formatted && !stage->closed)
+        {
+            pthread_cond_wait(&stage->ready, &stage->lock);
+        }
+        if (stage->written == stage->formatted)
+        {
+            break;
+        }
+        slot = stage->written % PIPELINE_DEPTH;
+        pthread_mutex_unlock(&stage->lock);
+        write_block(stage, slot);
+        pthread_mutex_lock(&stage->lock);
+        stage->written++;
+        pthread_cond_signal(&stage->drained);
+    }
+    pthread_mutex_unlock(&stage->lock);
+    return NULL;
+}
+
+/*Formats the output rows block by block into the writer's queue; without a writer thread each block is written in turn*/
+static error_e format_rows(graph_job_t *job, write_stage_t *stage, const int threaded)
+{
+    size_t slot;
+    for (job->begin = 0; job->begin < job->n; job->begin += PIPELINE_BLOCK)
+    {
+        job->end = job->begin + PIPELINE_BLOCK < job->n ? job->begin + PIPELINE_BLOCK : job->n;
+        pthread_mutex_lock(&stage->lock);
+        while (stage->formatted - stage->written == PIPELINE_DEPTH)
+        {
+            pthread_cond_wait(&stage->drained, &stage->lock);
+        }
+        slot = stage->formatted % PIPELINE_DEPTH;
+        pthread_mutex_unlock(&stage->lock);
+
+        job->rows = stage->rows[slot];
+        stage->rows_len[slot] = job->end - job->begin;
+        parallel_for_grain(job->end - job->begin, PIPELINE_GRAIN, format_task, job);
+        if (job->failed)
+        {
+            return MALLOC_ERROR;
+        }
+        if (!threaded)
+        {
+            write_block(stage, slot);
+            continue;
+        }
+        pthread_mutex_lock(&stage->lock);
+        stage->formatted++;
+        pthread_cond_signal(&stage->ready);
+        pthread_mutex_unlock(&stage->lock);
+    }
+    return OK;
+}
+
+/*Prints the wam or lnorm goal for the points in 'filename' to 'stream', overlapping parsing, computation and output*/
+error_e pipeline_graph(char *filename, const size_t n, const size_t dim, const goal_e goal, FILE *stream)
+{
+    error_e result = OK;
+    graph_job_t job;
+    parse_stage_t parse;
+    write_stage_t write;
+    pthread_t parser, writer;
+    int parser_started, writer_started;
+    size_t slot, r;
+
+    memset(&job, 0, sizeof(job));
+    job.goal = goal;
+    job.n = n;
+    job.dim = dim;
+    job.kernel = select_distance_kernel(dim);
+    job.exp_kernel = select_exp_kernel();
+    job.points = malloc_points(n, dim);
+    if (NULL == job.points)
+    {
+        result = MALLOC_ERROR;
+        goto end;
+    }
+    job.w = (double **)malloc_matrix(n, n, sizeof(double));
+    if (NULL == job.w)
+    {
+        result = MALLOC_ERROR;
+        goto points_cleanup;
+    }
+    job.degrees = (double *)malloc(2 * n * sizeof(double));
+    if (NULL == job.degrees)
+    {
+        result = MALLOC_ERROR;
+        goto w_cleanup;
+    }
+    job.scale = job.degrees + n;
+
+    parse.filename = filename;
+    parse.points = job.points;
+    parse.n = n;
+    parse.dim = dim;
+    parse.parsed = 0;
+    parse.failed = 0;
+    pthread_mutex_init(&parse.lock, NULL);
+    pthread_cond_init(&parse.progress, NULL);
+    parser_started = pthread_create(&parser, NULL, parse_points, &parse) == 0;
+    if (!parser_started)
+    {
+        parse_points(&parse); /* Everything still works, one stage after the other */
+    }
+    for (job.begin = 0; job.begin < n; job.begin += PIPELINE_BLOCK)
+    {
+        job.end = job.begin + PIPELINE_BLOCK < n ? job.begin + PIPELINE_BLOCK : n;
+        if (wait_parsed(&parse, job.end) != 0)
+        {
+            result = INVALID_INPUT;
+            break;
+        }
+        parallel_for_grain(job.end, PIPELINE_GRAIN, affinity_task, &job);
+    }
+    if (parser_started)
+    {
+        pthread_join(parser, NULL);
+    }
+    pthread_cond_destroy(&parse.progress);
+    pthread_mutex_destroy(&parse.lock);
+    if (OK != result)
+    {
+        goto degrees_cleanup;
+    }
+
+    if (NORMALIZED_GRAPH_LAPLACIAN == goal)
+    {
+        parallel_for_grain(n, PIPELINE_GRAIN, degree_task, &job);
+        job.diagonal = TRUE == is_diagonal(n, job.w);
+    }
+
+    memset(&write, 0, sizeof(write));
+    write.stream = stream;
+    pthread_mutex_init(&write.lock, NULL);
+    pthread_cond_init(&write.ready, NULL);
+    pthread_cond_init(&write.drained, NULL);
+    writer_started = pthread_create(&writer, NULL, write_rows, &write) == 0;
+    result = format_rows(&job, &write, writer_started);
+    if (writer_started)
+    {
+        pthread_mutex_lock(&write.lock);
+        write.closed = 1;
+        pthread_cond_signal(&write.ready);
+        pthread_mutex_unlock(&write.lock);
+        pthread_join(writer, NULL);
+    }
+    pthread_cond_destroy(&write.drained);
+    pthread_cond_destroy(&write.ready);
+    pthread_mutex_destroy(&write.lock);
+    for (slot = 0; slot < PIPELINE_DEPTH; slot++)
+    {
+        for (r = 0; r < PIPELINE_BLOCK; r++)
+        {
+            free(write.rows[slot][r].text);
+        }
+    }
+
+degrees_cleanup:
+    free(job.degrees);
+w_cleanup:
+    free_matrix(n, (void **)job.w);
+points_cleanup:
+    free_points(n, job.points);
+end:
+    return result;
+}
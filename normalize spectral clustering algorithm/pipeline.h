@@ -0,0 +1,16 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "spkmeans.h"
+
+#define PIPELINE_BLOCK 64       /* Points parsed, and output rows formatted, per step of a stage */
+#define PIPELINE_DEPTH 4        /* Formatted blocks queued for the writer before the formatting waits */
+#define PIPELINE_GRAIN 8        /* Rows per claim of the affinity and formatting loops */
+#define PIPELINE_ENTRY_MAX 330  /* Longest "%.4f," of a double: 309 integer digits, sign, point, 4 decimals, separator */
+
+int pipeline_supported(const goal_e goal, const size_t dim);
+error_e pipeline_graph(char *filename, const size_t n, const size_t dim, const goal_e goal, FILE *stream);
+
+#endif /* PIPELINE_H */
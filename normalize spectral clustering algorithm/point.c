@@ -3,60 +3,104 @@
 #include <math.h>
 
 #include "point.h"
+#include "distance.h"
+#include "expbatch.h"
+#include "blas.h"
 
+/*All the coordinates live in one block, row after row, so points[0].elements is the contiguous n x dim array*/
 point_t *malloc_points(const size_t n, const size_t dim)
 {
-    point_t *points = (point_t *)malloc(n * sizeof(point_t));
+    point_t *points = (point_t *)malloc((n > 0 ? n : 1) * sizeof(point_t));
+    double *elements;
     size_t i;
+    if (NULL == points)
+    {
+        return NULL;
+    }
+    elements = (double *)malloc((n * dim > 0 ? n * dim : 1) * sizeof(double));
+    if (NULL == elements)
+    {
+        free(points);
+        return NULL;
+    }
+    points[0].elements = elements;
     for (i = 0; i < n; i++)
     {
-        points[i].elements = malloc(dim * sizeof(double));
+        points[i].elements = elements + i * dim;
     }
     return points;
 }
 
 void free_points(const size_t n, point_t *points)
 {
-    size_t i;
-    for (i = 0; i < n; i++)
-    {
-        free(points[i].elements);
-    }
+    (void)n;
+    free(points[0].elements);
     free(points);
 }
 
-/*A function to calculate the Euclidean distance between 2 points*/
+/*A function to calculate the Euclidean distance between 2 points. Loops over many pairs pick their kernel once instead*/
 double calc_distance(const point_t p1, const point_t p2, const size_t dim)
 {
-    double sum = 0;
-    size_t i = 0;
-    for (i = 0; i < dim; i++)
+    return select_distance_kernel(dim).distance(p1.elements, p2.elements, dim);
+}
+
+/*The Gaussian affinity of two points, as defined in section 1.1.1*/
+double calc_weight(const point_t p1, const point_t p2, const size_t dim)
+{
+    return exp(-calc_distance(p1, p2, dim) / 2.0);
+}
+
+/*A function to create a weight matrix as required in section 1.1.1. Each row's upper part is filled with exponents, exponentiated in one batch and mirrored below the diagonal*/
+int create_weight_matrix(const size_t n, double **weight_mat, point_t *points, const size_t dim)
+{
+    const distance_kernel_t kernel = select_distance_kernel(dim);
+    const exp_kernel_t exp_kernel = select_exp_kernel();
+    const int gram = dim >= BLAS_GRAM_MIN_DIM && 0 == blas_distances(n, points, dim, weight_mat);
+    size_t i, j;
+    for (i = 0; i < n; i++)
     {
-        sum += pow(p1.elements[i] - p2.elements[i], 2.0);
+        weight_mat[i][i] = 0.0;
+        for (j = i + 1; j < n; j++)
+        {
+            weight_mat[i][j] = -(gram ? weight_mat[i][j] : kernel.distance(points[i].elements, points[j].elements, dim)) / 2.0;
+        }
+        exp_batch(&exp_kernel, weight_mat[i] + i + 1, n - i - 1);
+        for (j = i + 1; j < n; j++)
+        {
+            weight_mat[j][i] = weight_mat[i][j];
+        }
     }
-    return sqrt(sum);
+    return 0;
 }
 
-/*A function to create a weight matrix as required in section 1.1.1*/
-int create_weight_matrix(const size_t n, double **weight_mat, point_t *points, const size_t dim)
+/*The diagonal of D straight from the points, with each row of affinities evaluated once in a scratch row and never stored*/
+int create_degree_vector(const size_t n, double *degrees, point_t *points, const size_t dim)
 {
+    const distance_kernel_t kernel = select_distance_kernel(dim);
+    const exp_kernel_t exp_kernel = select_exp_kernel();
+    double *row = (double *)malloc((n > 0 ? n : 1) * sizeof(double));
     size_t i, j;
-    double distance;
+    if (NULL == row)
+    {
+        return 1;
+    }
     for (i = 0; i < n; i++)
     {
-        for (j = i; j < n; j++)
+        degrees[i] = .0;
+    }
+    for (i = 0; i < n; i++)
+    {
+        for (j = i + 1; j < n; j++)
+        {
+            row[j] = -kernel.distance(points[i].elements, points[j].elements, dim) / 2.0;
+        }
+        exp_batch(&exp_kernel, row + i + 1, n - i - 1);
+        for (j = i + 1; j < n; j++)
         {
-            if (i != j)
-            {
-                distance = calc_distance(points[i], points[j], dim);
-                distance = exp(-distance / 2.0);
-                weight_mat[j][i] = weight_mat[i][j] = distance;
-            }
-            else
-            {
-                weight_mat[i][i] = 0.0;
-            }
+            degrees[i] += row[j];
+            degrees[j] += row[j];
         }
     }
+    free(row);
     return 0;
 }
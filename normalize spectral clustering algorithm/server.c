@@ -0,0 +1,691 @@
+/*
+ * A long-running daemon around the C core. Workers accept jobs on a Unix domain socket and share an LRU of
+ * parsed datasets and their decompositions, so a repeated request skips both parsing and the eigensolver.
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "server.h"
+#include "input.h"
+#include "point.h"
+#include "eigen.h"
+#include "matrix.h"
+#include "debug.h"
+#include "cache.h"
+#include "options.h"
+#include "parallel.h"
+#include "solver.h"
+#include "pic.h"
+
+typedef struct dataset_t
+{
+    unsigned long key;
+    size_t n;
+    size_t dim;
+    point_t *points; /* NULL for a Jacobi input matrix, which only keeps its eigens */
+    eigen_t *eigens; /* Sorted for point sets, in solver order for matrices; NULL until first needed */
+    size_t bytes;
+    size_t refs; /* Jobs using the dataset; it is only evicted at zero */
+    struct dataset_t *prev;
+    struct dataset_t *next;
+} dataset_t;
+
+typedef struct server_t
+{
+    int listen_fd;
+    int stopping;
+    size_t budget;
+    size_t bytes;
+    dataset_t *head; /* Most recently used first */
+    dataset_t *tail;
+    pthread_mutex_t lock;
+} server_t;
+
+int read_full(const int fd, void *buffer, const size_t len)
+{
+    char *bytes = (char *)buffer;
+    size_t done = 0;
+    ssize_t count;
+    while (done < len)
+    {
+        count = read(fd, bytes + done, len - done);
+        if (count < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if (count <= 0)
+        {
+            return -1;
+        }
+        done += (size_t)count;
+    }
+    return 0;
+}
+
+int write_full(const int fd, const void *buffer, const size_t len)
+{
+    const char *bytes = (const char *)buffer;
+    size_t done = 0;
+    ssize_t count;
+    while (done < len)
+    {
+        count = write(fd, bytes + done, len - done);
+        if (count < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if (count <= 0)
+        {
+            return -1;
+        }
+        done += (size_t)count;
+    }
+    return 0;
+}
+
+static size_t eigens_bytes(const size_t n)
+{
+    return n * (sizeof(eigen_t) + (n + 1) * sizeof(double));
+}
+
+static void free_dataset(dataset_t *dataset)
+{
+    if (NULL != dataset->points)
+    {
+        free_points(dataset->n, dataset->points);
+    }
+    if (NULL != dataset->eigens)
+    {
+        free_eigens(dataset->n, dataset->eigens);
+    }
+    free(dataset);
+}
+
+static void unlink_dataset(server_t *server, dataset_t *dataset)
+{
+    if (NULL != dataset->prev)
+    {
+        dataset->prev->next = dataset->next;
+    }
+    else
+    {
+        server->head = dataset->next;
+    }
+    if (NULL != dataset->next)
+    {
+        dataset->next->prev = dataset->prev;
+    }
+    else
+    {
+        server->tail = dataset->prev;
+    }
+    dataset->prev = dataset->next = NULL;
+}
+
+static void push_front(server_t *server, dataset_t *dataset)
+{
+    dataset->prev = NULL;
+    dataset->next = server->head;
+    if (NULL != server->head)
+    {
+        server->head->prev = dataset;
+    }
+    server->head = dataset;
+    if (NULL == server->tail)
+    {
+        server->tail = dataset;
+    }
+}
+
+/*Drops least recently used datasets nobody is using until the budget holds. Called with the lock held*/
+static void evict(server_t *server)
+{
+    dataset_t *dataset = server->tail, *prev;
+    while (server->bytes > server->budget && NULL != dataset)
+    {
+        prev = dataset->prev;
+        if (0 == dataset->refs)
+        {
+            unlink_dataset(server, dataset);
+            server->bytes -= dataset->bytes;
+            free_dataset(dataset);
+        }
+        dataset = prev;
+    }
+}
+
+/*Returns the dataset of 'key' pinned for the caller, or NULL. Called with the lock held*/
+static dataset_t *find_dataset(server_t *server, const unsigned long key)
+{
+    dataset_t *dataset;
+    for (dataset = server->head; NULL != dataset; dataset = dataset->next)
+    {
+        if (key == dataset->key)
+        {
+            unlink_dataset(server, dataset);
+            push_front(server, dataset);
+            dataset->refs++;
+            return dataset;
+        }
+    }
+    return NULL;
+}
+
+/*Publishes a freshly loaded dataset, unless another worker loaded the same one first*/
+static dataset_t *insert_dataset(server_t *server, dataset_t *dataset)
+{
+    dataset_t *existing;
+    pthread_mutex_lock(&server->lock);
+    existing = find_dataset(server, dataset->key);
+    if (NULL == existing)
+    {
+        push_front(server, dataset);
+        dataset->refs = 1;
+        server->bytes += dataset->bytes;
+        evict(server);
+    }
+    pthread_mutex_unlock(&server->lock);
+    if (NULL != existing)
+    {
+        free_dataset(dataset);
+        return existing;
+    }
+    return dataset;
+}
+
+static void release_dataset(server_t *server, dataset_t *dataset)
+{
+    pthread_mutex_lock(&server->lock);
+    dataset->refs--;
+    evict(server);
+    pthread_mutex_unlock(&server->lock);
+}
+
+/*Fills a new dataset from rows of doubles; a Jacobi matrix is decomposed right away and only its eigens kept*/
+static error_e build_dataset(dataset_t *dataset, double **rows, const int is_matrix)
+{
+    size_t i;
+    int failed;
+    if (is_matrix)
+    {
+        dataset->eigens = malloc_eigens(dataset->n);
+        if (NULL == dataset->eigens)
+        {
+            return MALLOC_ERROR;
+        }
+        failed = solve_jacobi_goal(dataset->n, rows, dataset->eigens, NULL);
+        dataset->bytes = sizeof(dataset_t) + eigens_bytes(dataset->n);
+        return failed ? MALLOC_ERROR : OK;
+    }
+    dataset->points = malloc_points(dataset->n, dataset->dim);
+    if (NULL == dataset->points)
+    {
+        return MALLOC_ERROR;
+    }
+    for (i = 0; i < dataset->n; i++)
+    {
+        memcpy(dataset->points[i].elements, rows[i], dataset->dim * sizeof(double));
+    }
+    dataset->bytes = sizeof(dataset_t) + dataset->n * (sizeof(point_t) + dataset->dim * sizeof(double));
+    return OK;
+}
+
+/*Parses the file of a path job. Points are read as the CLI reads them, a Jacobi matrix as an n x n matrix*/
+static error_e load_path(dataset_t *dataset, char *path, const int is_matrix)
+{
+    error_e result;
+    double **rows;
+    dataset->n = get_lines_count(path);
+    dataset->dim = is_matrix ? dataset->n : get_dimension(path);
+    if (0 == dataset->n || 0 == dataset->dim)
+    {
+        return INVALID_INPUT;
+    }
+    if (!is_matrix)
+    {
+        dataset->points = malloc_points(dataset->n, dataset->dim);
+        if (NULL == dataset->points)
+        {
+            return MALLOC_ERROR;
+        }
+        dataset->bytes = sizeof(dataset_t) + dataset->n * (sizeof(point_t) + dataset->dim * sizeof(double));
+        return OK == read_points(path, dataset->points, dataset->n, dataset->dim) ? OK : INVALID_INPUT;
+    }
+    rows = (double **)malloc_matrix(dataset->n, dataset->n, sizeof(double));
+    if (NULL == rows)
+    {
+        return MALLOC_ERROR;
+    }
+    result = OK == read_matrix(path, rows, dataset->n) ? build_dataset(dataset, rows, is_matrix) : INVALID_INPUT;
+    free_matrix(dataset->n, (void **)rows);
+    return result;
+}
+
+/*Parses inline doubles, which the client already laid out row after row*/
+static error_e load_inline(dataset_t *dataset, double *payload, const int is_matrix)
+{
+    error_e result;
+    double **rows;
+    size_t i;
+    rows = (double **)malloc(dataset->n * sizeof(double *));
+    if (NULL == rows)
+    {
+        return MALLOC_ERROR;
+    }
+    for (i = 0; i < dataset->n; i++)
+    {
+        rows[i] = payload + i * dataset->dim;
+    }
+    result = build_dataset(dataset, rows, is_matrix);
+    free(rows);
+    return result;
+}
+
+/*Reads the payload of a job and returns its dataset pinned, loading it only when it is not already warm*/
+static error_e acquire_dataset(server_t *server, const int fd, job_header_t *header, dataset_t **acquired)
+{
+    error_e result = INVALID_INPUT;
+    const int is_matrix = JACOBI == (goal_e)header->goal;
+    struct stat file_stat;
+    dataset_t *dataset;
+    double *payload = NULL;
+    char *path = NULL;
+    unsigned long key = hash_bytes(FNV_OFFSET, &header->source, sizeof(header->source));
+
+    key = hash_bytes(key, &is_matrix, sizeof(is_matrix));
+    if (PATH_SOURCE == header->source)
+    {
+        if (0 == header->path_len || header->path_len > SERVER_MAX_PATH)
+        {
+            return INVALID_INPUT;
+        }
+        path = (char *)malloc(header->path_len + 1);
+        if (NULL == path)
+        {
+            return MALLOC_ERROR;
+        }
+        if (read_full(fd, path, header->path_len) != 0)
+        {
+            goto cleanup;
+        }
+        path[header->path_len] = '\0';
+        if (stat(path, &file_stat) != 0)
+        {
+            goto cleanup;
+        }
+        /* A changed file gets a new key, the stale entry simply ages out of the LRU */
+        key = hash_bytes(key, path, header->path_len);
+        key = hash_bytes(key, &file_stat.st_dev, sizeof(file_stat.st_dev));
+        key = hash_bytes(key, &file_stat.st_ino, sizeof(file_stat.st_ino));
+        key = hash_bytes(key, &file_stat.st_size, sizeof(file_stat.st_size));
+        key = hash_bytes(key, &file_stat.st_mtime, sizeof(file_stat.st_mtime));
+    }
+    else if (INLINE_SOURCE == header->source)
+    {
+        if (0 == header->n || 0 == header->dim || (is_matrix && header->n != header->dim) ||
+            header->dim > server->budget / sizeof(double) / header->n)
+        {
+            return INVALID_INPUT;
+        }
+        payload = (double *)malloc(header->n * header->dim * sizeof(double));
+        if (NULL == payload)
+        {
+            return MALLOC_ERROR;
+        }
+        if (read_full(fd, payload, header->n * header->dim * sizeof(double)) != 0)
+        {
+            goto cleanup;
+        }
+        key = hash_bytes(key, &header->n, sizeof(header->n));
+        key = hash_bytes(key, &header->dim, sizeof(header->dim));
+        key = hash_bytes(key, payload, header->n * header->dim * sizeof(double));
+    }
+    else
+    {
+        return INVALID_INPUT;
+    }
+
+    pthread_mutex_lock(&server->lock);
+    *acquired = find_dataset(server, key);
+    pthread_mutex_unlock(&server->lock);
+    if (NULL != *acquired)
+    {
+        result = OK;
+        goto cleanup;
+    }
+
+    result = MALLOC_ERROR;
+    dataset = (dataset_t *)calloc(1, sizeof(dataset_t));
+    if (NULL == dataset)
+    {
+        goto cleanup;
+    }
+    dataset->key = key;
+    if (PATH_SOURCE == header->source)
+    {
+        result = load_path(dataset, path, is_matrix);
+    }
+    else
+    {
+        dataset->n = header->n;
+        dataset->dim = header->dim;
+        result = load_inline(dataset, payload, is_matrix);
+    }
+    if (OK != result)
+    {
+        free_dataset(dataset);
+        goto cleanup;
+    }
+    *acquired = insert_dataset(server, dataset);
+
+cleanup:
+    free(payload);
+    free(path);
+    return result;
+}
+
+/*Decomposes a point set the first time spk asks for it; later jobs reuse the sorted eigens*/
+static eigen_t *acquire_eigens(server_t *server, dataset_t *dataset)
+{
+    eigen_t *eigens, *shared;
+    pthread_mutex_lock(&server->lock);
+    eigens = dataset->eigens;
+    pthread_mutex_unlock(&server->lock);
+    if (NULL != eigens)
+    {
+        return eigens;
+    }
+
+    eigens = malloc_eigens(dataset->n);
+    if (NULL == eigens)
+    {
+        return NULL;
+    }
+    if (OK != calc_sorted_eigens(dataset->n, dataset->points, dataset->dim, eigens, NULL, NULL))
+    {
+        free_eigens(dataset->n, eigens);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&server->lock);
+    if (NULL == dataset->eigens)
+    {
+        dataset->eigens = eigens;
+        dataset->bytes += eigens_bytes(dataset->n);
+        server->bytes += eigens_bytes(dataset->n);
+        evict(server);
+        eigens = NULL;
+    }
+    shared = dataset->eigens;
+    pthread_mutex_unlock(&server->lock);
+    if (NULL != eigens)
+    {
+        free_eigens(dataset->n, eigens); /* Another worker decomposed it meanwhile */
+    }
+    return shared;
+}
+
+/*The ddg job, from the degree vector alone as in the CLI*/
+static error_e run_degree_job(dataset_t *dataset, FILE *out, reply_header_t *reply)
+{
+    error_e result;
+    double *degrees = (double *)malloc((dataset->n > 0 ? dataset->n : 1) * sizeof(double));
+    if (NULL == degrees)
+    {
+        return MALLOC_ERROR;
+    }
+    result = calc_degrees(dataset->n, dataset->points, dataset->dim, degrees);
+    if (OK == result)
+    {
+        reply->status = OK;
+        fwrite(reply, sizeof(*reply), 1, out);
+        fprint_diagonal(out, dataset->n, degrees);
+    }
+    free(degrees);
+    return result;
+}
+
+/*Runs one job and formats its output into 'out'*/
+static error_e run_job(server_t *server, dataset_t *dataset, job_header_t *header, FILE *out, reply_header_t *reply)
+{
+    const goal_e goal = (goal_e)header->goal;
+    error_e result;
+    eigen_t *eigens = NULL;
+    double **mat;
+    size_t k = header->k;
+
+    if (JACOBI == goal)
+    {
+        reply->status = OK;
+        fwrite(reply, sizeof(*reply), 1, out);
+        fprint_eigen(out, dataset->n, dataset->eigens);
+        return OK;
+    }
+    if (DIAGONAL_DEGREE_MATRIX == goal)
+    {
+        return run_degree_job(dataset, out, reply);
+    }
+    if (NORMALIZED_EIGEN_MATRIX == goal)
+    {
+        if (k > dataset->n)
+        {
+            return INVALID_INPUT;
+        }
+        eigens = acquire_eigens(server, dataset);
+        if (NULL == eigens)
+        {
+            return MALLOC_ERROR;
+        }
+        if (0 == k)
+        {
+            k = find_eigengap_max(dataset->n, eigens);
+        }
+    }
+    if (POWER_ITERATION_EMBEDDING == goal)
+    {
+        k = pic_columns(dataset->n);
+    }
+    mat = (double **)malloc_matrix(dataset->n, NORMALIZED_EIGEN_MATRIX == goal || POWER_ITERATION_EMBEDDING == goal ? k : dataset->n, sizeof(double));
+    if (NULL == mat)
+    {
+        return MALLOC_ERROR;
+    }
+    if (NORMALIZED_EIGEN_MATRIX == goal)
+    {
+        result = embed_eigens(dataset->n, eigens, &k, mat);
+    }
+    else
+    {
+        result = calc_matrix(dataset->n, dataset->points, dataset->dim, goal, mat, &k, NULL);
+        k = POWER_ITERATION_EMBEDDING == goal ? k : dataset->n;
+    }
+    if (OK == result)
+    {
+        reply->status = OK;
+        fwrite(reply, sizeof(*reply), 1, out);
+        fprint_matrix(out, dataset->n, k, mat);
+    }
+    free_matrix(dataset->n, (void **)mat);
+    return result;
+}
+
+/*Reads one job from an accepted connection, answers it and closes the connection*/
+static void handle_connection(server_t *server, const int fd)
+{
+    job_header_t header;
+    reply_header_t reply;
+    dataset_t *dataset = NULL;
+    error_e result = INVALID_INPUT;
+    FILE *out;
+
+    out = fdopen(fd, "wb");
+    if (NULL == out)
+    {
+        close(fd);
+        return;
+    }
+    if (read_full(fd, &header, sizeof(header)) == 0 && memcmp(header.magic, JOB_MAGIC, sizeof(JOB_MAGIC)) == 0 &&
+        header.goal <= POWER_ITERATION_EMBEDDING)
+    {
+        result = acquire_dataset(server, fd, &header, &dataset);
+    }
+    if (OK == result)
+    {
+        result = run_job(server, dataset, &header, out, &reply);
+        release_dataset(server, dataset);
+    }
+    if (OK != result)
+    {
+        reply.status = result;
+        fwrite(&reply, sizeof(reply), 1, out);
+    }
+    fclose(out);
+}
+
+static void *serve_worker(void *arg)
+{
+    server_t *server = (server_t *)arg;
+    int fd, stopping;
+    while (TRUE)
+    {
+        fd = accept(server->listen_fd, NULL, NULL);
+        if (fd >= 0)
+        {
+            handle_connection(server, fd);
+            continue;
+        }
+        pthread_mutex_lock(&server->lock);
+        stopping = server->stopping;
+        pthread_mutex_unlock(&server->lock);
+        if (stopping || (EINTR != errno && ECONNABORTED != errno))
+        {
+            break;
+        }
+    }
+    return NULL;
+}
+
+/*Whether a server still accepts connections at the address; only a refused connection means none does*/
+static int socket_in_use(struct sockaddr_un *address)
+{
+    int fd, in_use;
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        return 1;
+    }
+    in_use = connect(fd, (struct sockaddr *)address, sizeof(*address)) == 0 || ECONNREFUSED != errno;
+    close(fd);
+    return in_use;
+}
+
+/*Listens on 'socket_path' until SIGINT or SIGTERM, answering jobs on a pool of SPKM_NUM_THREADS workers*/
+int serve(const char *socket_path)
+{
+    int result = -1, sig;
+    server_t server;
+    options_t options;
+    struct sockaddr_un address;
+    struct sigaction ignore;
+    struct stat file_stat;
+    sigset_t signals, old_signals;
+    pthread_t *workers;
+    size_t num_workers, started = 0, i;
+    dataset_t *dataset;
+
+    load_options(&options);
+    memset(&server, 0, sizeof(server));
+    server.budget = options.server_memory;
+    memset(&address, 0, sizeof(address));
+    if (strlen(socket_path) >= sizeof(address.sun_path))
+    {
+        return -1;
+    }
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+    if (stat(socket_path, &file_stat) == 0 && S_ISSOCK(file_stat.st_mode))
+    {
+        if (socket_in_use(&address))
+        {
+            return -1;
+        }
+        unlink(socket_path); /* Left behind by a server that did not shut down cleanly */
+    }
+
+    server.listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server.listen_fd < 0)
+    {
+        return -1;
+    }
+    if (bind(server.listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0)
+    {
+        goto socket_cleanup;
+    }
+    if (listen(server.listen_fd, SERVER_BACKLOG) != 0)
+    {
+        goto unlink_cleanup;
+    }
+    num_workers = get_num_threads();
+    workers = (pthread_t *)malloc(num_workers * sizeof(pthread_t));
+    if (NULL == workers)
+    {
+        goto unlink_cleanup;
+    }
+    pthread_mutex_init(&server.lock, NULL);
+
+    /* Workers inherit the blocked mask, so the termination signals reach sigwait() below */
+    memset(&ignore, 0, sizeof(ignore));
+    ignore.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &ignore, NULL);
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, &old_signals);
+
+    for (started = 0; started < num_workers; started++)
+    {
+        if (pthread_create(&workers[started], NULL, serve_worker, &server) != 0)
+        {
+            break;
+        }
+    }
+    if (started == num_workers)
+    {
+        sigwait(&signals, &sig);
+        result = 0;
+    }
+
+    pthread_mutex_lock(&server.lock);
+    server.stopping = TRUE;
+    pthread_mutex_unlock(&server.lock);
+    shutdown(server.listen_fd, SHUT_RDWR); /* Wakes the workers blocked in accept() */
+    for (i = 0; i < started; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+    pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+    while (NULL != server.head)
+    {
+        dataset = server.head;
+        unlink_dataset(&server, dataset);
+        free_dataset(dataset);
+    }
+    pthread_mutex_destroy(&server.lock);
+    free(workers);
+
+unlink_cleanup:
+    unlink(socket_path);
+socket_cleanup:
+    close(server.listen_fd);
+    return result;
+}
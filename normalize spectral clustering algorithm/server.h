@@ -0,0 +1,42 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "spkmeans.h"
+
+#define SERVE_COMMAND "serve"
+#define JOB_MAGIC "SPKMJOB"
+#define SERVER_BACKLOG 64
+#define SERVER_MAX_PATH 4096
+
+typedef enum job_source_e
+{
+    PATH_SOURCE = 0,  /* The job names a file readable by the server */
+    INLINE_SOURCE = 1 /* n * dim native doubles follow the header */
+} job_source_e;
+
+/*Sent by the client, followed by 'path_len' bytes of path or the inline doubles*/
+typedef struct job_header_t
+{
+    char magic[8];
+    unsigned long goal; /* A goal_e value */
+    unsigned long k;    /* Only read by the spk goal, 0 uses the eigengap */
+    unsigned long source;
+    unsigned long n;
+    unsigned long dim;
+    unsigned long path_len;
+} job_header_t;
+
+/*Sent back by the server, followed by the job output exactly as the CLI prints it*/
+typedef struct reply_header_t
+{
+    unsigned long status; /* An error_e value */
+} reply_header_t;
+
+int read_full(const int fd, void *buffer, const size_t len);
+int write_full(const int fd, const void *buffer, const size_t len);
+int serve(const char *socket_path);
+error_e request_job(const char *socket_path, const goal_e goal, const size_t k, const char *path, FILE *out);
+
+#endif /* SERVER_H */
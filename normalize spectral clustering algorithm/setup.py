@@ -1,9 +1,18 @@
 from setuptools import find_packages, setup, Extension
 from pathlib import Path
+from ctypes.util import find_library
 
 SRC_PATH = Path("./")
 sources = [str(file) for file in SRC_PATH.glob("*.c")]
-module1 = Extension("spkm", sources=sources)
+libraries = ["m", "pthread"]
+define_macros = []
+# Link a system BLAS/LAPACK when one is installed; without it the native kernels are used
+for candidates in (["openblas"], ["lapack", "blas"]):
+    if all(find_library(name) for name in candidates):
+        libraries += candidates
+        define_macros.append(("SPKM_HAVE_LAPACK", None))
+        break
+module1 = Extension("spkm", sources=sources, libraries=libraries, define_macros=define_macros)
 
 setup(
     name="spkm",
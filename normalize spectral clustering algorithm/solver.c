@@ -0,0 +1,75 @@
+/*Dispatches eigendecompositions to the backend selected by SPKM_EIGEN_SOLVER*/
+#include <stdlib.h>
+
+#include "solver.h"
+#include "jacobi.h"
+#include "tridiag.h"
+#include "subspace.h"
+#include "blas.h"
+
+/*
+ * All n eigenpairs, in the backend's own order, with the same contract as jacobi(). The subspace solver only
+ * targets a few eigenpairs, so it leaves full decompositions to jacobi(). With a LAPACK build the default
+ * Jacobi solver is replaced by dsyevr unless SPKM_BACKEND is "native". Only the Jacobi sweeps poll
+ * 'deadline'; the direct solvers run to completion. The matrix-free solver never sees a dense matrix (see
+ * calc_matrix()), so one that reaches here is decomposed like the default.
+ */
+int solve_eigens(const size_t n, double **mat, eigen_t *eigens, deadline_t *deadline)
+{
+    options_t options;
+    load_options(&options);
+    if (TRIDIAG_QL_SOLVER == options.eigen_solver)
+    {
+        return tridiag_eigens(n, mat, eigens);
+    }
+    if ((JACOBI_SOLVER == options.eigen_solver || MATRIX_FREE_SOLVER == options.eigen_solver) && 0 == blas_eigens(n, mat, eigens))
+    {
+        return 0;
+    }
+    return jacobi_until(n, mat, NULL, eigens, deadline);
+}
+
+/*
+ * The jacobi goal, whose output is the reference Jacobi's: the default solver stays the native one even with
+ * a LAPACK build, and only an explicit SPKM_EIGEN_SOLVER picks another backend.
+ */
+int solve_jacobi_goal(const size_t n, double **mat, eigen_t *eigens, deadline_t *deadline)
+{
+    options_t options;
+    load_options(&options);
+    if (JACOBI_SOLVER == options.eigen_solver)
+    {
+        return jacobi_until(n, mat, NULL, eigens, deadline);
+    }
+    return solve_eigens(n, mat, eigens, deadline);
+}
+
+/*
+ * Eigenpairs sorted as in section 1.3, with *k chosen by the eigengap when it is 0.
+ * Only the first *k eigenvectors are guaranteed; backends that can skip the others do.
+ */
+int solve_top_eigens(const size_t n, double **mat, eigen_t *eigens, size_t *k, deadline_t *deadline)
+{
+    int result;
+    options_t options;
+    load_options(&options);
+    if (TRIDIAG_QL_SOLVER == options.eigen_solver)
+    {
+        return tridiag_top_eigens(n, mat, eigens, k);
+    }
+    if (SUBSPACE_SOLVER == options.eigen_solver && *k > 0) /* The eigengap needs half the spectrum, which the subspace solver does not produce */
+    {
+        return subspace_top_eigens(n, mat, eigens, *k, options.oversample, options.power_iters);
+    }
+    if ((JACOBI_SOLVER == options.eigen_solver || MATRIX_FREE_SOLVER == options.eigen_solver) && 0 == blas_top_eigens(n, mat, eigens, k))
+    {
+        return 0;
+    }
+    result = jacobi_until(n, mat, NULL, eigens, deadline);
+    qsort(eigens, n, sizeof(eigen_t), compare_eigenvalues);
+    if (0 == *k)
+    {
+        *k = find_eigengap_max(n, eigens);
+    }
+    return result;
+}
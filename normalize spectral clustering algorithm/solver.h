@@ -0,0 +1,13 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <stdlib.h>
+#include "eigen.h"
+#include "options.h"
+#include "deadline.h"
+
+int solve_eigens(const size_t n, double **mat, eigen_t *eigens, deadline_t *deadline);
+int solve_jacobi_goal(const size_t n, double **mat, eigen_t *eigens, deadline_t *deadline);
+int solve_top_eigens(const size_t n, double **mat, eigen_t *eigens, size_t *k, deadline_t *deadline);
+
+#endif /* SOLVER_H */
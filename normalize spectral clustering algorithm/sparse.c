@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sparse.h"
+#include "spatial.h"
+
+typedef struct entry_t
+{
+    size_t column;
+    double value;
+} entry_t;
+
+static int compare_entries(const void *a, const void *b)
+{
+    const entry_t *left = (const entry_t *)a, *right = (const entry_t *)b;
+    return (left->column > right->column) - (left->column < right->column);
+}
+
+/*
+ * The affinities of W that are at least 'threshold', found by radius queries on a spatial index instead of
+ * evaluating all n^2 pairs: exp(-d / 2) >= threshold exactly when d <= -2 ln(threshold). The diagonal is
+ * left out as in create_weight_matrix. With epsilon > 0 the queries are approximate (see spatial.h).
+ */
+int create_weight_sparse(const size_t n, sparse_t *w, point_t *points, const size_t dim, const double threshold, const double epsilon)
+{
+    int result = 1;
+    spatial_index_t index;
+    neighbors_t *neighbors;
+    entry_t *row;
+    size_t i, j, len, nnz = 0, max_len = 0;
+
+    memset(w, 0, sizeof(*w));
+    w->n = n;
+    if (threshold <= .0 || threshold > 1.0)
+    {
+        return 1;
+    }
+    neighbors = (neighbors_t *)calloc(n > 0 ? n : 1, sizeof(neighbors_t));
+    if (NULL == neighbors)
+    {
+        return 1;
+    }
+    if (spatial_build(&index, points, n, dim, epsilon) != 0)
+    {
+        goto neighbors_cleanup;
+    }
+    if (spatial_radius(&index, points, n, -2.0 * log(threshold), neighbors) != 0)
+    {
+        goto index_cleanup;
+    }
+    for (i = 0; i < n; i++)
+    {
+        nnz += neighbors[i].len;
+        max_len = neighbors[i].len > max_len ? neighbors[i].len : max_len;
+    }
+
+    w->row_start = (size_t *)malloc((n + 1) * sizeof(size_t));
+    w->columns = (size_t *)malloc((nnz > 0 ? nnz : 1) * sizeof(size_t));
+    w->values = (double *)malloc((nnz > 0 ? nnz : 1) * sizeof(double));
+    row = (entry_t *)malloc((max_len > 0 ? max_len : 1) * sizeof(entry_t));
+    if (NULL == w->row_start || NULL == w->columns || NULL == w->values || NULL == row)
+    {
+        free(row);
+        free_sparse(w);
+        goto radius_cleanup;
+    }
+    w->row_start[0] = 0;
+    for (i = 0; i < n; i++)
+    {
+        for (len = 0, j = 0; j < neighbors[i].len; j++)
+        {
+            if (neighbors[i].indices[j] != i)
+            {
+                row[len].column = neighbors[i].indices[j];
+                row[len++].value = exp(-neighbors[i].distances[j] / 2.0);
+            }
+        }
+        qsort(row, len, sizeof(entry_t), compare_entries);
+        for (j = 0; j < len; j++)
+        {
+            w->columns[w->row_start[i] + j] = row[j].column;
+            w->values[w->row_start[i] + j] = row[j].value;
+        }
+        w->row_start[i + 1] = w->row_start[i] + len;
+    }
+    free(row);
+    result = 0;
+
+radius_cleanup:
+    free_neighbors(n, neighbors);
+index_cleanup:
+    spatial_free(&index);
+neighbors_cleanup:
+    free(neighbors);
+    return result;
+}
+
+/*Scatters a sparse matrix into a dense one, every other entry zero*/
+void sparse_to_dense(sparse_t *w, double **mat)
+{
+    size_t i, j;
+    for (i = 0; i < w->n; i++)
+    {
+        memset(mat[i], 0, w->n * sizeof(double));
+        for (j = w->row_start[i]; j < w->row_start[i + 1]; j++)
+        {
+            mat[i][w->columns[j]] = w->values[j];
+        }
+    }
+}
+
+/*The row sums of W, which are the diagonal of D, in the order the dense sum would add them*/
+void sparse_degrees(sparse_t *w, double *degrees)
+{
+    size_t i, j;
+    for (i = 0; i < w->n; i++)
+    {
+        degrees[i] = .0;
+        for (j = w->row_start[i]; j < w->row_start[i + 1]; j++)
+        {
+            degrees[i] += w->values[j];
+        }
+    }
+}
+
+void free_sparse(sparse_t *w)
+{
+    free(w->row_start);
+    free(w->columns);
+    free(w->values);
+    w->row_start = w->columns = NULL;
+    w->values = NULL;
+}
@@ -0,0 +1,21 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include <stdlib.h>
+#include "point.h"
+
+/*A symmetric matrix in compressed sparse rows, columns ascending within each row*/
+typedef struct sparse_t
+{
+    size_t n;
+    size_t *row_start; /* n + 1 offsets into columns and values */
+    size_t *columns;
+    double *values;
+} sparse_t;
+
+int create_weight_sparse(const size_t n, sparse_t *w, point_t *points, const size_t dim, const double threshold, const double epsilon);
+void sparse_to_dense(sparse_t *w, double **mat);
+void sparse_degrees(sparse_t *w, double *degrees);
+void free_sparse(sparse_t *w);
+
+#endif /* SPARSE_H */
@@ -0,0 +1,514 @@
+/*
+ * Spatial index over a point array for neighbour queries: a KD-tree up to SPATIAL_KD_MAX_DIM dimensions and
+ * a VP-tree above it. Both are built by median splits, so a query visits O(log n) nodes on well spread data.
+ * With epsilon > 0 a branch is only searched if it may hold a point closer than bound / (1 + epsilon), which
+ * trades exactness for fewer visited leaves; every reported neighbour is still within the bound.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+
+#include "spatial.h"
+#include "parallel.h"
+
+typedef struct knn_search_t
+{
+    point_t query;
+    size_t k;
+    size_t len;
+    size_t *indices; /* Max-heap on distances, the current k-th neighbour on top */
+    double *distances;
+} knn_search_t;
+
+typedef struct query_job_t
+{
+    spatial_index_t *index;
+    point_t *queries;
+    size_t queries_len;
+    size_t k;
+    size_t *indices;
+    double *distances;
+    double radius;
+    neighbors_t *results;
+    int *failed; /* One flag per block, so the tasks never write the same memory */
+} query_job_t;
+
+/*Rearranges order[begin, end) and keys alike so that position 'kth' holds the element of that rank*/
+static void select_kth(size_t *order, double *keys, size_t begin, size_t end, const size_t kth)
+{
+    size_t i, store, swap_index;
+    double pivot, swap_key;
+    while (end - begin > 1)
+    {
+        i = begin + (end - begin) / 2;
+        pivot = keys[i];
+        keys[i] = keys[end - 1];
+        keys[end - 1] = pivot;
+        swap_index = order[i];
+        order[i] = order[end - 1];
+        order[end - 1] = swap_index;
+        for (store = begin, i = begin; i < end - 1; i++)
+        {
+            if (keys[i] < pivot)
+            {
+                swap_key = keys[i];
+                keys[i] = keys[store];
+                keys[store] = swap_key;
+                swap_index = order[i];
+                order[i] = order[store];
+                order[store] = swap_index;
+                store++;
+            }
+        }
+        keys[end - 1] = keys[store];
+        keys[store] = pivot;
+        swap_index = order[end - 1];
+        order[end - 1] = order[store];
+        order[store] = swap_index;
+        if (store == kth)
+        {
+            return;
+        }
+        if (kth < store)
+        {
+            end = store;
+        }
+        else
+        {
+            begin = store + 1;
+        }
+    }
+}
+
+static size_t new_node(spatial_index_t *index, const size_t begin, const size_t end)
+{
+    spatial_node_t *nodes;
+    size_t capacity;
+    if (index->nodes_len == index->nodes_capacity)
+    {
+        capacity = 2 * index->nodes_capacity + 1;
+        nodes = (spatial_node_t *)realloc(index->nodes, capacity * sizeof(spatial_node_t));
+        if (NULL == nodes)
+        {
+            return SPATIAL_NO_CHILD;
+        }
+        index->nodes = nodes;
+        index->nodes_capacity = capacity;
+    }
+    index->nodes[index->nodes_len].begin = begin;
+    index->nodes[index->nodes_len].end = end;
+    index->nodes[index->nodes_len].left = SPATIAL_NO_CHILD;
+    index->nodes[index->nodes_len].right = SPATIAL_NO_CHILD;
+    return index->nodes_len++;
+}
+
+/*Splits a KD node on the coordinate of widest spread at its median*/
+static size_t split_kd(spatial_index_t *index, const size_t begin, const size_t end, double *keys, size_t *mid)
+{
+    size_t axis = 0, i, j;
+    double low, high, spread = -1.0, value;
+    for (j = 0; j < index->dim; j++)
+    {
+        low = high = index->points[index->order[begin]].elements[j];
+        for (i = begin + 1; i < end; i++)
+        {
+            value = index->points[index->order[i]].elements[j];
+            low = value < low ? value : low;
+            high = value > high ? value : high;
+        }
+        if (high - low > spread)
+        {
+            spread = high - low;
+            axis = j;
+        }
+    }
+    for (i = begin; i < end; i++)
+    {
+        keys[i] = index->points[index->order[i]].elements[axis];
+    }
+    *mid = begin + (end - begin) / 2;
+    select_kth(index->order, keys, begin, end, *mid);
+    return axis;
+}
+
+/*Splits a VP node: the vantage point stays first and the rest is divided at the median distance to it*/
+static void split_vp(spatial_index_t *index, const size_t begin, const size_t end, double *keys, size_t *mid)
+{
+    size_t i;
+    for (i = begin + 1; i < end; i++)
+    {
+        keys[i] = index->distance(index->points[index->order[begin]].elements, index->points[index->order[i]].elements, index->dim);
+    }
+    *mid = begin + 1 + (end - begin - 1) / 2;
+    select_kth(index->order, keys, begin + 1, end, *mid);
+}
+
+static size_t build_node(spatial_index_t *index, const size_t begin, const size_t end, double *keys)
+{
+    size_t node, mid, child;
+    node = new_node(index, begin, end);
+    if (SPATIAL_NO_CHILD == node || end - begin <= SPATIAL_LEAF_SIZE)
+    {
+        return node;
+    }
+    if (KD_TREE == index->kind)
+    {
+        index->nodes[node].pivot = split_kd(index, begin, end, keys, &mid);
+    }
+    else
+    {
+        split_vp(index, begin, end, keys, &mid);
+        index->nodes[node].pivot = index->order[begin];
+    }
+    index->nodes[node].split = keys[mid];
+
+    child = build_node(index, KD_TREE == index->kind ? begin : begin + 1, mid, keys);
+    if (SPATIAL_NO_CHILD == child)
+    {
+        return SPATIAL_NO_CHILD;
+    }
+    index->nodes[node].left = child; /* Not through a pointer: the recursion may have moved the nodes */
+    child = build_node(index, mid, end, keys);
+    if (SPATIAL_NO_CHILD == child)
+    {
+        return SPATIAL_NO_CHILD;
+    }
+    index->nodes[node].right = child;
+    return node;
+}
+
+/*Builds the index over 'points', choosing the tree kind by dimension. Returns non-zero on allocation failure*/
+int spatial_build(spatial_index_t *index, point_t *points, const size_t n, const size_t dim, const double epsilon)
+{
+    double *keys;
+    size_t i;
+    memset(index, 0, sizeof(*index));
+    index->n = n;
+    index->dim = dim;
+    index->points = points;
+    index->distance = select_distance_kernel(dim).distance;
+    index->kind = dim <= SPATIAL_KD_MAX_DIM ? KD_TREE : VP_TREE;
+    index->epsilon = epsilon > .0 ? epsilon : .0;
+    index->order = (size_t *)malloc((n > 0 ? n : 1) * sizeof(size_t));
+    keys = (double *)malloc((n > 0 ? n : 1) * sizeof(double));
+    if (NULL == index->order || NULL == keys)
+    {
+        free(keys);
+        spatial_free(index);
+        return 1;
+    }
+    for (i = 0; i < n; i++)
+    {
+        index->order[i] = i;
+    }
+    if (n > 0 && SPATIAL_NO_CHILD == build_node(index, 0, n, keys))
+    {
+        free(keys);
+        spatial_free(index);
+        return 1;
+    }
+    free(keys);
+    return 0;
+}
+
+static double knn_bound(knn_search_t *search)
+{
+    return search->len < search->k ? DBL_MAX : search->distances[0];
+}
+
+/*Restores the max-heap below position i after its distance shrank*/
+static void sift_down(double *distances, size_t *indices, const size_t len, size_t i)
+{
+    size_t child, swap_index;
+    double swap;
+    for (; 2 * i + 1 < len; i = child)
+    {
+        child = 2 * i + 1;
+        if (child + 1 < len && distances[child + 1] > distances[child])
+        {
+            child++;
+        }
+        if (distances[child] <= distances[i])
+        {
+            break;
+        }
+        swap = distances[i];
+        distances[i] = distances[child];
+        distances[child] = swap;
+        swap_index = indices[i];
+        indices[i] = indices[child];
+        indices[child] = swap_index;
+    }
+}
+
+static void knn_offer(knn_search_t *search, const size_t candidate, const double distance)
+{
+    size_t i, swap_index;
+    double swap;
+    if (search->len < search->k)
+    {
+        i = search->len++;
+        search->indices[i] = candidate;
+        search->distances[i] = distance;
+        while (i > 0 && search->distances[(i - 1) / 2] < search->distances[i])
+        {
+            swap = search->distances[i];
+            search->distances[i] = search->distances[(i - 1) / 2];
+            search->distances[(i - 1) / 2] = swap;
+            swap_index = search->indices[i];
+            search->indices[i] = search->indices[(i - 1) / 2];
+            search->indices[(i - 1) / 2] = swap_index;
+            i = (i - 1) / 2;
+        }
+    }
+    else if (distance < search->distances[0])
+    {
+        search->indices[0] = candidate;
+        search->distances[0] = distance;
+        sift_down(search->distances, search->indices, search->len, 0);
+    }
+}
+
+static void knn_node(spatial_index_t *index, knn_search_t *search, const size_t node_index)
+{
+    const spatial_node_t *node = &index->nodes[node_index];
+    const double scale = 1.0 + index->epsilon;
+    double offset, distance;
+    size_t i, near, far;
+
+    if (SPATIAL_NO_CHILD == node->left)
+    {
+        for (i = node->begin; i < node->end; i++)
+        {
+            knn_offer(search, index->order[i], index->distance(search->query.elements, index->points[index->order[i]].elements, index->dim));
+        }
+        return;
+    }
+    if (KD_TREE == index->kind)
+    {
+        offset = search->query.elements[node->pivot] - node->split;
+        near = offset < .0 ? node->left : node->right;
+        far = offset < .0 ? node->right : node->left;
+        knn_node(index, search, near);
+        if ((offset < .0 ? -offset : offset) * scale < knn_bound(search))
+        {
+            knn_node(index, search, far);
+        }
+        return;
+    }
+    distance = index->distance(search->query.elements, index->points[node->pivot].elements, index->dim);
+    knn_offer(search, node->pivot, distance);
+    if (distance < node->split)
+    {
+        knn_node(index, search, node->left);
+        if ((node->split - distance) * scale < knn_bound(search))
+        {
+            knn_node(index, search, node->right);
+        }
+    }
+    else
+    {
+        knn_node(index, search, node->right);
+        if ((distance - node->split) * scale <= knn_bound(search))
+        {
+            knn_node(index, search, node->left);
+        }
+    }
+}
+
+/*Appends one neighbour, growing the arrays geometrically. Returns non-zero on allocation failure*/
+static int neighbors_push(neighbors_t *neighbors, const size_t candidate, const double distance)
+{
+    size_t capacity, *indices;
+    double *distances;
+    if (neighbors->len == neighbors->capacity)
+    {
+        capacity = 2 * neighbors->capacity + 8;
+        indices = (size_t *)realloc(neighbors->indices, capacity * sizeof(size_t));
+        if (NULL == indices)
+        {
+            return 1;
+        }
+        neighbors->indices = indices;
+        distances = (double *)realloc(neighbors->distances, capacity * sizeof(double));
+        if (NULL == distances)
+        {
+            return 1;
+        }
+        neighbors->distances = distances;
+        neighbors->capacity = capacity;
+    }
+    neighbors->indices[neighbors->len] = candidate;
+    neighbors->distances[neighbors->len++] = distance;
+    return 0;
+}
+
+static int radius_node(spatial_index_t *index, point_t query, const double radius, neighbors_t *neighbors, const size_t node_index)
+{
+    const spatial_node_t *node = &index->nodes[node_index];
+    const double reach = radius / (1.0 + index->epsilon);
+    double offset, distance;
+    size_t i;
+
+    if (SPATIAL_NO_CHILD == node->left)
+    {
+        for (i = node->begin; i < node->end; i++)
+        {
+            distance = index->distance(query.elements, index->points[index->order[i]].elements, index->dim);
+            if (distance <= radius && neighbors_push(neighbors, index->order[i], distance) != 0)
+            {
+                return 1;
+            }
+        }
+        return 0;
+    }
+    if (KD_TREE == index->kind)
+    {
+        offset = query.elements[node->pivot] - node->split;
+        if (offset <= reach && radius_node(index, query, radius, neighbors, node->left) != 0)
+        {
+            return 1;
+        }
+        if (offset >= -reach && radius_node(index, query, radius, neighbors, node->right) != 0)
+        {
+            return 1;
+        }
+        return 0;
+    }
+    distance = index->distance(query.elements, index->points[node->pivot].elements, index->dim);
+    if (distance <= radius && neighbors_push(neighbors, node->pivot, distance) != 0)
+    {
+        return 1;
+    }
+    if (distance - reach <= node->split && radius_node(index, query, radius, neighbors, node->left) != 0)
+    {
+        return 1;
+    }
+    if (distance + reach >= node->split && radius_node(index, query, radius, neighbors, node->right) != 0)
+    {
+        return 1;
+    }
+    return 0;
+}
+
+static void knn_task(void *arg, const size_t block)
+{
+    query_job_t *job = (query_job_t *)arg;
+    knn_search_t search;
+    size_t q, i, swap_index, end = (block + 1) * SPATIAL_QUERY_BLOCK;
+    double swap;
+    for (q = block * SPATIAL_QUERY_BLOCK; q < end && q < job->queries_len; q++)
+    {
+        search.query = job->queries[q];
+        search.k = job->k;
+        search.len = 0;
+        search.indices = job->indices + q * job->k;
+        search.distances = job->distances + q * job->k;
+        if (job->index->n > 0)
+        {
+            knn_node(job->index, &search, 0);
+        }
+        /* Heapsort: moving the top to the back leaves the neighbours nearest first */
+        for (i = search.len; i > 1; i--)
+        {
+            swap = search.distances[0];
+            search.distances[0] = search.distances[i - 1];
+            search.distances[i - 1] = swap;
+            swap_index = search.indices[0];
+            search.indices[0] = search.indices[i - 1];
+            search.indices[i - 1] = swap_index;
+            sift_down(search.distances, search.indices, i - 1, 0);
+        }
+        for (i = search.len; i < job->k; i++)
+        {
+            search.indices[i] = job->index->n; /* Fewer than k points are indexed */
+            search.distances[i] = DBL_MAX;
+        }
+    }
+}
+
+static void radius_task(void *arg, const size_t block)
+{
+    query_job_t *job = (query_job_t *)arg;
+    size_t q, end = (block + 1) * SPATIAL_QUERY_BLOCK;
+    job->failed[block] = 0;
+    for (q = block * SPATIAL_QUERY_BLOCK; q < end && q < job->queries_len; q++)
+    {
+        if (job->index->n > 0 && radius_node(job->index, job->queries[q], job->radius, &job->results[q], 0) != 0)
+        {
+            job->failed[block] = 1;
+        }
+    }
+}
+
+/*
+ * The k nearest indexed points of every query, nearest first, in row q of the queries_len x k 'indices' and
+ * 'distances'. When k exceeds n the missing slots hold index n and distance DBL_MAX. Returns non-zero on failure.
+ */
+int spatial_knn(spatial_index_t *index, point_t *queries, const size_t queries_len, const size_t k, size_t *indices, double *distances)
+{
+    query_job_t job;
+    memset(&job, 0, sizeof(job));
+    job.index = index;
+    job.queries = queries;
+    job.queries_len = queries_len;
+    job.k = k;
+    job.indices = indices;
+    job.distances = distances;
+    if (0 == k)
+    {
+        return 0;
+    }
+    return parallel_for((queries_len + SPATIAL_QUERY_BLOCK - 1) / SPATIAL_QUERY_BLOCK, knn_task, &job);
+}
+
+/*All indexed points within 'radius' of every query. 'results' holds queries_len entries; free with free_neighbors()*/
+int spatial_radius(spatial_index_t *index, point_t *queries, const size_t queries_len, const double radius, neighbors_t *results)
+{
+    query_job_t job;
+    size_t blocks = (queries_len + SPATIAL_QUERY_BLOCK - 1) / SPATIAL_QUERY_BLOCK, i;
+    int result = 0;
+    memset(&job, 0, sizeof(job));
+    memset(results, 0, queries_len * sizeof(neighbors_t));
+    job.index = index;
+    job.queries = queries;
+    job.queries_len = queries_len;
+    job.radius = radius;
+    job.results = results;
+    job.failed = (int *)calloc(blocks > 0 ? blocks : 1, sizeof(int));
+    if (NULL == job.failed)
+    {
+        return 1;
+    }
+    result = parallel_for(blocks, radius_task, &job);
+    for (i = 0; i < blocks; i++)
+    {
+        result |= job.failed[i];
+    }
+    free(job.failed);
+    if (0 != result)
+    {
+        free_neighbors(queries_len, results);
+    }
+    return result;
+}
+
+void free_neighbors(const size_t queries_len, neighbors_t *results)
+{
+    size_t i;
+    for (i = 0; i < queries_len; i++)
+    {
+        free(results[i].indices);
+        free(results[i].distances);
+        results[i].indices = NULL;
+        results[i].distances = NULL;
+        results[i].len = results[i].capacity = 0;
+    }
+}
+
+void spatial_free(spatial_index_t *index)
+{
+    free(index->order);
+    free(index->nodes);
+    memset(index, 0, sizeof(*index));
+}
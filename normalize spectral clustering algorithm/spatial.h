@@ -0,0 +1,62 @@
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+#include <stdlib.h>
+#include "point.h"
+#include "distance.h"
+
+#define SPATIAL_LEAF_SIZE 16     /* Points scanned directly instead of split further */
+#define SPATIAL_KD_MAX_DIM 10    /* Above this a VP-tree prunes better than axis-aligned splits */
+#define SPATIAL_QUERY_BLOCK 64   /* Queries handled per parallel task */
+#define SPATIAL_NO_CHILD ((size_t)-1)
+
+typedef enum spatial_kind_e
+{
+    KD_TREE = 0,
+    VP_TREE = 1
+} spatial_kind_e;
+
+/*
+ * A node covers order[begin, end). A KD node splits on coordinate 'pivot' at 'split'; a VP node keeps its
+ * vantage point at order[begin] and splits the rest at the median distance 'split' from it.
+ */
+typedef struct spatial_node_t
+{
+    size_t begin;
+    size_t end;
+    size_t left;  /* Below the split, SPATIAL_NO_CHILD for a leaf */
+    size_t right; /* At or above the split */
+    size_t pivot;
+    double split;
+} spatial_node_t;
+
+typedef struct spatial_index_t
+{
+    size_t n;
+    size_t dim;
+    point_t *points; /* Not owned; must outlive the index */
+    distance_fn distance;
+    spatial_kind_e kind;
+    double epsilon; /* 0 is exact; otherwise a branch is skipped unless it may beat the bound by a factor 1 + epsilon */
+    size_t *order;  /* Point indices in tree order */
+    spatial_node_t *nodes;
+    size_t nodes_len;
+    size_t nodes_capacity;
+} spatial_index_t;
+
+/*The neighbours of one radius query, in no particular order*/
+typedef struct neighbors_t
+{
+    size_t len;
+    size_t capacity;
+    size_t *indices;
+    double *distances;
+} neighbors_t;
+
+int spatial_build(spatial_index_t *index, point_t *points, const size_t n, const size_t dim, const double epsilon);
+int spatial_knn(spatial_index_t *index, point_t *queries, const size_t queries_len, const size_t k, size_t *indices, double *distances);
+int spatial_radius(spatial_index_t *index, point_t *queries, const size_t queries_len, const double radius, neighbors_t *results);
+void free_neighbors(const size_t queries_len, neighbors_t *results);
+void spatial_free(spatial_index_t *index);
+
+#endif /* SPATIAL_H */
@@ -0,0 +1,55 @@
+"""Client of `spkmeans serve`. It only needs the standard library, so a request costs a
+connect instead of importing pandas and numpy and recomputing everything."""
+import os
+import socket
+import struct
+import sys
+from typing import List, Optional, Sequence
+
+GOALS = {"wam": 0, "ddg": 1, "lnorm": 2, "jacobi": 3, "spk": 4, "pic": 5}
+ERRORS = {1: "An Error Has Occurred", 2: "Invalid Input"}
+PATH_SOURCE = 0
+INLINE_SOURCE = 1
+
+# Mirrors job_header_t and reply_header_t in server.h
+JOB_HEADER = struct.Struct("@8s6L")
+REPLY_HEADER = struct.Struct("@L")
+
+
+def request(
+    socket_path: str,
+    goal: str,
+    k: int = 0,
+    path: Optional[str] = None,
+    points: Optional[Sequence[Sequence[float]]] = None,
+) -> str:
+    """Sends one job, naming a file the server can read or carrying the points inline."""
+    if points is not None:
+        rows: List[Sequence[float]] = list(points)
+        dim = len(rows[0]) if rows else 0
+        payload = struct.pack(f"@{len(rows) * dim}d", *[v for row in rows for v in row])
+        header = JOB_HEADER.pack(b"SPKMJOB", GOALS[goal], k, INLINE_SOURCE, len(rows), dim, 0)
+    else:
+        payload = os.path.abspath(path).encode()
+        header = JOB_HEADER.pack(b"SPKMJOB", GOALS[goal], k, PATH_SOURCE, 0, 0, len(payload))
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as conn:
+        conn.connect(socket_path)
+        conn.sendall(header + payload)
+        reply = conn.makefile("rb").read()
+    (status,) = REPLY_HEADER.unpack_from(reply)
+    if status != 0:
+        raise RuntimeError(ERRORS.get(status, ERRORS[1]))
+    return reply[REPLY_HEADER.size :].decode()
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 4 or sys.argv[2] not in GOALS:
+        print("Invalid Input!")
+        exit(1)
+    try:
+        sys.stdout.write(
+            request(os.environ["SPKM_SOCKET"], sys.argv[2], int(sys.argv[1]), path=sys.argv[3])
+        )
+    except (RuntimeError, OSError, KeyError, ValueError) as error:
+        print(error if isinstance(error, RuntimeError) else ERRORS[1])
+        exit(1)
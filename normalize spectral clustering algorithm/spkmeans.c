@@ -13,6 +13,18 @@
 #include "matrix.h"
 #include "jacobi.h"
 #include "kmeans.h"
+#include "cache.h"
+#include "options.h"
+#include "solver.h"
+#include "server.h"
+#include "batch.h"
+#include "sparse.h"
+#include "alloc.h"
+#include "operator.h"
+#include "pipeline.h"
+#include "dedup.h"
+#include "compress.h"
+#include "pic.h"
 
 int weighted_adjacency_matrix(const size_t n, double **weight_mat, double **points, const size_t dim)
 {
@@ -55,8 +67,19 @@ int normalized_graph_laplacian(const size_t n, double **n_mat, double **w_mat, d
     return create_normalized_laplacian_matrix(n, l_mat, n_mat);
 }
 
-int calc_eigen_values_vectors(const size_t n, double **l_mat, double *values, double **vectors)
+/*Maps a solver's return value onto error_e; a run cut short by its deadline still produced eigenpairs*/
+static error_e solver_status(const int status)
 {
+    if (0 == status)
+    {
+        return OK;
+    }
+    return DEADLINE_STOPPED(status) ? (error_e)status : MALLOC_ERROR;
+}
+
+int calc_eigen_values_vectors(const size_t n, double **l_mat, double *values, double **vectors, deadline_t *deadline)
+{
+    error_e result;
     eigen_t *eigens;
     size_t i, j;
 
@@ -66,7 +89,7 @@ int calc_eigen_values_vectors(const size_t n, double **l_mat, double *values, do
     {
         return MALLOC_ERROR;
     }
-    jacobi(n, l_mat, eigens);
+    result = solver_status(solve_jacobi_goal(n, l_mat, eigens, deadline));
     for (i = 0; i < n; i++)
     {
         values[i] = eigens[i].value;
@@ -77,29 +100,69 @@ int calc_eigen_values_vectors(const size_t n, double **l_mat, double *values, do
     }
 
     free_eigens(n, eigens);
-    return OK;
+    return result;
 }
 
-int kmeans(point_t *points, const size_t points_len, point_t *clusters, const size_t k, const size_t max_iter, const size_t dim, const float epsilon)
+int kmeans(point_t *points, const size_t points_len, point_t *clusters, const size_t k, const size_t max_iter, const size_t dim, const float epsilon, deadline_t *deadline)
 {
     int result;
-    result = fit(points, points_len, clusters, k, max_iter, dim, epsilon);
+    result = fit_until(points, points_len, clusters, k, max_iter, dim, epsilon, NULL, deadline);
     return result;
 }
 
-error_e calc_matrix(const size_t n, point_t *points, const size_t dim, goal_e goal, double **mat, size_t *k)
+/*W in full, or from the affinities above SPKM_AFFINITY_THRESHOLD when one is set*/
+error_e calc_weight_matrix(const size_t n, point_t *points, const size_t dim, double **w_mat)
+{
+    options_t options;
+    sparse_t w;
+    load_options(&options);
+    if (options.affinity_threshold <= .0)
+    {
+        return create_weight_matrix(n, w_mat, points, dim);
+    }
+    if (create_weight_sparse(n, &w, points, dim, options.affinity_threshold, options.index_epsilon) != 0)
+    {
+        return MALLOC_ERROR;
+    }
+    sparse_to_dense(&w, w_mat);
+    free_sparse(&w);
+    return OK;
+}
+
+/*
+ * The diagonal of D without W: affinities are evaluated a row at a time and only summed, so besides the points
+ * this takes O(n) memory where the ddg goal through calc_matrix() takes three n*n matrices.
+ */
+error_e calc_degrees(const size_t n, point_t *points, const size_t dim, double *degrees)
+{
+    options_t options;
+    sparse_t w;
+    load_options(&options);
+    if (options.affinity_threshold <= .0)
+    {
+        return create_degree_vector(n, degrees, points, dim) == 0 ? OK : MALLOC_ERROR;
+    }
+    if (create_weight_sparse(n, &w, points, dim, options.affinity_threshold, options.index_epsilon) != 0)
+    {
+        return MALLOC_ERROR;
+    }
+    sparse_degrees(&w, degrees);
+    free_sparse(&w);
+    return OK;
+}
+
+/*Runs the graph stages of the pipeline (W, D, L_norm) and copies the matrix of the requested goal into 'mat'*/
+static error_e calc_graph_matrix(const size_t n, point_t *points, const size_t dim, goal_e goal, double **mat)
 {
     error_e result;
-    double **w_mat, **d_mat, **l_mat, **n_mat, **u_mat, **t_mat;
-    eigen_t *eigens;
-    size_t i;
+    double **w_mat, **d_mat, **l_mat, **n_mat;
     w_mat = (double **)malloc_matrix(n, n, sizeof(double));
     if (NULL == w_mat)
     {
         result = MALLOC_ERROR;
         goto end;
     }
-    result = create_weight_matrix(n, w_mat, points, dim);
+    result = calc_weight_matrix(n, points, dim, w_mat);
     if (result != OK)
     {
         goto w_cleanup;
@@ -154,24 +217,83 @@ error_e calc_matrix(const size_t n, point_t *points, const size_t dim, goal_e go
     {
         goto n_cleanup;
     }
-    if (NORMALIZED_GRAPH_LAPLACIAN == goal)
+    copy_matrix(n, n_mat, mat);
+
+n_cleanup:
+    free_matrix(n, (void **)n_mat);
+l_cleanup:
+    free_matrix(n, (void **)l_mat);
+d_cleanup:
+    free_matrix(n, (void **)d_mat);
+w_cleanup:
+    free_matrix(n, (void **)w_mat);
+end:
+    return result;
+}
+
+/*
+ * Computes the eigenpairs of L_norm sorted as in section 1.3, reusing the on-disk cache when it is enabled.
+ * With k == NULL all n eigenvectors are computed. Otherwise *k is chosen by the eigengap when it is 0 and only
+ * the first *k eigenvectors are guaranteed, which lets the backend skip the rest unless the result is cached.
+ * Eigenpairs cut short by 'deadline' are returned with its status and are never cached.
+ */
+error_e calc_sorted_eigens(const size_t n, point_t *points, const size_t dim, eigen_t *eigens, size_t *k, deadline_t *deadline)
+{
+    error_e result = OK;
+    options_t options;
+    unsigned long key = 0;
+    double **n_mat;
+
+    load_options(&options);
+    if (NULL != options.cache_dir)
     {
-        copy_matrix(n, n_mat, mat);
-        goto n_cleanup;
+        key = cache_key(n, points, dim, &options);
+        if (cache_load(options.cache_dir, key, n, dim, eigens) == 0)
+        {
+            goto choose_k;
+        }
     }
 
-    /* if (NORMALIZED_EIGEN_MATRIX == goal) */
-
-    eigens = malloc_eigens(n);
-    if (NULL == eigens)
+    n_mat = (double **)malloc_matrix(n, n, sizeof(double));
+    if (NULL == n_mat)
     {
-        result = MALLOC_ERROR;
-        goto n_cleanup;
+        return MALLOC_ERROR;
+    }
+    result = calc_graph_matrix(n, points, dim, NORMALIZED_GRAPH_LAPLACIAN, n_mat);
+    if (OK == result)
+    {
+        if (NULL != k && NULL == options.cache_dir)
+        {
+            result = solver_status(solve_top_eigens(n, n_mat, eigens, k, deadline));
+        }
+        else
+        {
+            result = solver_status(solve_eigens(n, n_mat, eigens, deadline));
+            qsort(eigens, n, sizeof(eigen_t), compare_eigenvalues);
+            if (OK == result && NULL != options.cache_dir)
+            {
+                cache_store(options.cache_dir, key, n, dim, eigens); /* A failed store only costs the next run a recomputation */
+            }
+        }
+    }
+    free_matrix(n, (void **)n_mat);
+    if (OK != result && !DEADLINE_STOPPED(result))
+    {
+        return result;
     }
 
-    jacobi(n, n_mat, eigens);
-    qsort(eigens, n, sizeof(eigen_t), compare_eigenvalues);
+choose_k:
+    if (NULL != k && 0 == *k)
+    {
+        *k = find_eigengap_max(n, eigens);
+    }
+    return result;
+}
 
+/*Builds the row-normalized n*k matrix T from the sorted eigenvectors, choosing k by the eigengap when it is 0*/
+error_e embed_eigens(const size_t n, eigen_t *eigens, size_t *k, double **mat)
+{
+    double **u_mat;
     if (0 == *k)
     {
         *k = find_eigengap_max(n, eigens);
@@ -180,48 +302,206 @@ error_e calc_matrix(const size_t n, point_t *points, const size_t dim, goal_e go
     u_mat = (double **)malloc_matrix(n, *k, sizeof(double));
     if (NULL == u_mat)
     {
-        result = MALLOC_ERROR;
-        goto eigen_vectors_cleanup;
+        return MALLOC_ERROR;
     }
     build_matrix_from_eigens(n, *k, eigens, u_mat);
-    t_mat = (double **)malloc_matrix(n, *k, sizeof(double));
-    if (NULL == t_mat)
+    normalize_matrix(n, *k, mat, u_mat);
+
+    free_matrix(n, (void **)u_mat);
+    return OK;
+}
+
+/*
+ * The embedding of the k largest eigenvectors without any n*n matrix: L_norm is only applied, from the points,
+ * and only k eigenvectors are kept. Used by SPKM_EIGEN_SOLVER=matrix-free when k is given, the eigen cache is
+ * off and W is dense, since the eigengap, the cache and the sparse W all need more than the operator offers.
+ * With SPKM_COMPRESS the products read a compressed W, thresholded by SPKM_AFFINITY_THRESHOLD, built once.
+ */
+static error_e calc_matrix_free(const size_t n, point_t *points, const size_t dim, double **mat, size_t *k, deadline_t *deadline)
+{
+    error_e result, embedded;
+    options_t options;
+    lnorm_operator_t op;
+    compressed_graph_t graph;
+    eigen_t *eigens;
+    size_t i;
+    int initialized;
+
+    load_options(&options);
+    eigens = (eigen_t *)malloc(*k * sizeof(eigen_t));
+    if (NULL == eigens)
+    {
+        return MALLOC_ERROR;
+    }
+    for (i = 0; i < *k; i++)
+    {
+        eigens[i].vector = (double *)malloc(n * sizeof(double));
+        if (NULL == eigens[i].vector)
+        {
+            free_eigens(i, eigens); /* The vectors allocated so far */
+            return MALLOC_ERROR;
+        }
+    }
+    if (NO_COMPRESSION != options.compress)
+    {
+        if (compress_graph(&graph, n, points, dim, options.affinity_threshold, options.compress) != 0)
+        {
+            result = MALLOC_ERROR;
+            goto eigens_cleanup;
+        }
+        initialized = lnorm_operator_init_compressed(&op, &graph);
+    }
+    else
+    {
+        initialized = lnorm_operator_init(&op, n, points, dim);
+    }
+    if (initialized != 0)
     {
         result = MALLOC_ERROR;
-        goto u_cleanup;
+        goto graph_cleanup;
+    }
+    result = solver_status(lnorm_operator_eigens(&op, eigens, *k, options.oversample, deadline));
+    if (OK == result || DEADLINE_STOPPED(result))
+    {
+        embedded = embed_eigens(n, eigens, k, mat);
+        result = OK == embedded ? result : embedded;
     }
 
-    normalize_matrix(n, *k, t_mat, u_mat);
-    copy_matrix(n, t_mat, mat);
+    lnorm_operator_free(&op);
+graph_cleanup:
+    if (NO_COMPRESSION != options.compress)
+    {
+        free_compressed(&graph);
+    }
+eigens_cleanup:
+    free_eigens(*k, eigens);
+    return result;
+}
 
-    free_matrix(n, (void **)t_mat);
-u_cleanup:
-    free_matrix(n, (void **)u_mat);
-eigen_vectors_cleanup:
-    for (i = 0; i < n; i++)
+/*
+ * spk on the groups of equal points found by SPKM_DEDUP: W and the eigenproblem are only as large as the number
+ * of groups, and every row gets its group's row of T. The eigenpairs of the full L_norm that are not constant on
+ * a group (1 + 1 / d for each group of degree d) are left out, so equal points always share their embedding.
+ */
+static error_e calc_collapsed(dedup_t *dedup, const size_t dim, double **mat, size_t *k, deadline_t *deadline)
+{
+    error_e result, embedded;
+    const size_t m = dedup->unique_len;
+    double **w_mat, **n_mat, **reduced;
+    eigen_t *eigens;
+
+    w_mat = (double **)malloc_matrix(m, m, sizeof(double));
+    n_mat = (double **)malloc_matrix(m, m, sizeof(double));
+    if (NULL == w_mat || NULL == n_mat)
+    {
+        result = MALLOC_ERROR;
+        goto w_cleanup;
+    }
+    result = calc_weight_matrix(m, dedup->points, dim, w_mat);
+    if (OK != result)
+    {
+        goto w_cleanup;
+    }
+    if (create_collapsed_laplacian(m, w_mat, dedup->weights, n_mat) != 0)
+    {
+        result = MALLOC_ERROR;
+        goto w_cleanup;
+    }
+    free_matrix(m, (void **)w_mat);
+    w_mat = NULL;
+
+    eigens = malloc_eigens(m);
+    if (NULL == eigens)
+    {
+        result = MALLOC_ERROR;
+        goto w_cleanup;
+    }
+    result = solver_status(solve_top_eigens(m, n_mat, eigens, k, deadline));
+    if (OK == result || DEADLINE_STOPPED(result))
     {
-        if (NULL != eigens[i].vector)
+        reduced = (double **)malloc_matrix(m, *k, sizeof(double));
+        embedded = NULL == reduced ? MALLOC_ERROR : embed_eigens(m, eigens, k, reduced);
+        if (OK == embedded)
         {
-            free(eigens[i].vector);
+            dedup_expand_rows(dedup, *k, reduced, mat);
+        }
+        result = OK == embedded ? result : embedded;
+        if (NULL != reduced)
+        {
+            free_matrix(m, (void **)reduced);
         }
     }
-    free(eigens);
+    free_eigens(m, eigens);
 
-n_cleanup:
-    free_matrix(n, (void **)n_mat);
-l_cleanup:
-    free_matrix(n, (void **)l_mat);
-d_cleanup:
-    free_matrix(n, (void **)d_mat);
 w_cleanup:
-    free_matrix(n, (void **)w_mat);
-end:
+    if (NULL != w_mat)
+    {
+        free_matrix(m, (void **)w_mat);
+    }
+    if (NULL != n_mat)
+    {
+        free_matrix(m, (void **)n_mat);
+    }
+    return result;
+}
+
+error_e calc_matrix(const size_t n, point_t *points, const size_t dim, goal_e goal, double **mat, size_t *k, deadline_t *deadline)
+{
+    dedup_t dedup;
+    int collapsed;
+    error_e result, embedded;
+    eigen_t *eigens;
+    options_t options;
+    if (POWER_ITERATION_EMBEDDING == goal)
+    {
+        return pic_embedding(n, points, dim, mat, k, deadline);
+    }
+    if (NORMALIZED_EIGEN_MATRIX != goal)
+    {
+        return calc_graph_matrix(n, points, dim, goal, mat);
+    }
+    load_options(&options);
+    if (options.dedup)
+    {
+        if (dedup_points(points, n, dim, options.dedup_quantum, &dedup) != 0)
+        {
+            return MALLOC_ERROR;
+        }
+        collapsed = dedup.unique_len < n && *k <= dedup.unique_len; /* Without duplicates the output stays the reference one */
+        if (collapsed)
+        {
+            result = calc_collapsed(&dedup, dim, mat, k, deadline);
+        }
+        dedup_free(&dedup);
+        if (collapsed)
+        {
+            return result;
+        }
+    }
+    if ((NO_COMPRESSION != options.compress || (MATRIX_FREE_SOLVER == options.eigen_solver && options.affinity_threshold <= .0)) &&
+        *k > 0 && *k <= n && NULL == options.cache_dir)
+    {
+        return calc_matrix_free(n, points, dim, mat, k, deadline);
+    }
+
+    eigens = malloc_eigens(n);
+    if (NULL == eigens)
+    {
+        return MALLOC_ERROR;
+    }
+    result = calc_sorted_eigens(n, points, dim, eigens, k, deadline);
+    if (OK == result || DEADLINE_STOPPED(result))
+    {
+        embedded = embed_eigens(n, eigens, k, mat);
+        result = OK == embedded ? result : embedded;
+    }
+    free_eigens(n, eigens);
     return result;
 }
 
-int create_eigen_matrix(const size_t n, double **l_mat, eigen_t *eigens)
+error_e create_eigen_matrix(const size_t n, double **l_mat, eigen_t *eigens, deadline_t *deadline)
 {
-    return jacobi(n, l_mat, eigens);
+    return solver_status(solve_jacobi_goal(n, l_mat, eigens, deadline));
 }
 
 goal_e get_goal(char *goal_str)
@@ -246,12 +526,50 @@ goal_e get_goal(char *goal_str)
     {
         return NORMALIZED_EIGEN_MATRIX;
     }
+    else if (strcmp(goal_str, "pic") == 0)
+    {
+        return POWER_ITERATION_EMBEDDING;
+    }
     else
     {
         return UNKNOWN_GOAL;
     }
 }
 
+/*The ddg goal of the CLI, printed from the degree vector alone*/
+static error_e print_degree_goal(char *filename, const size_t n, const size_t dim)
+{
+    error_e result;
+    point_t *points;
+    double *degrees;
+    points = malloc_points(n, dim);
+    if (NULL == points)
+    {
+        return MALLOC_ERROR;
+    }
+    if (read_points(filename, points, n, dim) != OK)
+    {
+        result = INVALID_INPUT;
+        goto points_cleanup;
+    }
+    degrees = (double *)malloc(n * sizeof(double));
+    if (NULL == degrees)
+    {
+        result = MALLOC_ERROR;
+        goto points_cleanup;
+    }
+    result = calc_degrees(n, points, dim, degrees);
+    if (OK == result)
+    {
+        fprint_diagonal(stdout, n, degrees);
+    }
+
+    free(degrees);
+points_cleanup:
+    free_points(n, points);
+    return result;
+}
+
 int main(int argc, char **argv)
 {
     error_e result;
@@ -260,6 +578,8 @@ int main(int argc, char **argv)
     size_t n, i, dim, k;
     double **mat;
     eigen_t *eigens;
+    options_t options;
+    deadline_t deadline;
 
     k = 0;
     result = OK;
@@ -268,6 +588,17 @@ int main(int argc, char **argv)
         result = INVALID_INPUT;
         goto end;
     }
+    if (strcmp(argv[1], SERVE_COMMAND) == 0)
+    {
+        result = serve(argv[2]) == 0 ? OK : MALLOC_ERROR;
+        goto end;
+    }
+    if (strcmp(argv[1], BATCH_COMMAND) == 0)
+    {
+        load_options(&options);
+        result = run_manifest(argv[2]);
+        goto end;
+    }
     goal = get_goal(argv[1]);
 
     if (UNKNOWN_GOAL == goal)
@@ -275,6 +606,13 @@ int main(int argc, char **argv)
         result = INVALID_INPUT;
         goto end;
     }
+    load_options(&options);
+    deadline_start(&deadline, options.time_budget / 1000.0);
+    if (NULL != options.socket_path)
+    {
+        result = request_job(options.socket_path, goal, k, argv[2], stdout);
+        goto end;
+    }
     n = get_lines_count(argv[2]);
     if (0 == n)
     {
@@ -288,7 +626,18 @@ int main(int argc, char **argv)
         goto end;
     }
 
-    mat = (double **)malloc_matrix(n, n, sizeof(double));
+    if (DIAGONAL_DEGREE_MATRIX == goal)
+    {
+        result = print_degree_goal(argv[2], n, dim);
+        goto end;
+    }
+    if (pipeline_supported(goal, dim))
+    {
+        result = pipeline_graph(argv[2], n, dim, goal, stdout);
+        goto end;
+    }
+
+    mat = (double **)malloc_matrix(n, POWER_ITERATION_EMBEDDING == goal ? pic_columns(n) : n, sizeof(double)); /* pic stays O(n) */
     if (NULL == mat)
     {
         result = MALLOC_ERROR;
@@ -310,10 +659,10 @@ int main(int argc, char **argv)
             goto points_cleanup;
         }
 
-        result = calc_matrix(n, points, dim, goal, mat, &k);
-        if (OK == result)
+        result = calc_matrix(n, points, dim, goal, mat, &k, &deadline);
+        if (OK == result || DEADLINE_STOPPED(result))
         {
-            print_matrix(n, n, mat);
+            print_matrix(n, NORMALIZED_EIGEN_MATRIX == goal || POWER_ITERATION_EMBEDDING == goal ? k : n, mat);
         }
 
     points_cleanup:
@@ -334,8 +683,8 @@ int main(int argc, char **argv)
             goto mat_cleanup;
         }
 
-        result = create_eigen_matrix(n, mat, eigens);
-        if (OK == result)
+        result = create_eigen_matrix(n, mat, eigens, &deadline);
+        if (OK == result || DEADLINE_STOPPED(result))
         {
             print_eigen(n, eigens);
         }
@@ -349,6 +698,10 @@ int main(int argc, char **argv)
 
 mat_cleanup:
     free_matrix(n, (void **)mat);
+    if (options.alloc_stats)
+    {
+        print_alloc_stats(stderr);
+    }
 end:
     if (INVALID_INPUT == result)
     {
@@ -358,5 +711,9 @@ end:
     {
         printf("An Error Has Occurred\n");
     }
+    else if (TIMED_OUT == result)
+    {
+        fprintf(stderr, "Stopped at the time budget of %g ms; the output has not converged\n", options.time_budget);
+    }
     return result;
 }
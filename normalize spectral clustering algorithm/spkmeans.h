@@ -3,6 +3,8 @@
 
 #include <stdlib.h>
 #include "point.h"
+#include "eigen.h"
+#include "deadline.h"
 
 typedef enum goal_e
 {
@@ -11,22 +13,30 @@ typedef enum goal_e
     DIAGONAL_DEGREE_MATRIX = 1,
     NORMALIZED_GRAPH_LAPLACIAN = 2,
     JACOBI = 3,
-    NORMALIZED_EIGEN_MATRIX = 4
+    NORMALIZED_EIGEN_MATRIX = 4,
+    POWER_ITERATION_EMBEDDING = 5 /* The pic goal: a few power iteration vectors in place of the eigenvectors */
 } goal_e;
 
 typedef enum error_e
 {
     OK = 0,
     MALLOC_ERROR = 1,
-    INVALID_INPUT = 2
+    INVALID_INPUT = 2,
+    TIMED_OUT = DEADLINE_TIMED_OUT, /* The result is the best one reached within the time budget */
+    CANCELLED = DEADLINE_CANCELLED
 } error_e;
 
 int weighted_adjacency_matrix(const size_t n, double **weight_mat, double **points, const size_t dim);
 int diagonal_degree_matrix(const size_t n, double **d_mat, double **weigth_mat);
 int normalized_graph_laplacian(const size_t n, double **n_mat, double **w_mat, double **d_mat);
-int calc_eigen_values_vectors(const size_t n, double **l_mat, double *values, double **vectors);
+int calc_eigen_values_vectors(const size_t n, double **l_mat, double *values, double **vectors, deadline_t *deadline);
 
-error_e calc_matrix(const size_t n, point_t *points, const size_t dim, goal_e goal, double **mat, size_t *k);
-int kmeans(point_t *points, const size_t points_len, point_t *clusters, const size_t k, const size_t max_iter, const size_t dim, const float epsilon);
+goal_e get_goal(char *goal_str);
+error_e calc_sorted_eigens(const size_t n, point_t *points, const size_t dim, eigen_t *eigens, size_t *k, deadline_t *deadline);
+error_e embed_eigens(const size_t n, eigen_t *eigens, size_t *k, double **mat);
+error_e calc_weight_matrix(const size_t n, point_t *points, const size_t dim, double **w_mat);
+error_e calc_degrees(const size_t n, point_t *points, const size_t dim, double *degrees);
+error_e calc_matrix(const size_t n, point_t *points, const size_t dim, goal_e goal, double **mat, size_t *k, deadline_t *deadline);
+int kmeans(point_t *points, const size_t points_len, point_t *clusters, const size_t k, const size_t max_iter, const size_t dim, const float epsilon, deadline_t *deadline);
 
 #endif /* SPKMEANS_H */
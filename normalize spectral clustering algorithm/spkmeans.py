@@ -17,6 +17,7 @@ class Goal(Enum):
     NORMALIZED_GRAPH_LAPLACIAN = "lnorm"
     JACOBI = "jacobi"
     SPKMEANS = "spk"
+    POWER_ITERATION = "pic"
 
     def __str__(self) -> str:
         return self.value
@@ -106,8 +107,14 @@ if __name__ == "__main__":
             result = spkm.ddg(points, args.k)
         elif args.goal == Goal.NORMALIZED_GRAPH_LAPLACIAN:
             result = spkm.lnorm(points, args.k)
-        elif args.goal == Goal.SPKMEANS:
-            result = spkm.spk(points, args.k)
+        elif args.goal in (Goal.SPKMEANS, Goal.POWER_ITERATION):
+            if args.goal == Goal.SPKMEANS:
+                result = spkm.spk(points, args.k)
+            elif args.k > 0:
+                result = spkm.pic(points, args.k)
+            else:
+                print("Invalid Input!")  # pic has no eigengap to choose k by
+                exit(1)
             k = args.k if args.k != 0 else len(result[0])
             df = pd.DataFrame(result)
             res = kmeanspp(df, k)
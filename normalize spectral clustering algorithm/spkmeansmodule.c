@@ -4,6 +4,87 @@
 
 #include "spkmeans.h"
 #include "debug.h"
+#include "sweep.h"
+#include "kmeans.h"
+#include "incremental.h"
+#include "model.h"
+#include "deadline.h"
+#include "alloc.h"
+#include "graph.h"
+#include "compress.h"
+#include "batch.h"
+#include "bisect.h"
+#include "pic.h"
+#include "spatial.h"
+
+typedef struct
+{
+    PyObject_HEAD
+    deadline_t deadline;
+} DeadlineObject;
+
+static PyTypeObject DeadlineType = {
+    PyVarObject_HEAD_INIT(NULL, 0)};
+
+static int Deadline_init(DeadlineObject *self, PyObject *args, PyObject *kwds)
+{
+    double budget = .0;
+    if (!PyArg_ParseTuple(args, "|d", &budget))
+    {
+        return -1;
+    }
+    deadline_start(&self->deadline, budget);
+    return 0;
+}
+
+static PyObject *Deadline_cancel(DeadlineObject *self, PyObject *Py_UNUSED(ignored))
+{
+    deadline_cancel(&self->deadline);
+    Py_RETURN_NONE;
+}
+
+static PyObject *Deadline_stopped(DeadlineObject *self, PyObject *Py_UNUSED(ignored))
+{
+    if (DEADLINE_TIMED_OUT == self->deadline.stopped)
+    {
+        return PyUnicode_FromString("timed out");
+    }
+    if (DEADLINE_CANCELLED == self->deadline.stopped)
+    {
+        return PyUnicode_FromString("cancelled");
+    }
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef DeadlineMethods[] =
+    {
+        {"cancel",
+         (PyCFunction)Deadline_cancel,
+         METH_NOARGS,
+         PyDoc_STR("cancel(). Stops the computations using this deadline at their next sweep or iteration; safe from another thread.")},
+        {"stopped",
+         (PyCFunction)Deadline_stopped,
+         METH_NOARGS,
+         PyDoc_STR("stopped() -> None if every computation so far converged, else 'timed out' or 'cancelled'.")},
+        {NULL, NULL, 0, NULL},
+};
+
+/*The deadline_t of an optional Deadline argument: NULL for a missing or None argument, and a TypeError otherwise*/
+static int deadline_from_py(PyObject *obj, deadline_t **deadline)
+{
+    *deadline = NULL;
+    if (NULL == obj || Py_None == obj)
+    {
+        return 0;
+    }
+    if (!PyObject_TypeCheck(obj, &DeadlineType))
+    {
+        PyErr_SetString(PyExc_TypeError, "expected a spkm.Deadline");
+        return -1;
+    }
+    *deadline = &((DeadlineObject *)obj)->deadline;
+    return 0;
+}
 
 static double **malloc_matrix(const size_t n, const size_t dim)
 {
@@ -103,11 +184,12 @@ PyObject *create_py_matrix(const size_t n, const size_t k, double **mat)
 static PyObject *calc(PyObject *self, PyObject *args, goal_e goal)
 {
     error_e result = OK;
-    PyObject *data_points = NULL, *result_obj = NULL;
+    PyObject *data_points = NULL, *deadline_obj = NULL, *result_obj = NULL;
     size_t dim, points_len, k;
     double **mat;
     point_t *points;
-    if (!PyArg_ParseTuple(args, "Ol", &data_points, &k))
+    deadline_t *deadline;
+    if (!PyArg_ParseTuple(args, "Ol|O", &data_points, &k, &deadline_obj) || deadline_from_py(deadline_obj, &deadline) != 0)
     {
         return NULL;
     }
@@ -119,15 +201,21 @@ static PyObject *calc(PyObject *self, PyObject *args, goal_e goal)
         return NULL;
     }
     parse_points(data_points, points, points_len, dim);
-    mat = malloc_matrix(points_len, points_len);
+    if (POWER_ITERATION_EMBEDDING == goal)
+    {
+        k = pic_columns(points_len);
+    }
+    mat = malloc_matrix(points_len, (NORMALIZED_EIGEN_MATRIX == goal || POWER_ITERATION_EMBEDDING == goal) && k > 0 && k <= points_len ? k : points_len); /* spk and pic fill k columns */
     if (NULL == mat)
     {
         result = MALLOC_ERROR;
         goto cleanup_points;
     }
-    result = calc_matrix(points_len, points, dim, goal, mat, &k);
+    Py_BEGIN_ALLOW_THREADS
+    result = calc_matrix(points_len, points, dim, goal, mat, &k, deadline);
+    Py_END_ALLOW_THREADS
 
-    if (NORMALIZED_EIGEN_MATRIX == goal)
+    if (NORMALIZED_EIGEN_MATRIX == goal || POWER_ITERATION_EMBEDDING == goal)
     {
         result_obj = create_py_matrix(points_len, k, mat);
     }
@@ -139,7 +227,7 @@ static PyObject *calc(PyObject *self, PyObject *args, goal_e goal)
     free_matrix(points_len, mat);
 cleanup_points:
     free_points(points_len, points);
-    if (result != OK)
+    if (result != OK && !DEADLINE_STOPPED(result))
     {
         Py_RETURN_NONE;
     }
@@ -166,16 +254,22 @@ static PyObject *calc_spk(PyObject *self, PyObject *args)
     return calc(self, args, NORMALIZED_EIGEN_MATRIX);
 }
 
+static PyObject *calc_pic(PyObject *self, PyObject *args)
+{
+    return calc(self, args, POWER_ITERATION_EMBEDDING);
+}
+
 static PyObject *kmeans_fit(PyObject *self, PyObject *args)
 {
 
-    PyObject *centroids, *data_points = NULL, *result = NULL;
+    PyObject *centroids, *data_points = NULL, *deadline_obj = NULL, *result = NULL;
     point_t *points, *clusters;
     size_t dim, k, points_len, max_iter;
     float epsilon;
     int fit_result = 1;
+    deadline_t *deadline;
     /* Parse arguments */
-    if (!PyArg_ParseTuple(args, "OOnf", &centroids, &data_points, &max_iter, &epsilon))
+    if (!PyArg_ParseTuple(args, "OOnf|O", &centroids, &data_points, &max_iter, &epsilon, &deadline_obj) || deadline_from_py(deadline_obj, &deadline) != 0)
     {
         return NULL;
     }
@@ -195,8 +289,10 @@ static PyObject *kmeans_fit(PyObject *self, PyObject *args)
         goto points_free;
     }
     parse_points(centroids, clusters, k, dim);
-    fit_result = kmeans(points, points_len, clusters, k, max_iter, dim, epsilon);
-    if (0 == fit_result)
+    Py_BEGIN_ALLOW_THREADS
+    fit_result = kmeans(points, points_len, clusters, k, max_iter, dim, epsilon, deadline);
+    Py_END_ALLOW_THREADS
+    if (0 == fit_result || DEADLINE_STOPPED(fit_result))
     {
         result = create_result(clusters, k, dim);
     }
@@ -204,7 +300,7 @@ static PyObject *kmeans_fit(PyObject *self, PyObject *args)
 points_free:
     free_points(points_len, points);
 end:
-    if (OK != fit_result)
+    if (NULL == result)
     {
         Py_RETURN_NONE;
     }
@@ -215,11 +311,12 @@ end:
 }
 static PyObject *calc_jacobi(PyObject *self, PyObject *args)
 {
-    PyObject *in_mat = NULL, *out_values = NULL, *out_vectors = NULL;
+    PyObject *in_mat = NULL, *deadline_obj = NULL, *out_values = NULL, *out_vectors = NULL;
     size_t dim;
     double **mat, *values, **vectors;
     size_t i;
-    if (!PyArg_ParseTuple(args, "O", &in_mat))
+    deadline_t *deadline;
+    if (!PyArg_ParseTuple(args, "O|O", &in_mat, &deadline_obj) || deadline_from_py(deadline_obj, &deadline) != 0)
     {
         return NULL;
     }
@@ -230,7 +327,9 @@ static PyObject *calc_jacobi(PyObject *self, PyObject *args)
 
     values = (double *)malloc(dim * sizeof(double));
     vectors = malloc_matrix(dim, dim);
-    calc_eigen_values_vectors(dim, mat, values, vectors);
+    Py_BEGIN_ALLOW_THREADS
+    calc_eigen_values_vectors(dim, mat, values, vectors, deadline);
+    Py_END_ALLOW_THREADS
     out_values = PyList_New(dim);
     for (i = 0; i < dim; i++)
     {
@@ -241,51 +340,1266 @@ static PyObject *calc_jacobi(PyObject *self, PyObject *args)
     return PyTuple_Pack(2, out_values, out_vectors);
 }
 
-static PyMethodDef spkmeansMethods[] =
+PyObject *create_py_labels(const size_t n, size_t *labels)
+{
+    PyObject *result = PyList_New(n);
+    size_t i;
+    for (i = 0; i < n; ++i)
     {
+        PyList_SetItem(result, i, PyLong_FromSize_t(labels[i]));
+    }
+    return result;
+}
 
-        {"wam",
-         calc_wam,
-         METH_VARARGS,
-         PyDoc_STR("Calculate Weighted Adjacency Matrix.")},
-        {"ddg",
-         calc_ddg,
-         METH_VARARGS,
-         PyDoc_STR("Calculate Diagonal Degree Graph.")},
-        {"lnorm",
-         calc_lnorm,
-         METH_VARARGS,
-         PyDoc_STR("Calculate Normalized Graph Laplacian.")},
-        {"jacobi",
-         calc_jacobi,
+static PyObject *calc_spk_sweep(PyObject *self, PyObject *args)
+{
+    PyObject *data_points = NULL, *runs = NULL, *result = NULL;
+    point_t *points;
+    sweep_result_t *sweep;
+    size_t dim, points_len, k_min, k_max, max_iter, eigengap_k, i;
+    unsigned long seed = 0;
+    float epsilon;
+    error_e sweep_result;
+    if (!PyArg_ParseTuple(args, "Onnnf|k", &data_points, &k_min, &k_max, &max_iter, &epsilon, &seed))
+    {
+        return NULL;
+    }
+    if (k_min > k_max)
+    {
+        Py_RETURN_NONE;
+    }
+    dim = get_dim(data_points);
+    points_len = PyObject_Length(data_points);
+    points = malloc_points(points_len, dim);
+    if (NULL == points)
+    {
+        return PyErr_NoMemory();
+    }
+    parse_points(data_points, points, points_len, dim);
+    sweep = (sweep_result_t *)malloc((k_max - k_min + 1) * sizeof(sweep_result_t));
+    if (NULL == sweep)
+    {
+        free_points(points_len, points);
+        return PyErr_NoMemory();
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    sweep_result = spk_sweep(points_len, points, dim, k_min, k_max, max_iter, epsilon, seed, sweep, &eigengap_k);
+    Py_END_ALLOW_THREADS
+
+    if (OK == sweep_result)
+    {
+        runs = PyList_New(k_max - k_min + 1);
+        for (i = 0; i <= k_max - k_min; i++)
+        {
+            PyList_SetItem(runs, i, Py_BuildValue("nNNd", sweep[i].k, create_result(sweep[i].centroids, sweep[i].k, sweep[i].k), create_py_labels(points_len, sweep[i].labels), sweep[i].inertia));
+        }
+        result = Py_BuildValue("nN", eigengap_k, runs);
+    }
+    if (INVALID_INPUT != sweep_result)
+    {
+        free_sweep_results(k_max - k_min + 1, sweep);
+    }
+    free(sweep);
+    free_points(points_len, points);
+    if (NULL == result)
+    {
+        Py_RETURN_NONE;
+    }
+    return result;
+}
+
+static PyObject *kmeans_restarts(PyObject *self, PyObject *args)
+{
+    PyObject *data_points = NULL, *deadline_obj = NULL, *runs_obj, *result = NULL;
+    point_t *points, *clusters;
+    restart_stats_t *runs;
+    size_t *labels;
+    size_t dim, k, points_len, restarts, max_iter, best, i;
+    unsigned long seed = 0;
+    float epsilon;
+    int fit_result = MALLOC_ERROR;
+    deadline_t *deadline;
+    if (!PyArg_ParseTuple(args, "Onnnf|kO", &data_points, &k, &restarts, &max_iter, &epsilon, &seed, &deadline_obj) || deadline_from_py(deadline_obj, &deadline) != 0)
+    {
+        return NULL;
+    }
+    dim = get_dim(data_points);
+    points_len = PyObject_Length(data_points);
+    if (0 == k || k > points_len)
+    {
+        PyErr_SetString(PyExc_ValueError, "expected 0 < k <= len(points)");
+        return NULL;
+    }
+    points = malloc_points(points_len, dim);
+    if (NULL == points)
+    {
+        return PyErr_NoMemory();
+    }
+    parse_points(data_points, points, points_len, dim);
+    clusters = malloc_points(k, dim);
+    labels = (size_t *)malloc(points_len * sizeof(size_t));
+    runs = (restart_stats_t *)malloc(restarts * sizeof(restart_stats_t));
+    if (NULL == clusters || NULL == labels || NULL == runs)
+    {
+        goto cleanup;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    fit_result = fit_restarts(points, points_len, clusters, k, max_iter, dim, epsilon, restarts, seed, labels, runs, &best, deadline);
+    Py_END_ALLOW_THREADS
+
+    if (0 == fit_result || DEADLINE_STOPPED(fit_result))
+    {
+        runs_obj = PyList_New(restarts);
+        for (i = 0; i < restarts; i++)
+        {
+            PyList_SetItem(runs_obj, i, Py_BuildValue("kdn", runs[i].seed, runs[i].inertia, runs[i].iterations));
+        }
+        result = Py_BuildValue("NNdN", create_result(clusters, k, dim), create_py_labels(points_len, labels), runs[best].inertia, runs_obj);
+    }
+cleanup:
+    free(runs);
+    free(labels);
+    if (NULL != clusters)
+    {
+        free_points(k, clusters);
+    }
+    free_points(points_len, points);
+    if (NULL == result)
+    {
+        Py_RETURN_NONE;
+    }
+    return result;
+}
+
+typedef struct
+{
+    PyObject_HEAD
+    spk_state_t state;
+    int ready;
+} IncrementalObject;
+
+/*Converts a list of point tuples; the caller frees the result with free_points()*/
+static point_t *points_from_py(PyObject *data_points, size_t *points_len, size_t *dim)
+{
+    point_t *points;
+    if (!PyList_Check(data_points) || PyList_Size(data_points) == 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "expected a non-empty list of point tuples");
+        return NULL;
+    }
+    *dim = get_dim(data_points);
+    *points_len = PyObject_Length(data_points);
+    points = malloc_points(*points_len, *dim);
+    if (NULL == points)
+    {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    parse_points(data_points, points, *points_len, *dim);
+    return points;
+}
+
+static int Incremental_init(IncrementalObject *self, PyObject *args, PyObject *kwds)
+{
+    PyObject *data_points = NULL;
+    point_t *points;
+    size_t points_len, dim;
+    error_e result;
+    if (!PyArg_ParseTuple(args, "O", &data_points))
+    {
+        return -1;
+    }
+    points = points_from_py(data_points, &points_len, &dim);
+    if (NULL == points)
+    {
+        return -1;
+    }
+    if (self->ready)
+    {
+        incremental_free(&self->state);
+        self->ready = 0;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    result = incremental_init(&self->state, points, points_len, dim);
+    Py_END_ALLOW_THREADS
+    free_points(points_len, points);
+    if (OK != result)
+    {
+        PyErr_NoMemory();
+        return -1;
+    }
+    self->ready = 1;
+    return 0;
+}
+
+static void Incremental_dealloc(IncrementalObject *self)
+{
+    if (self->ready)
+    {
+        incremental_free(&self->state);
+    }
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *Incremental_append(IncrementalObject *self, PyObject *args)
+{
+    PyObject *data_points = NULL;
+    point_t *points;
+    size_t points_len, dim;
+    error_e result;
+    if (!PyArg_ParseTuple(args, "O", &data_points))
+    {
+        return NULL;
+    }
+    if (!self->ready)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Incremental is not initialized");
+        return NULL;
+    }
+    points = points_from_py(data_points, &points_len, &dim);
+    if (NULL == points)
+    {
+        return NULL;
+    }
+    if (dim != self->state.dim)
+    {
+        free_points(points_len, points);
+        PyErr_SetString(PyExc_ValueError, "appended points have a different dimension");
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    result = incremental_append(&self->state, points, points_len);
+    Py_END_ALLOW_THREADS
+    free_points(points_len, points);
+    if (OK != result)
+    {
+        return PyErr_NoMemory();
+    }
+    return PyLong_FromSize_t(self->state.n);
+}
+
+static PyObject *Incremental_spk(IncrementalObject *self, PyObject *args)
+{
+    PyObject *result_obj;
+    size_t k;
+    double **mat;
+    if (!PyArg_ParseTuple(args, "n", &k))
+    {
+        return NULL;
+    }
+    if (!self->ready)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Incremental is not initialized");
+        return NULL;
+    }
+    if (k > self->state.n)
+    {
+        PyErr_SetString(PyExc_ValueError, "k must not exceed the number of points");
+        return NULL;
+    }
+    mat = malloc_matrix(self->state.n, self->state.n);
+    if (NULL == mat)
+    {
+        return PyErr_NoMemory();
+    }
+    if (OK != incremental_embed(&self->state, &k, mat))
+    {
+        free_matrix(self->state.n, mat);
+        return PyErr_NoMemory();
+    }
+    result_obj = create_py_matrix(self->state.n, k, mat);
+    free_matrix(self->state.n, mat);
+    return result_obj;
+}
+
+static PyMethodDef IncrementalMethods[] =
+    {
+        {"append",
+         (PyCFunction)Incremental_append,
          METH_VARARGS,
-         PyDoc_STR("Calculate eigen values and vectors of a matrix using Jacobi algorithm.")},
+         PyDoc_STR("append(points) -> n. Adds points, evaluating only their affinities and warm-starting the eigensolver; the eigen step stays O(n^3).")},
         {"spk",
-         calc_spk,
+         (PyCFunction)Incremental_spk,
          METH_VARARGS,
-         PyDoc_STR("Calculate the normalized eigen matrix.")},
-        {"kmeans_fit",
-         kmeans_fit,
-         METH_VARARGS,
-         PyDoc_STR("runs kmeans algorithm")},
+         PyDoc_STR("spk(k) -> the normalized eigen matrix of all points so far (k = 0 uses the eigengap).")},
         {NULL, NULL, 0, NULL},
 };
 
-static struct PyModuleDef moduledef =
+static PyTypeObject IncrementalType = {
+    PyVarObject_HEAD_INIT(NULL, 0)};
+
+typedef struct
+{
+    PyObject_HEAD
+    spk_model_t model;
+    int ready;
+} ModelObject;
+
+static int Model_init(ModelObject *self, PyObject *args, PyObject *kwds)
+{
+    PyObject *data_points = NULL;
+    point_t *points;
+    size_t points_len, dim, k, max_iter, restarts = 1;
+    unsigned long seed = 0;
+    float epsilon;
+    error_e result;
+    if (!PyArg_ParseTuple(args, "Onnf|nk", &data_points, &k, &max_iter, &epsilon, &restarts, &seed))
     {
-        PyModuleDef_HEAD_INIT,
-        "spkm",
-        NULL,
-        -1,
-        spkmeansMethods};
+        return -1;
+    }
+    points = points_from_py(data_points, &points_len, &dim);
+    if (NULL == points)
+    {
+        return -1;
+    }
+    if (self->ready)
+    {
+        model_free(&self->model);
+        self->ready = 0;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    result = model_fit(&self->model, points, points_len, dim, k, max_iter, epsilon, restarts, seed);
+    Py_END_ALLOW_THREADS
+    free_points(points_len, points);
+    if (INVALID_INPUT == result)
+    {
+        PyErr_SetString(PyExc_ValueError, "k must not exceed the number of points");
+        return -1;
+    }
+    if (OK != result)
+    {
+        PyErr_NoMemory();
+        return -1;
+    }
+    self->ready = 1;
+    return 0;
+}
 
-PyMODINIT_FUNC
-PyInit_spkm(void)
+static void Model_dealloc(ModelObject *self)
 {
-    PyObject *m;
-    m = PyModule_Create(&moduledef);
-    if (!m)
+    if (self->ready)
+    {
+        model_free(&self->model);
+    }
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *Model_predict(ModelObject *self, PyObject *args)
+{
+    PyObject *data_points = NULL, *result_obj;
+    point_t *points;
+    size_t points_len, dim, *labels;
+    error_e result;
+    if (!PyArg_ParseTuple(args, "O", &data_points))
+    {
+        return NULL;
+    }
+    if (!self->ready)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Model is not fitted");
+        return NULL;
+    }
+    points = points_from_py(data_points, &points_len, &dim);
+    if (NULL == points)
+    {
+        return NULL;
+    }
+    if (dim != self->model.dim)
+    {
+        free_points(points_len, points);
+        PyErr_SetString(PyExc_ValueError, "query points have a different dimension");
+        return NULL;
+    }
+    labels = (size_t *)malloc(points_len * sizeof(size_t));
+    if (NULL == labels)
+    {
+        free_points(points_len, points);
+        return PyErr_NoMemory();
+    }
+    Py_BEGIN_ALLOW_THREADS
+    result = model_predict(&self->model, points, points_len, labels);
+    Py_END_ALLOW_THREADS
+    free_points(points_len, points);
+    if (OK != result)
+    {
+        free(labels);
+        return PyErr_NoMemory();
+    }
+    result_obj = create_py_labels(points_len, labels);
+    free(labels);
+    return result_obj;
+}
+
+static PyObject *Model_labels(ModelObject *self, PyObject *Py_UNUSED(ignored))
+{
+    if (!self->ready)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Model is not fitted");
+        return NULL;
+    }
+    return create_py_labels(self->model.n, self->model.labels);
+}
+
+static PyObject *Model_centroids(ModelObject *self, PyObject *Py_UNUSED(ignored))
+{
+    PyObject *result = NULL;
+    point_t *centroids;
+    size_t i;
+    if (!self->ready)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Model is not fitted");
+        return NULL;
+    }
+    centroids = (point_t *)malloc(self->model.k * sizeof(point_t));
+    if (NULL == centroids)
+    {
+        return PyErr_NoMemory();
+    }
+    for (i = 0; i < self->model.k; i++)
+    {
+        centroids[i] = self->model.clusters[i].centroid;
+    }
+    result = create_result(centroids, self->model.k, self->model.k);
+    free(centroids);
+    return result;
+}
+
+static PyMethodDef ModelMethods[] =
+    {
+        {"predict",
+         (PyCFunction)Model_predict,
+         METH_VARARGS,
+         PyDoc_STR("predict(points) -> labels. Embeds new points through the Nystrom extension and assigns the closest centroid.")},
+        {"labels",
+         (PyCFunction)Model_labels,
+         METH_NOARGS,
+         PyDoc_STR("labels() -> the labels of the training points.")},
+        {"centroids",
+         (PyCFunction)Model_centroids,
+         METH_NOARGS,
+         PyDoc_STR("centroids() -> the k centroids in the spectral embedding.")},
+        {NULL, NULL, 0, NULL},
+};
+
+static PyTypeObject ModelType = {
+    PyVarObject_HEAD_INIT(NULL, 0)};
+
+typedef struct
+{
+    PyObject_HEAD
+    graph_t graph;
+    int ready;
+} GraphObject;
+
+/*The Python names of the stages, as accepted by release() and returned by stages()*/
+static const struct
+{
+    const char *name;
+    graph_stage_e stage;
+} graph_stage_names[] = {{"wam", GRAPH_WEIGHTS}, {"ddg", GRAPH_DEGREES}, {"lnorm", GRAPH_LAPLACIAN}, {"eigens", GRAPH_EIGENS}};
+
+#define GRAPH_STAGE_NAMES_LEN (sizeof(graph_stage_names) / sizeof(graph_stage_names[0]))
+
+static int Graph_init(GraphObject *self, PyObject *args, PyObject *kwds)
+{
+    PyObject *data_points = NULL;
+    point_t *points;
+    size_t points_len, dim;
+    error_e result;
+    if (!PyArg_ParseTuple(args, "O", &data_points))
+    {
+        return -1;
+    }
+    points = points_from_py(data_points, &points_len, &dim);
+    if (NULL == points)
+    {
+        return -1;
+    }
+    if (self->ready)
+    {
+        graph_free(&self->graph);
+        self->ready = 0;
+    }
+    result = graph_init(&self->graph, points, points_len, dim);
+    free_points(points_len, points);
+    if (OK != result)
+    {
+        PyErr_NoMemory();
+        return -1;
+    }
+    self->ready = 1;
+    return 0;
+}
+
+static void Graph_dealloc(GraphObject *self)
+{
+    if (self->ready)
+    {
+        graph_free(&self->graph);
+    }
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/*
+ * Computes 'stage' without the GIL. release() holds the GIL, so once this returns the stage stays valid until
+ * the caller gives the GIL up; the loop covers a release() that ran before the GIL came back.
+ */
+static int Graph_ensure(GraphObject *self, error_e (*compute)(graph_t *graph), const graph_stage_e stage)
+{
+    error_e result = OK;
+    if (!self->ready)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Graph is not initialized");
+        return -1;
+    }
+    while (OK == result && !(graph_stages(&self->graph) & stage))
+    {
+        Py_BEGIN_ALLOW_THREADS
+        result = compute(&self->graph);
+        Py_END_ALLOW_THREADS
+    }
+    if (OK != result)
+    {
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+static PyObject *Graph_wam(GraphObject *self, PyObject *Py_UNUSED(ignored))
+{
+    if (Graph_ensure(self, graph_weights, GRAPH_WEIGHTS) != 0)
+    {
+        return NULL;
+    }
+    return create_py_matrix(self->graph.n, self->graph.n, self->graph.w_mat);
+}
+
+static PyObject *Graph_degrees(GraphObject *self, PyObject *Py_UNUSED(ignored))
+{
+    PyObject *result;
+    size_t i;
+    if (Graph_ensure(self, graph_degrees, GRAPH_DEGREES) != 0)
+    {
+        return NULL;
+    }
+    result = PyList_New(self->graph.n);
+    for (i = 0; i < self->graph.n; i++)
+    {
+        PyList_SetItem(result, i, PyFloat_FromDouble(self->graph.degrees[i]));
+    }
+    return result;
+}
+
+static PyObject *Graph_ddg(GraphObject *self, PyObject *Py_UNUSED(ignored))
+{
+    PyObject *cur_row, *result;
+    size_t i, j;
+    if (Graph_ensure(self, graph_degrees, GRAPH_DEGREES) != 0)
+    {
+        return NULL;
+    }
+    result = PyList_New(self->graph.n);
+    for (i = 0; i < self->graph.n; i++)
+    {
+        cur_row = PyList_New(self->graph.n);
+        for (j = 0; j < self->graph.n; j++)
+        {
+            PyList_SetItem(cur_row, j, PyFloat_FromDouble(i == j ? self->graph.degrees[i] : .0));
+        }
+        PyList_SetItem(result, i, cur_row);
+    }
+    return result;
+}
+
+static PyObject *Graph_lnorm(GraphObject *self, PyObject *Py_UNUSED(ignored))
+{
+    if (Graph_ensure(self, graph_laplacian, GRAPH_LAPLACIAN) != 0)
+    {
+        return NULL;
+    }
+    return create_py_matrix(self->graph.n, self->graph.n, self->graph.n_mat);
+}
+
+static PyObject *Graph_eigenvalues(GraphObject *self, PyObject *Py_UNUSED(ignored))
+{
+    PyObject *result;
+    size_t i;
+    error_e computed = OK;
+    if (Graph_ensure(self, graph_laplacian, GRAPH_LAPLACIAN) != 0)
+    {
+        return NULL;
+    }
+    while (OK == computed && graph_eigens_valid(&self->graph) < self->graph.n) /* A kept top-k solve is not enough */
+    {
+        Py_BEGIN_ALLOW_THREADS
+        computed = graph_eigens(&self->graph);
+        Py_END_ALLOW_THREADS
+    }
+    if (OK != computed)
+    {
+        return PyErr_NoMemory();
+    }
+    result = PyList_New(self->graph.n);
+    for (i = 0; i < self->graph.n; i++)
+    {
+        PyList_SetItem(result, i, PyFloat_FromDouble(self->graph.eigens[i].value));
+    }
+    return result;
+}
+
+static PyObject *Graph_spk(GraphObject *self, PyObject *args)
+{
+    PyObject *deadline_obj = NULL, *result_obj = NULL;
+    deadline_t *deadline;
+    size_t k;
+    double **mat;
+    error_e result;
+    if (!PyArg_ParseTuple(args, "n|O", &k, &deadline_obj) || deadline_from_py(deadline_obj, &deadline) != 0)
+    {
+        return NULL;
+    }
+    if (!self->ready)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Graph is not initialized");
+        return NULL;
+    }
+    if (k > self->graph.n)
+    {
+        PyErr_SetString(PyExc_ValueError, "k must not exceed the number of points");
+        return NULL;
+    }
+    mat = malloc_matrix(self->graph.n, self->graph.n);
+    if (NULL == mat)
+    {
+        return PyErr_NoMemory();
+    }
+    Py_BEGIN_ALLOW_THREADS
+    result = graph_embed(&self->graph, &k, mat, deadline);
+    Py_END_ALLOW_THREADS
+    if (OK == result || DEADLINE_STOPPED(result))
+    {
+        result_obj = create_py_matrix(self->graph.n, k, mat);
+    }
+    else
+    {
+        PyErr_NoMemory();
+    }
+    free_matrix(self->graph.n, mat);
+    return result_obj;
+}
+
+static PyObject *Graph_stages(GraphObject *self, PyObject *Py_UNUSED(ignored))
+{
+    PyObject *result = PyList_New(0), *name;
+    int stages = self->ready ? graph_stages(&self->graph) : 0;
+    size_t i;
+    for (i = 0; i < GRAPH_STAGE_NAMES_LEN; i++)
+    {
+        if (stages & graph_stage_names[i].stage)
+        {
+            name = PyUnicode_FromString(graph_stage_names[i].name);
+            PyList_Append(result, name);
+            Py_DECREF(name);
+        }
+    }
+    return result;
+}
+
+static PyObject *Graph_release(GraphObject *self, PyObject *args)
+{
+    const char *name;
+    int stages = 0;
+    Py_ssize_t i;
+    size_t j;
+    if (!self->ready)
+    {
+        Py_RETURN_NONE;
+    }
+    for (i = 0; i < PyTuple_Size(args); i++)
+    {
+        name = PyUnicode_AsUTF8(PyTuple_GetItem(args, i));
+        if (NULL == name)
+        {
+            return NULL;
+        }
+        for (j = 0; j < GRAPH_STAGE_NAMES_LEN && strcmp(name, graph_stage_names[j].name) != 0; j++)
+        {
+        }
+        if (GRAPH_STAGE_NAMES_LEN == j)
+        {
+            PyErr_Format(PyExc_ValueError, "unknown stage '%s'", name);
+            return NULL;
+        }
+        stages |= graph_stage_names[j].stage;
+    }
+    graph_release(&self->graph, 0 == PyTuple_Size(args) ? GRAPH_ALL_STAGES : stages);
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef GraphMethods[] =
+    {
+        {"wam",
+         (PyCFunction)Graph_wam,
+         METH_NOARGS,
+         PyDoc_STR("wam() -> W, computed on the first call and kept.")},
+        {"ddg",
+         (PyCFunction)Graph_ddg,
+         METH_NOARGS,
+         PyDoc_STR("ddg() -> D as a matrix, from the kept degrees.")},
+        {"degrees",
+         (PyCFunction)Graph_degrees,
+         METH_NOARGS,
+         PyDoc_STR("degrees() -> the diagonal of D, computed from W on the first call and kept.")},
+        {"lnorm",
+         (PyCFunction)Graph_lnorm,
+         METH_NOARGS,
+         PyDoc_STR("lnorm() -> L_norm, computed from W and the degrees on the first call and kept.")},
+        {"eigenvalues",
+         (PyCFunction)Graph_eigenvalues,
+         METH_NOARGS,
+         PyDoc_STR("eigenvalues() -> every eigenvalue of L_norm in the order of section 1.3, from a full decomposition that is kept.")},
+        {"spk",
+         (PyCFunction)Graph_spk,
+         METH_VARARGS,
+         PyDoc_STR("spk(k[, deadline]) -> the normalized eigen matrix (k = 0 uses the eigengap). The eigenpairs are kept, so a k they\n"
+                   "already cover is only a copy; eigenpairs cut short by the deadline are used once and not kept.")},
+        {"stages",
+         (PyCFunction)Graph_stages,
+         METH_NOARGS,
+         PyDoc_STR("stages() -> the names of the stages currently kept, among 'wam', 'ddg', 'lnorm' and 'eigens'.")},
+        {"release",
+         (PyCFunction)Graph_release,
+         METH_VARARGS,
+         PyDoc_STR("release(*stages). Frees the named stages, or all of them but the points; they are recomputed when next needed.")},
+        {NULL, NULL, 0, NULL},
+};
+
+static PyTypeObject GraphType = {
+    PyVarObject_HEAD_INIT(NULL, 0)};
+
+static PyObject *alloc_stats(PyObject *self, PyObject *args)
+{
+    alloc_stats_t stats;
+    get_alloc_stats(&stats);
+    return Py_BuildValue("{s:n,s:n,s:n,s:n,s:n,s:n,s:n,s:n,s:n,s:n,s:n}", "heap_blocks", stats.heap_blocks, "heap_bytes", stats.heap_bytes,
+                         "mapped_blocks", stats.mapped_blocks, "mapped_bytes", stats.mapped_bytes, "explicit_bytes", stats.explicit_bytes,
+                         "transparent_bytes", stats.transparent_bytes, "interleaved_bytes", stats.interleaved_bytes,
+                         "first_touch_bytes", stats.first_touch_bytes, "current_bytes", stats.current_bytes, "peak_bytes", stats.peak_bytes,
+                         "nodes", stats.nodes);
+}
+
+static PyObject *calc_compression_report(PyObject *self, PyObject *args)
+{
+    PyObject *data_points = NULL;
+    const char *precision_name = NULL;
+    options_t options;
+    precision_e precision;
+    double threshold;
+    compress_report_t report;
+    point_t *points;
+    size_t points_len, dim, k;
+    int result;
+
+    load_options(&options);
+    threshold = options.affinity_threshold;
+    if (!PyArg_ParseTuple(args, "On|zd", &data_points, &k, &precision_name, &threshold))
+    {
+        return NULL;
+    }
+    precision = NULL != precision_name ? get_precision(precision_name) : options.compress;
+    if (NO_COMPRESSION == precision)
+    {
+        precision = NULL != precision_name ? NO_COMPRESSION : FLOAT32_PRECISION;
+    }
+    points_len = PyObject_Length(data_points);
+    if (NO_COMPRESSION == precision || k < 1 || k + 1 > points_len || threshold < .0 || threshold > 1.0)
+    {
+        PyErr_SetString(PyExc_ValueError, "expected 0 < k < len(points), 0 <= threshold <= 1 and a precision of 'float32', 'bfloat16' or 'float16'");
+        return NULL;
+    }
+    dim = get_dim(data_points);
+    points = malloc_points(points_len, dim);
+    if (NULL == points)
+    {
+        return PyErr_NoMemory();
+    }
+    parse_points(data_points, points, points_len, dim);
+    Py_BEGIN_ALLOW_THREADS
+    result = compress_report(points_len, points, dim, k, threshold, precision, &report);
+    Py_END_ALLOW_THREADS
+    free_points(points_len, points);
+    if (0 != result)
+    {
+        return PyErr_NoMemory();
+    }
+    return Py_BuildValue("{s:n,s:n,s:n,s:n,s:d,s:d,s:d,s:d,s:d}", "nnz", report.nnz, "bytes", report.bytes, "table_bytes", report.table_bytes, "dense_bytes", report.dense_bytes,
+                         "max_error", report.max_error, "eigenvalue_error", report.eigenvalue_error, "eigengap", report.eigengap,
+                         "compressed_eigengap", report.compressed_eigengap, "subspace_sine", report.subspace_sine);
+}
+
+/*Lays every input out row after row in one block; points may be tuples or lists, as may a matrix's rows*/
+static double *batch_inputs_from_py(PyObject *inputs_obj, const goal_e goal, const size_t k, batch_input_t *inputs, const size_t count)
+{
+    PyObject *input_obj, *row;
+    double *values, *cursor;
+    size_t total = 0, i, r, j;
+
+    for (i = 0; i < count; i++)
+    {
+        input_obj = PyList_GetItem(inputs_obj, i);
+        memset(&inputs[i], 0, sizeof(batch_input_t));
+        inputs[i].goal = goal;
+        inputs[i].k = k;
+        inputs[i].n = PyObject_Length(input_obj);
+        inputs[i].dim = inputs[i].n > 0 ? (size_t)PyObject_Length(PySequence_Fast_GET_ITEM(input_obj, 0)) : 0;
+        total += inputs[i].n * inputs[i].dim;
+    }
+    values = (double *)malloc((total > 0 ? total : 1) * sizeof(double));
+    if (NULL == values)
+    {
+        return NULL;
+    }
+    cursor = values;
+    for (i = 0; i < count; i++)
+    {
+        input_obj = PyList_GetItem(inputs_obj, i);
+        inputs[i].values = cursor;
+        for (r = 0; r < inputs[i].n; r++)
+        {
+            row = PySequence_Fast_GET_ITEM(input_obj, r);
+            for (j = 0; j < inputs[i].dim; j++)
+            {
+                *cursor++ = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(row, j));
+            }
+        }
+    }
+    return values;
+}
+
+static PyObject *batch_result_to_py(const goal_e goal, batch_result_t *result)
+{
+    PyObject *out_values, *out_vectors, *packed;
+    double **rows;
+    size_t i;
+    if (NULL == result->values)
+    {
+        Py_RETURN_NONE;
+    }
+    rows = (double **)malloc((result->rows > 0 ? result->rows : 1) * sizeof(double *));
+    if (NULL == rows)
+    {
+        return PyErr_NoMemory();
+    }
+    for (i = 0; i < result->rows; i++)
+    {
+        rows[i] = result->values + i * result->cols;
+    }
+    if (JACOBI != goal)
+    {
+        packed = create_py_matrix(result->rows, result->cols, rows);
+        free(rows);
+        return packed;
+    }
+    out_values = PyList_New(result->cols);
+    for (i = 0; i < result->cols; i++)
+    {
+        PyList_SetItem(out_values, i, PyFloat_FromDouble(rows[0][i]));
+    }
+    out_vectors = create_py_matrix(result->rows - 1, result->cols, rows + 1);
+    free(rows);
+    packed = PyTuple_Pack(2, out_values, out_vectors);
+    Py_DECREF(out_values);
+    Py_DECREF(out_vectors);
+    return packed;
+}
+
+static PyObject *calc_batch(PyObject *self, PyObject *args)
+{
+    PyObject *inputs_obj, *result_obj = NULL, *item, *row;
+    char *goal_name;
+    goal_e goal;
+    size_t count, k = 0, i, r;
+    batch_input_t *inputs;
+    batch_result_t *results;
+    double *values;
+
+    if (!PyArg_ParseTuple(args, "sO!|n", &goal_name, &PyList_Type, &inputs_obj, &k))
+    {
+        return NULL;
+    }
+    goal = get_goal(goal_name);
+    if (UNKNOWN_GOAL == goal)
+    {
+        PyErr_SetString(PyExc_ValueError, "expected a goal of 'wam', 'ddg', 'lnorm', 'jacobi' or 'spk'");
+        return NULL;
+    }
+    count = PyList_Size(inputs_obj);
+    for (i = 0; i < count; i++)
+    {
+        item = PyList_GetItem(inputs_obj, i);
+        for (r = 0; (PyList_Check(item) || PyTuple_Check(item)) && r < (size_t)PySequence_Fast_GET_SIZE(item); r++)
+        {
+            row = PySequence_Fast_GET_ITEM(item, r);
+            if ((!PyList_Check(row) && !PyTuple_Check(row)) || PySequence_Fast_GET_SIZE(row) != PyObject_Length(PySequence_Fast_GET_ITEM(item, 0)))
+            {
+                break;
+            }
+        }
+        if ((!PyList_Check(item) && !PyTuple_Check(item)) || r < (size_t)PySequence_Fast_GET_SIZE(item))
+        {
+            PyErr_SetString(PyExc_TypeError, "expected every input to be a list of equally long points or matrix rows");
+            return NULL;
+        }
+    }
+    inputs = (batch_input_t *)malloc((count > 0 ? count : 1) * sizeof(batch_input_t));
+    results = (batch_result_t *)malloc((count > 0 ? count : 1) * sizeof(batch_result_t));
+    values = NULL != inputs && NULL != results ? batch_inputs_from_py(inputs_obj, goal, k, inputs, count) : NULL;
+    if (NULL == values)
+    {
+        free(inputs);
+        free(results);
+        return PyErr_NoMemory();
+    }
+    Py_BEGIN_ALLOW_THREADS
+    run_batch(inputs, count, BATCH_MEMORY, NULL, results);
+    Py_END_ALLOW_THREADS
+
+    result_obj = PyList_New(count);
+    for (i = 0; i < count && NULL != result_obj; i++)
+    {
+        item = batch_result_to_py(goal, &results[i]);
+        if (NULL == item)
+        {
+            Py_CLEAR(result_obj);
+            break;
+        }
+        PyList_SetItem(result_obj, i, item);
+    }
+    for (i = 0; i < count; i++)
+    {
+        free(results[i].values);
+    }
+    free(values);
+    free(inputs);
+    free(results);
+    return result_obj;
+}
+
+static PyObject *calc_bisect(PyObject *self, PyObject *args)
+{
+    PyObject *data_points = NULL, *splits_obj, *result_obj = NULL;
+    point_t *points;
+    size_t points_len, dim, k, min_size = 1, clusters_len = 0, i;
+    double max_conductance = 1.0;
+    size_t *labels;
+    bisect_split_t *splits;
+    error_e result;
+
+    if (!PyArg_ParseTuple(args, "On|nd", &data_points, &k, &min_size, &max_conductance))
+    {
+        return NULL;
+    }
+    points = points_from_py(data_points, &points_len, &dim);
+    if (NULL == points)
+    {
+        return NULL;
+    }
+    if (k > points_len || 0 == min_size)
+    {
+        free_points(points_len, points);
+        PyErr_SetString(PyExc_ValueError, "expected k <= len(points) and min_size >= 1");
+        return NULL;
+    }
+    labels = (size_t *)malloc(points_len * sizeof(size_t));
+    splits = (bisect_split_t *)malloc(points_len * sizeof(bisect_split_t));
+    if (NULL == labels || NULL == splits)
+    {
+        result = MALLOC_ERROR;
+        goto cleanup;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    result = bisect_labels(points_len, points, dim, k, min_size, max_conductance, labels, &clusters_len, splits);
+    Py_END_ALLOW_THREADS
+    if (OK == result)
+    {
+        splits_obj = PyList_New(clusters_len - 1);
+        for (i = 0; i + 1 < clusters_len; i++)
+        {
+            PyList_SetItem(splits_obj, i, Py_BuildValue("nndd", splits[i].cluster, splits[i].size, splits[i].conductance, splits[i].fiedler));
+        }
+        result_obj = Py_BuildValue("NN", create_py_labels(points_len, labels), splits_obj);
+    }
+cleanup:
+    free(splits);
+    free(labels);
+    free_points(points_len, points);
+    if (NULL == result_obj)
+    {
+        return PyErr_NoMemory();
+    }
+    return result_obj;
+}
+
+static PyObject *calc_knn(PyObject *self, PyObject *args)
+{
+    PyObject *data_points = NULL, *data_queries = NULL, *indices_obj, *distances_obj, *row, *result_obj = NULL;
+    options_t options;
+    spatial_index_t index;
+    point_t *points, *queries;
+    size_t points_len, dim, queries_len, query_dim, k, q, i;
+    size_t *indices = NULL;
+    double *distances = NULL;
+    int result = 1;
+
+    if (!PyArg_ParseTuple(args, "On|O", &data_points, &k, &data_queries))
+    {
+        return NULL;
+    }
+    points = points_from_py(data_points, &points_len, &dim);
+    if (NULL == points)
+    {
+        return NULL;
+    }
+    if (0 == k || k > points_len)
+    {
+        free_points(points_len, points);
+        PyErr_SetString(PyExc_ValueError, "expected 0 < k <= len(points)");
+        return NULL;
+    }
+    queries = points;
+    queries_len = points_len;
+    if (NULL != data_queries)
+    {
+        queries = points_from_py(data_queries, &queries_len, &query_dim);
+        if (NULL == queries)
+        {
+            free_points(points_len, points);
+            return NULL;
+        }
+        if (query_dim != dim)
+        {
+            free_points(queries_len, queries);
+            free_points(points_len, points);
+            PyErr_SetString(PyExc_ValueError, "query points have a different dimension");
+            return NULL;
+        }
+    }
+    load_options(&options);
+    indices = (size_t *)malloc(queries_len * k * sizeof(size_t));
+    distances = (double *)malloc(queries_len * k * sizeof(double));
+    if (NULL == indices || NULL == distances || spatial_build(&index, points, points_len, dim, options.index_epsilon) != 0)
+    {
+        goto cleanup;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    result = spatial_knn(&index, queries, queries_len, k, indices, distances);
+    Py_END_ALLOW_THREADS
+    spatial_free(&index);
+    if (0 == result)
+    {
+        indices_obj = PyList_New(queries_len);
+        distances_obj = PyList_New(queries_len);
+        for (q = 0; q < queries_len; q++)
+        {
+            row = PyList_New(k);
+            for (i = 0; i < k; i++)
+            {
+                PyList_SetItem(row, i, PyLong_FromSize_t(indices[q * k + i]));
+            }
+            PyList_SetItem(indices_obj, q, row);
+            row = PyList_New(k);
+            for (i = 0; i < k; i++)
+            {
+                PyList_SetItem(row, i, PyFloat_FromDouble(distances[q * k + i]));
+            }
+            PyList_SetItem(distances_obj, q, row);
+        }
+        result_obj = Py_BuildValue("NN", indices_obj, distances_obj);
+    }
+cleanup:
+    free(distances);
+    free(indices);
+    if (queries != points)
+    {
+        free_points(queries_len, queries);
+    }
+    free_points(points_len, points);
+    if (NULL == result_obj)
+    {
+        return PyErr_NoMemory();
+    }
+    return result_obj;
+}
+
+static PyMethodDef spkmeansMethods[] =
+    {
+
+        {"wam",
+         calc_wam,
+         METH_VARARGS,
+         PyDoc_STR("Calculate Weighted Adjacency Matrix.")},
+        {"ddg",
+         calc_ddg,
+         METH_VARARGS,
+         PyDoc_STR("Calculate Diagonal Degree Graph.")},
+        {"lnorm",
+         calc_lnorm,
+         METH_VARARGS,
+         PyDoc_STR("Calculate Normalized Graph Laplacian.")},
+        {"jacobi",
+         calc_jacobi,
+         METH_VARARGS,
+         PyDoc_STR("jacobi(matrix[, deadline]). Calculate eigen values and vectors of a matrix using Jacobi algorithm.")},
+        {"spk",
+         calc_spk,
+         METH_VARARGS,
+         PyDoc_STR("spk(points, k[, deadline]). Calculate the normalized eigen matrix; wam, ddg and lnorm take the same arguments.")},
+        {"pic",
+         calc_pic,
+         METH_VARARGS,
+         PyDoc_STR("pic(points, k[, deadline]). Calculate the SPKM_PIC_VECTORS power iteration vectors, one per column, to cluster in place of spk's.")},
+        {"spk_sweep",
+         calc_spk_sweep,
+         METH_VARARGS,
+         PyDoc_STR("spk_sweep(points, k_min, k_max, max_iter, epsilon[, seed]) -> (eigengap_k, [(k, centroids, labels, inertia), ...]).\n"
+                   "Decomposes the Laplacian once and clusters every k in the range concurrently.")},
+        {"kmeans_restarts",
+         kmeans_restarts,
+         METH_VARARGS,
+         PyDoc_STR("kmeans_restarts(points, k, restarts, max_iter, epsilon[, seed, deadline]) -> (centroids, labels, inertia, [(seed, inertia, iterations), ...]).\n"
+                   "Runs independently seeded k-means fits concurrently and keeps the lowest inertia.")},
+        {"kmeans_fit",
+         kmeans_fit,
+         METH_VARARGS,
+         PyDoc_STR("kmeans_fit(centroids, points, max_iter, epsilon[, deadline]). runs kmeans algorithm")},
+        {"bisect",
+         calc_bisect,
+         METH_VARARGS,
+         PyDoc_STR("bisect(points, k[, min_size, max_conductance]) -> (labels, [(cluster, size, conductance, fiedler), ...]).\n"
+                   "Splits the points in two by the Fiedler vector of each cluster's L_norm, largest clusters first, until there are k clusters\n"
+                   "(0 for no limit) or no cut leaves min_size points on both sides with at most max_conductance; the i-th split made cluster i + 1.")},
+        {"knn",
+         calc_knn,
+         METH_VARARGS,
+         PyDoc_STR("knn(points, k[, queries]) -> (indices, distances). The k nearest points of every query (every point by default), nearest\n"
+                   "first, from one KD-tree or VP-tree over the points searched in parallel batches; a point is its own neighbour at distance 0.")},
+        {"alloc_stats",
+         alloc_stats,
+         METH_NOARGS,
+         PyDoc_STR("alloc_stats() -> dict of the matrix blocks allocated so far: how many came from the heap or were mapped, the bytes backed by\n"
+                   "explicit or transparent huge pages, interleaved or first-touched across 'nodes' NUMA nodes, and the current and peak bytes.")},
+        {"batch",
+         calc_batch,
+         METH_VARARGS,
+         PyDoc_STR("batch(goal, inputs[, k]) -> [result, ...]. Runs the goal on every point set, or for 'jacobi' every matrix, of the list,\n"
+                   "one input per worker with reused buffers, and returns what the goal's own function would, None for a failed input.")},
+        {"compression_report",
+         calc_compression_report,
+         METH_VARARGS,
+         PyDoc_STR("compression_report(points, k[, precision, threshold]) -> dict comparing the k + 1 largest eigenpairs of L_norm from W compressed\n"
+                   "as by SPKM_COMPRESS (default 'float32') and SPKM_AFFINITY_THRESHOLD with those of the exact W: the kept affinities, their bytes\n"
+                   "against a dense W's (the fixed 16-bit decoding table apart, as table_bytes), the largest error of a stored affinity and of an eigenvalue, both eigengaps after the k-th eigenvalue, and\n"
+                   "the sine of the largest angle between the two embeddings.")},
+        {NULL, NULL, 0, NULL},
+};
+
+static struct PyModuleDef moduledef =
+    {
+        PyModuleDef_HEAD_INIT,
+        "spkm",
+        NULL,
+        -1,
+        spkmeansMethods};
+
+PyMODINIT_FUNC
+PyInit_spkm(void)
+{
+    PyObject *m;
+    IncrementalType.tp_name = "spkm.Incremental";
+    IncrementalType.tp_doc = PyDoc_STR("Incremental(points): spectral state that grows with append() instead of being rebuilt.");
+    IncrementalType.tp_basicsize = sizeof(IncrementalObject);
+    IncrementalType.tp_flags = Py_TPFLAGS_DEFAULT;
+    IncrementalType.tp_new = PyType_GenericNew;
+    IncrementalType.tp_init = (initproc)Incremental_init;
+    IncrementalType.tp_dealloc = (destructor)Incremental_dealloc;
+    IncrementalType.tp_methods = IncrementalMethods;
+    if (PyType_Ready(&IncrementalType) < 0)
+    {
+        return NULL;
+    }
+    DeadlineType.tp_name = "spkm.Deadline";
+    DeadlineType.tp_doc = PyDoc_STR("Deadline([budget]): a time budget in seconds (0 for none) and a cancellation token. Passed to wam, ddg, lnorm, spk, jacobi, kmeans_fit or\n"
+                                    "kmeans_restarts, it makes them return their best result so far once it expires; stopped() then tells why.");
+    DeadlineType.tp_basicsize = sizeof(DeadlineObject);
+    DeadlineType.tp_flags = Py_TPFLAGS_DEFAULT;
+    DeadlineType.tp_new = PyType_GenericNew;
+    DeadlineType.tp_init = (initproc)Deadline_init;
+    DeadlineType.tp_methods = DeadlineMethods;
+    if (PyType_Ready(&DeadlineType) < 0)
+    {
+        return NULL;
+    }
+    ModelType.tp_name = "spkm.Model";
+    ModelType.tp_doc = PyDoc_STR("Model(points, k, max_iter, epsilon[, restarts, seed]): a fitted spectral clustering that labels new points with predict().");
+    ModelType.tp_basicsize = sizeof(ModelObject);
+    ModelType.tp_flags = Py_TPFLAGS_DEFAULT;
+    ModelType.tp_new = PyType_GenericNew;
+    ModelType.tp_init = (initproc)Model_init;
+    ModelType.tp_dealloc = (destructor)Model_dealloc;
+    ModelType.tp_methods = ModelMethods;
+    if (PyType_Ready(&ModelType) < 0)
+    {
+        return NULL;
+    }
+
+    GraphType.tp_name = "spkm.Graph";
+    GraphType.tp_doc = PyDoc_STR("Graph(points): the points and every stage computed from them so far. wam, ddg, lnorm and spk each reuse the\n"
+                                 "stages before them instead of starting from the points, and release() frees stages that are no longer needed.");
+    GraphType.tp_basicsize = sizeof(GraphObject);
+    GraphType.tp_flags = Py_TPFLAGS_DEFAULT;
+    GraphType.tp_new = PyType_GenericNew;
+    GraphType.tp_init = (initproc)Graph_init;
+    GraphType.tp_dealloc = (destructor)Graph_dealloc;
+    GraphType.tp_methods = GraphMethods;
+    if (PyType_Ready(&GraphType) < 0)
+    {
+        return NULL;
+    }
+
+    m = PyModule_Create(&moduledef);
+    if (!m)
+    {
+        return NULL;
+    }
+    Py_INCREF(&IncrementalType);
+    if (PyModule_AddObject(m, "Incremental", (PyObject *)&IncrementalType) < 0)
+    {
+        Py_DECREF(&IncrementalType);
+        Py_DECREF(m);
+        return NULL;
+    }
+    Py_INCREF(&ModelType);
+    if (PyModule_AddObject(m, "Model", (PyObject *)&ModelType) < 0)
+    {
+        Py_DECREF(&ModelType);
+        Py_DECREF(m);
+        return NULL;
+    }
+    Py_INCREF(&GraphType);
+    if (PyModule_AddObject(m, "Graph", (PyObject *)&GraphType) < 0)
+    {
+        Py_DECREF(&GraphType);
+        Py_DECREF(m);
+        return NULL;
+    }
+    Py_INCREF(&DeadlineType);
+    if (PyModule_AddObject(m, "Deadline", (PyObject *)&DeadlineType) < 0)
     {
+        Py_DECREF(&DeadlineType);
+        Py_DECREF(m);
         return NULL;
     }
     return m;
@@ -0,0 +1,215 @@
+/*
+ * Randomized block subspace iteration for the k largest eigenpairs of a symmetric matrix.
+ * Blocks of vectors are kept as rows (block[i] is the i-th vector), so every product is a row-major
+ * matrix-matrix product and Gram-Schmidt walks contiguous memory.
+ */
+#include <stdlib.h>
+#include <math.h>
+
+#include "subspace.h"
+#include "eigen.h"
+#include "tridiag.h"
+#include "matrix.h"
+
+/*Modified Gram-Schmidt over the rows, run twice so the block stays orthonormal to working precision*/
+int orthonormalize_rows(const size_t rows, const size_t n, double **block)
+{
+    size_t pass, i, j, r;
+    double dot, norm;
+    for (pass = 0; pass < 2; pass++)
+    {
+        for (i = 0; i < rows; i++)
+        {
+            for (j = 0; j < i; j++)
+            {
+                dot = .0;
+                for (r = 0; r < n; r++)
+                {
+                    dot += block[i][r] * block[j][r];
+                }
+                for (r = 0; r < n; r++)
+                {
+                    block[i][r] -= dot * block[j][r];
+                }
+            }
+            norm = .0;
+            for (r = 0; r < n; r++)
+            {
+                norm += block[i][r] * block[i][r];
+            }
+            norm = sqrt(norm);
+            for (r = 0; r < n; r++)
+            {
+                block[i][r] = norm > .0 ? block[i][r] / norm : .0; /* A dependent vector drops out of the basis */
+            }
+        }
+    }
+    return 0;
+}
+
+/*Fills the block with standard normal samples (Box-Muller over a 64-bit LCG)*/
+void random_gaussian_block(const size_t rows, const size_t n, double **block, unsigned long seed)
+{
+    size_t i, r;
+    double u1, u2;
+    for (i = 0; i < rows; i++)
+    {
+        for (r = 0; r < n; r++)
+        {
+            seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+            u1 = ((double)(seed >> 11) + 1.0) / 9007199254740993.0;
+            seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+            u2 = (double)(seed >> 11) / 9007199254740992.0;
+            block[i][r] = sqrt(-2.0 * log(u1)) * cos(6.283185307179586 * u2);
+        }
+    }
+}
+
+/*
+ * max over the top k Ritz pairs of |A x - lambda x|, from the rows of Z = Q A that are already known:
+ * A x_i = (S Z)_i since x_i = (S Q)_i, so no further product with A is needed.
+ */
+static double ritz_residual(const size_t n, const size_t l, const size_t k, double **q, double **z, double **s, eigen_t *small)
+{
+    double residual = .0, sum, ax, x;
+    size_t i, j, r;
+    for (i = 0; i < k; i++)
+    {
+        sum = .0;
+        for (r = 0; r < n; r++)
+        {
+            ax = .0;
+            x = .0;
+            for (j = 0; j < l; j++)
+            {
+                ax += s[i][j] * z[j][r];
+                x += s[i][j] * q[j][r];
+            }
+            sum += (ax - small[i].value * x) * (ax - small[i].value * x);
+        }
+        residual = sqrt(sum) > residual ? sqrt(sum) : residual;
+    }
+    return residual;
+}
+
+/*
+ * Y = Omega * A, then 'power_iters' rounds of Q = orth(Q * A), then the projected (k + oversample)-square
+ * problem B = Q A Q^T is solved to convergence with tridiag_eigens() and its top k eigenvectors are lifted back
+ * as Q^T s. While the largest residual of those k pairs is above SUBSPACE_TOLERANCE times the largest
+ * eigenvalue, up to SUBSPACE_MAX_ITERS further rounds are run, each followed by the projection again. A spectrum
+ * too bunched to converge by then, as the top of an L_norm often is, is solved by tridiag_top_eigens() instead.
+ * On return eigens[0..k) are sorted as in section 1.3; the other entries are left unset.
+ */
+int subspace_top_eigens(const size_t n, double **mat, eigen_t *eigens, const size_t k, const size_t oversample, const size_t power_iters)
+{
+    int result = 1;
+    double **q, **z, **b, **s, **swap, scale;
+    eigen_t *small;
+    size_t l, i, j, iter, rounds, wanted = k;
+    int converged = 0;
+
+    l = k + oversample < n ? k + oversample : n;
+    q = (double **)malloc_matrix(l, n, sizeof(double));
+    if (NULL == q)
+    {
+        goto end;
+    }
+    z = (double **)malloc_matrix(l, n, sizeof(double));
+    if (NULL == z)
+    {
+        goto q_cleanup;
+    }
+    b = (double **)malloc_matrix(l, l, sizeof(double));
+    if (NULL == b)
+    {
+        goto z_cleanup;
+    }
+    small = malloc_eigens(l);
+    if (NULL == small)
+    {
+        goto b_cleanup;
+    }
+    s = (double **)malloc_matrix(k, l, sizeof(double));
+    if (NULL == s)
+    {
+        goto small_cleanup;
+    }
+
+    random_gaussian_block(l, n, z, 0);
+    multiply_blocked(l, n, n, z, mat, q); /* A is symmetric, so the rows of Omega * A are A applied to each vector */
+    orthonormalize_rows(l, n, q);
+    for (rounds = 0;; rounds++)
+    {
+        for (iter = 0; iter < (0 == rounds ? power_iters : 1); iter++)
+        {
+            multiply_blocked(l, n, n, q, mat, z);
+            orthonormalize_rows(l, n, z);
+            swap = q;
+            q = z;
+            z = swap;
+        }
+
+        multiply_blocked(l, n, n, q, mat, z);
+        multiply_transposed_blocked(l, n, l, z, q, b);
+        for (i = 0; i < l; i++)
+        {
+            for (j = 0; j < i; j++)
+            {
+                b[i][j] = b[j][i] = 0.5 * (b[i][j] + b[j][i]); /* Removes the rounding asymmetry of the products */
+            }
+        }
+        result = tridiag_eigens(l, b, small);
+        if (0 != result)
+        {
+            goto s_cleanup;
+        }
+        qsort(small, l, sizeof(eigen_t), compare_eigenvalues);
+        for (i = 0; i < k; i++)
+        {
+            for (j = 0; j < l; j++)
+            {
+                s[i][j] = small[i].vector[j];
+            }
+        }
+        scale = fabs(small[0].value) > 1.0 ? fabs(small[0].value) : 1.0;
+        converged = l == n || ritz_residual(n, l, k, q, z, s, small) <= SUBSPACE_TOLERANCE * scale;
+        if (converged || rounds >= SUBSPACE_MAX_ITERS)
+        {
+            break;
+        }
+    }
+
+    if (!converged)
+    {
+        goto s_cleanup;
+    }
+    for (i = 0; i < k; i++)
+    {
+        eigens[i].value = small[i].value;
+    }
+    multiply_blocked(k, l, n, s, q, z);
+    for (i = 0; i < k; i++)
+    {
+        for (j = 0; j < n; j++)
+        {
+            eigens[i].vector[j] = z[i][j];
+        }
+    }
+
+s_cleanup:
+    free_matrix(k, (void **)s);
+small_cleanup:
+    free_eigens(l, small);
+b_cleanup:
+    free_matrix(l, (void **)b);
+z_cleanup:
+    free_matrix(l, (void **)z);
+q_cleanup:
+    free_matrix(l, (void **)q);
+end:
+    if (0 == result && !converged)
+    {
+        result = tridiag_top_eigens(n, mat, eigens, &wanted);
+    }
+    return result;
+}
@@ -0,0 +1,16 @@
+#ifndef SUBSPACE_H
+#define SUBSPACE_H
+
+#include <stdlib.h>
+#include "eigen.h"
+
+#define SUBSPACE_DEFAULT_OVERSAMPLE 10
+#define SUBSPACE_DEFAULT_POWER_ITERS 2
+#define SUBSPACE_MAX_ITERS 50    /* Further power iterations while the Ritz residuals are above the tolerance */
+#define SUBSPACE_TOLERANCE 1e-10 /* Largest residual norm of a top-k Ritz pair, relative to the largest eigenvalue */
+
+int orthonormalize_rows(const size_t rows, const size_t n, double **block);
+void random_gaussian_block(const size_t rows, const size_t n, double **block, unsigned long seed);
+int subspace_top_eigens(const size_t n, double **mat, eigen_t *eigens, const size_t k, const size_t oversample, const size_t power_iters);
+
+#endif /* SUBSPACE_H */
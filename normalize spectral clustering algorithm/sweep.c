@@ -0,0 +1,177 @@
+/*Clustering for a whole range of k values on top of a single eigendecomposition*/
+#include <stdlib.h>
+#include <string.h>
+
+#include "sweep.h"
+#include "eigen.h"
+#include "kmeans.h"
+#include "matrix.h"
+#include "parallel.h"
+
+typedef struct sweep_job_t
+{
+    size_t n;
+    size_t k_min;
+    double **u_mat;  /* The first k_max sorted eigenvectors as columns */
+    size_t *seeds;   /* K-means++ indices, the first k of them seed the run for k */
+    size_t max_iter;
+    float epsilon;
+    sweep_result_t *results;
+} sweep_job_t;
+
+/*Builds the row-normalized embedding for one k from the shared eigenvectors and clusters it*/
+static void sweep_task(void *arg, const size_t index)
+{
+    sweep_job_t *job = (sweep_job_t *)arg;
+    sweep_result_t *result = &job->results[index];
+    const size_t k = job->k_min + index;
+    size_t i;
+    double **t_mat;
+    point_t *embedded;
+    fit_stats_t stats;
+
+    result->status = MALLOC_ERROR;
+    t_mat = (double **)malloc_matrix(job->n, k, sizeof(double));
+    if (NULL == t_mat)
+    {
+        return;
+    }
+    normalize_matrix(job->n, k, t_mat, job->u_mat);
+
+    embedded = (point_t *)malloc(job->n * sizeof(point_t));
+    if (NULL == embedded)
+    {
+        goto t_cleanup;
+    }
+    for (i = 0; i < job->n; i++)
+    {
+        embedded[i].elements = t_mat[i];
+    }
+
+    result->centroids = malloc_points(k, k);
+    result->labels = (size_t *)malloc(job->n * sizeof(size_t));
+    if (NULL == result->centroids || NULL == result->labels)
+    {
+        goto embedded_cleanup;
+    }
+    for (i = 0; i < k; i++)
+    {
+        memcpy(result->centroids[i].elements, t_mat[job->seeds[i]], k * sizeof(double));
+    }
+    stats.labels = result->labels;
+    result->status = fit_with_stats(embedded, job->n, result->centroids, k, job->max_iter, k, job->epsilon, &stats);
+    result->inertia = stats.inertia;
+    result->iterations = stats.iterations;
+
+embedded_cleanup:
+    free(embedded);
+t_cleanup:
+    free_matrix(job->n, (void **)t_mat);
+}
+
+/*
+ * Decomposes L_norm once, then clusters every k in [k_min, k_max] concurrently.
+ * The k-means++ seeds are drawn once on the k_max embedding and each k starts from a prefix of them,
+ * so neighbouring k values share their starting centroids instead of being seeded cold.
+ */
+error_e spk_sweep(const size_t n, point_t *points, const size_t dim, const size_t k_min, const size_t k_max, const size_t max_iter, const float epsilon, const unsigned long seed, sweep_result_t *results, size_t *eigengap_k)
+{
+    error_e result;
+    eigen_t *eigens;
+    sweep_job_t job;
+    double **t_mat;
+    point_t *embedded;
+    size_t i;
+
+    if (0 == k_min || k_min > k_max || k_max > n)
+    {
+        return INVALID_INPUT;
+    }
+    for (i = 0; i <= k_max - k_min; i++)
+    {
+        results[i].k = k_min + i;
+        results[i].centroids = NULL;
+        results[i].labels = NULL;
+    }
+
+    eigens = malloc_eigens(n);
+    if (NULL == eigens)
+    {
+        result = MALLOC_ERROR;
+        goto end;
+    }
+    result = calc_sorted_eigens(n, points, dim, eigens, NULL, NULL);
+    if (OK != result)
+    {
+        goto eigens_cleanup;
+    }
+    *eigengap_k = find_eigengap_max(n, eigens);
+
+    job.n = n;
+    job.k_min = k_min;
+    job.max_iter = max_iter;
+    job.epsilon = epsilon;
+    job.results = results;
+    job.u_mat = (double **)malloc_matrix(n, k_max, sizeof(double));
+    job.seeds = (size_t *)malloc(k_max * sizeof(size_t));
+    t_mat = (double **)malloc_matrix(n, k_max, sizeof(double));
+    embedded = (point_t *)malloc(n * sizeof(point_t));
+    if (NULL == job.u_mat || NULL == job.seeds || NULL == t_mat || NULL == embedded)
+    {
+        result = MALLOC_ERROR;
+        goto job_cleanup;
+    }
+    build_matrix_from_eigens(n, k_max, eigens, job.u_mat);
+    normalize_matrix(n, k_max, t_mat, job.u_mat);
+    for (i = 0; i < n; i++)
+    {
+        embedded[i].elements = t_mat[i];
+    }
+    if (kmeanspp(embedded, n, k_max, k_max, seed, job.seeds) != 0)
+    {
+        result = MALLOC_ERROR;
+        goto job_cleanup;
+    }
+
+    if (parallel_for(k_max - k_min + 1, sweep_task, &job) != 0)
+    {
+        result = MALLOC_ERROR;
+        goto job_cleanup;
+    }
+    for (i = 0; i <= k_max - k_min; i++)
+    {
+        if (OK != results[i].status)
+        {
+            result = MALLOC_ERROR;
+        }
+    }
+
+job_cleanup:
+    free(embedded);
+    if (NULL != t_mat)
+    {
+        free_matrix(n, (void **)t_mat);
+    }
+    free(job.seeds);
+    if (NULL != job.u_mat)
+    {
+        free_matrix(n, (void **)job.u_mat);
+    }
+eigens_cleanup:
+    free_eigens(n, eigens);
+end:
+    return result;
+}
+
+void free_sweep_results(const size_t count, sweep_result_t *results)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        if (NULL != results[i].centroids)
+        {
+            free_points(results[i].k, results[i].centroids);
+        }
+        free(results[i].labels);
+    }
+}
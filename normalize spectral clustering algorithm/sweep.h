@@ -0,0 +1,21 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stdlib.h>
+#include "point.h"
+#include "spkmeans.h"
+
+typedef struct sweep_result_t
+{
+    size_t k;
+    point_t *centroids; /* k centroids of dimension k */
+    size_t *labels;     /* One label per input point */
+    double inertia;
+    size_t iterations;
+    int status; /* The return value of the fit for this k */
+} sweep_result_t;
+
+error_e spk_sweep(const size_t n, point_t *points, const size_t dim, const size_t k_min, const size_t k_max, const size_t max_iter, const float epsilon, const unsigned long seed, sweep_result_t *results, size_t *eigengap_k);
+void free_sweep_results(const size_t count, sweep_result_t *results);
+
+#endif /* SWEEP_H */
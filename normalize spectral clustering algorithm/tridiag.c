@@ -0,0 +1,582 @@
+/*
+ * Dense symmetric eigensolver: Householder reduction to tridiagonal form T = Q^T A Q,
+ * then either implicit-shift QL for the whole spectrum, or Sturm bisection and inverse iteration
+ * when only the largest eigenpairs are needed.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+#include "tridiag.h"
+#include "eigen.h"
+#include "matrix.h"
+
+/*sqrt(a^2 + b^2) without destructive underflow or overflow*/
+static double pythag(const double a, const double b)
+{
+    double abs_a = fabs(a), abs_b = fabs(b);
+    if (abs_a > abs_b)
+    {
+        return abs_a * sqrt(1.0 + (abs_b / abs_a) * (abs_b / abs_a));
+    }
+    return 0.0 == abs_b ? 0.0 : abs_b * sqrt(1.0 + (abs_a / abs_b) * (abs_a / abs_b));
+}
+
+/*
+ * Reduces the symmetric 'a' to tridiagonal form (diagonal 'd', off-diagonal 'e').
+ * Reflector j is H_j = I - tau[j] * v v^T with v[j + 1] = 1 and v[r] = a[r][j] for r > j + 1.
+ * Reflectors are generated a panel at a time; within a panel, a[][] is only brought up to date for the
+ * column being reduced, and the trailing matrix gets one rank-2*TRIDIAG_BLOCK update A -= V W^T + W V^T.
+ */
+static int tridiag_reduce(const size_t n, double **a, double *d, double *e, double *tau)
+{
+    double **v, **w;
+    double alpha, beta, xnorm, scale, dot, s1, s2, vr, wr;
+    size_t j0, j, p, q, r, c, nb;
+
+    v = (double **)malloc_matrix(TRIDIAG_BLOCK, n, sizeof(double));
+    if (NULL == v)
+    {
+        return 1;
+    }
+    w = (double **)malloc_matrix(TRIDIAG_BLOCK, n, sizeof(double));
+    if (NULL == w)
+    {
+        free_matrix(TRIDIAG_BLOCK, (void **)v);
+        return 1;
+    }
+
+    for (j0 = 0; j0 + 1 < n; j0 += nb)
+    {
+        nb = n - 1 - j0 < TRIDIAG_BLOCK ? n - 1 - j0 : TRIDIAG_BLOCK;
+        for (p = 0; p < nb; p++)
+        {
+            j = j0 + p;
+            for (q = 0; q < p; q++)
+            {
+                for (r = j; r < n; r++)
+                {
+                    a[r][j] -= v[q][r] * w[q][j] + w[q][r] * v[q][j];
+                }
+            }
+            memset(v[p], 0, n * sizeof(double));
+            memset(w[p], 0, n * sizeof(double));
+
+            alpha = a[j + 1][j];
+            xnorm = .0;
+            for (r = j + 2; r < n; r++)
+            {
+                xnorm += a[r][j] * a[r][j];
+            }
+            xnorm = sqrt(xnorm);
+            if (.0 == xnorm)
+            {
+                tau[j] = .0;
+                beta = alpha;
+            }
+            else
+            {
+                beta = (alpha >= .0 ? -1.0 : 1.0) * pythag(alpha, xnorm);
+                tau[j] = (beta - alpha) / beta;
+                scale = 1.0 / (alpha - beta);
+                v[p][j + 1] = 1.0;
+                for (r = j + 2; r < n; r++)
+                {
+                    a[r][j] *= scale;
+                    v[p][r] = a[r][j];
+                }
+
+                /* w = tau * (A v - V (W^T v) - W (V^T v)), A being the trailing matrix as of the panel start */
+                for (r = j + 1; r < n; r++)
+                {
+                    dot = .0;
+                    for (c = j + 1; c < n; c++)
+                    {
+                        dot += a[r][c] * v[p][c];
+                    }
+                    w[p][r] = dot;
+                }
+                for (q = 0; q < p; q++)
+                {
+                    s1 = s2 = .0;
+                    for (r = j + 1; r < n; r++)
+                    {
+                        s1 += w[q][r] * v[p][r];
+                        s2 += v[q][r] * v[p][r];
+                    }
+                    for (r = j + 1; r < n; r++)
+                    {
+                        w[p][r] -= v[q][r] * s1 + w[q][r] * s2;
+                    }
+                }
+                dot = .0;
+                for (r = j + 1; r < n; r++)
+                {
+                    w[p][r] *= tau[j];
+                    dot += w[p][r] * v[p][r];
+                }
+                for (r = j + 1; r < n; r++)
+                {
+                    w[p][r] -= 0.5 * tau[j] * dot * v[p][r];
+                }
+            }
+            d[j] = a[j][j];
+            e[j] = beta;
+        }
+
+        for (r = j0 + nb; r < n; r++)
+        {
+            for (q = 0; q < nb; q++)
+            {
+                vr = v[q][r];
+                wr = w[q][r];
+                for (c = j0 + nb; c < n; c++)
+                {
+                    a[r][c] -= vr * w[q][c] + wr * v[q][c];
+                }
+            }
+        }
+    }
+    d[n - 1] = a[n - 1][n - 1];
+
+    free_matrix(TRIDIAG_BLOCK, (void **)w);
+    free_matrix(TRIDIAG_BLOCK, (void **)v);
+    return 0;
+}
+
+/*Forms Q = H_0 H_1 ... H_(n-2) explicitly by applying the reflectors to the identity from the last one back*/
+static void tridiag_form_q(const size_t n, double **a, double *tau, double **q, double *work)
+{
+    size_t j, r, c;
+    double factor;
+    init_eye_matrix(n, q);
+    for (j = n - 1; j-- > 0;)
+    {
+        if (.0 == tau[j])
+        {
+            continue;
+        }
+        for (c = j + 1; c < n; c++)
+        {
+            work[c] = q[j + 1][c];
+        }
+        for (r = j + 2; r < n; r++)
+        {
+            for (c = j + 1; c < n; c++)
+            {
+                work[c] += a[r][j] * q[r][c];
+            }
+        }
+        for (c = j + 1; c < n; c++)
+        {
+            q[j + 1][c] -= tau[j] * work[c];
+        }
+        for (r = j + 2; r < n; r++)
+        {
+            factor = tau[j] * a[r][j];
+            for (c = j + 1; c < n; c++)
+            {
+                q[r][c] -= factor * work[c];
+            }
+        }
+    }
+}
+
+/*Applies Q to a single vector expressed in the tridiagonal basis*/
+static void tridiag_back_transform(const size_t n, double **a, double *tau, double *y)
+{
+    size_t j, r;
+    double dot;
+    for (j = n - 1; j-- > 0;)
+    {
+        if (.0 == tau[j])
+        {
+            continue;
+        }
+        dot = y[j + 1];
+        for (r = j + 2; r < n; r++)
+        {
+            dot += a[r][j] * y[r];
+        }
+        dot *= tau[j];
+        y[j + 1] -= dot;
+        for (r = j + 2; r < n; r++)
+        {
+            y[r] -= dot * a[r][j];
+        }
+    }
+}
+
+/*
+ * Implicit-shift QL on the tridiagonal (d, e), e[n - 1] being scratch. On return d holds the eigenvalues.
+ * When 'z' is not NULL its rows are rotated along, so rows that started as the columns of Q end as eigenvectors.
+ */
+static int tridiag_ql(const size_t n, double *d, double *e, double **z)
+{
+    size_t l, m, iter, k;
+    long i;
+    double s, r, p, g, f, dd, c, b, *row;
+
+    e[n - 1] = .0;
+    for (l = 0; l < n; l++)
+    {
+        iter = 0;
+        do
+        {
+            for (m = l; m + 1 < n; m++)
+            {
+                dd = fabs(d[m]) + fabs(d[m + 1]);
+                if (fabs(e[m]) <= DBL_EPSILON * dd)
+                {
+                    break;
+                }
+            }
+            if (m != l)
+            {
+                if (iter++ == TRIDIAG_MAX_QL_ITER)
+                {
+                    return 1;
+                }
+                g = (d[l + 1] - d[l]) / (2.0 * e[l]);
+                r = pythag(g, 1.0);
+                g = d[m] - d[l] + e[l] / (g + (g >= .0 ? fabs(r) : -fabs(r)));
+                s = c = 1.0;
+                p = .0;
+                for (i = (long)m - 1; i >= (long)l; i--)
+                {
+                    f = s * e[i];
+                    b = c * e[i];
+                    e[i + 1] = (r = pythag(f, g));
+                    if (.0 == r)
+                    {
+                        d[i + 1] -= p;
+                        e[m] = .0;
+                        break;
+                    }
+                    s = f / r;
+                    c = g / r;
+                    g = d[i + 1] - p;
+                    r = (d[i] - g) * s + 2.0 * c * b;
+                    d[i + 1] = g + (p = s * r);
+                    g = c * r - b;
+                    if (NULL != z)
+                    {
+                        row = z[i + 1];
+                        for (k = 0; k < n; k++)
+                        {
+                            f = row[k];
+                            row[k] = s * z[i][k] + c * f;
+                            z[i][k] = c * z[i][k] - s * f;
+                        }
+                    }
+                }
+                if (.0 == r && i >= (long)l)
+                {
+                    continue;
+                }
+                d[l] -= p;
+                e[l] = g;
+                e[m] = .0;
+            }
+        } while (m != l);
+    }
+    return 0;
+}
+
+/*Sturm count: the number of eigenvalues of the tridiagonal (d, e) that are smaller than x*/
+static size_t sturm_count(const size_t n, double *d, double *e, const double x, const double pivmin)
+{
+    size_t i, count = 0;
+    double q = d[0] - x;
+    if (fabs(q) < pivmin)
+    {
+        q = -pivmin;
+    }
+    count += q < .0;
+    for (i = 1; i < n; i++)
+    {
+        q = d[i] - x - e[i - 1] * e[i - 1] / q;
+        if (fabs(q) < pivmin)
+        {
+            q = -pivmin;
+        }
+        count += q < .0;
+    }
+    return count;
+}
+
+/*Bisection for the eigenvalue of rank 'index' in ascending order, inside the Gershgorin interval [lo, hi]*/
+static double tridiag_bisect(const size_t n, double *d, double *e, const size_t index, double lo, double hi, const double pivmin)
+{
+    size_t iter;
+    double mid;
+    for (iter = 0; iter < TRIDIAG_BISECT_ITER; iter++)
+    {
+        mid = 0.5 * (lo + hi);
+        if (hi - lo <= 2.0 * DBL_EPSILON * (fabs(lo) + fabs(hi)) + pivmin)
+        {
+            break;
+        }
+        if (sturm_count(n, d, e, mid, pivmin) > index)
+        {
+            hi = mid;
+        }
+        else
+        {
+            lo = mid;
+        }
+    }
+    return 0.5 * (lo + hi);
+}
+
+/*
+ * Inverse iteration for the eigenvector of (d, e) with eigenvalue 'value': LU of T - value*I with partial
+ * pivoting, then a few solves. 'previous' holds already computed vectors of nearby eigenvalues, which the
+ * iterate is kept orthogonal to so that clustered eigenvalues still get independent vectors.
+ */
+static void tridiag_inverse_iteration(const size_t n, double *d, double *e, const double value, const double pivmin, double **previous, const size_t previous_len, double *y, double *work)
+{
+    double *u0 = work, *u1 = work + n, *u2 = work + 2 * n, *mult = work + 3 * n, *piv = work + 4 * n;
+    double t0, t1, tmp, norm, dot;
+    size_t i, iter, j;
+    unsigned long state = 12345;
+
+    for (i = 0; i < n; i++)
+    {
+        u0[i] = d[i] - value;
+        u1[i] = i + 1 < n ? e[i] : .0;
+        u2[i] = .0;
+    }
+    for (i = 0; i + 1 < n; i++)
+    {
+        if (fabs(u0[i]) >= fabs(e[i]))
+        {
+            piv[i] = .0;
+            if (fabs(u0[i]) < pivmin)
+            {
+                u0[i] = pivmin;
+            }
+            mult[i] = e[i] / u0[i];
+            u0[i + 1] -= mult[i] * u1[i];
+        }
+        else
+        {
+            piv[i] = 1.0;
+            mult[i] = u0[i] / e[i];
+            t0 = u0[i + 1];
+            t1 = u1[i + 1];
+            tmp = u1[i];
+            u0[i] = e[i];
+            u1[i] = t0;
+            u2[i] = t1;
+            u0[i + 1] = tmp - mult[i] * t0;
+            u1[i + 1] = -mult[i] * t1;
+        }
+    }
+    if (fabs(u0[n - 1]) < pivmin)
+    {
+        u0[n - 1] = pivmin;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        state = state * 6364136223846793005UL + 1442695040888963407UL;
+        y[i] = (double)(state >> 11) / 9007199254740992.0 - 0.5;
+    }
+    for (iter = 0; iter < TRIDIAG_INVERSE_ITER; iter++)
+    {
+        for (j = 0; j < previous_len; j++)
+        {
+            dot = .0;
+            for (i = 0; i < n; i++)
+            {
+                dot += previous[j][i] * y[i];
+            }
+            for (i = 0; i < n; i++)
+            {
+                y[i] -= dot * previous[j][i];
+            }
+        }
+        for (i = 0; i + 1 < n; i++)
+        {
+            if (.0 != piv[i])
+            {
+                tmp = y[i];
+                y[i] = y[i + 1];
+                y[i + 1] = tmp;
+            }
+            y[i + 1] -= mult[i] * y[i];
+        }
+        for (i = n; i-- > 0;)
+        {
+            tmp = y[i];
+            if (i + 1 < n)
+            {
+                tmp -= u1[i] * y[i + 1];
+            }
+            if (i + 2 < n)
+            {
+                tmp -= u2[i] * y[i + 2];
+            }
+            y[i] = tmp / u0[i];
+        }
+        norm = .0;
+        for (i = 0; i < n; i++)
+        {
+            norm += y[i] * y[i];
+        }
+        norm = sqrt(norm);
+        for (i = 0; i < n; i++)
+        {
+            y[i] /= norm;
+        }
+    }
+}
+
+/*Copies 'mat' and reduces the copy; the caller frees 'a' and 'tau'*/
+static int reduce_copy(const size_t n, double **mat, double ***a, double *d, double *e, double **tau)
+{
+    *a = (double **)malloc_matrix(n, n, sizeof(double));
+    if (NULL == *a)
+    {
+        return 1;
+    }
+    *tau = (double *)calloc(n, sizeof(double));
+    if (NULL == *tau)
+    {
+        free_matrix(n, (void **)*a);
+        return 1;
+    }
+    copy_matrix(n, mat, *a);
+    if (tridiag_reduce(n, *a, d, e, *tau) != 0)
+    {
+        free(*tau);
+        free_matrix(n, (void **)*a);
+        return 1;
+    }
+    return 0;
+}
+
+/*The full decomposition, in the same unsorted form as jacobi()*/
+int tridiag_eigens(const size_t n, double **mat, eigen_t *eigens)
+{
+    int result = 1;
+    double **a, **q, *tau, *d, *e, *work;
+    size_t i, j;
+
+    d = (double *)calloc(3 * n, sizeof(double));
+    if (NULL == d)
+    {
+        goto end;
+    }
+    e = d + n;
+    work = d + 2 * n;
+    if (reduce_copy(n, mat, &a, d, e, &tau) != 0)
+    {
+        goto d_cleanup;
+    }
+    q = (double **)malloc_matrix(n, n, sizeof(double));
+    if (NULL == q)
+    {
+        goto a_cleanup;
+    }
+    tridiag_form_q(n, a, tau, q, work);
+    transpose(n, q, a); /* QL rotates rows, so the columns of Q go in as rows */
+    result = tridiag_ql(n, d, e, a);
+    for (i = 0; i < n; i++)
+    {
+        eigens[i].value = d[i];
+        for (j = 0; j < n; j++)
+        {
+            eigens[i].vector[j] = a[i][j];
+        }
+    }
+
+    free_matrix(n, (void **)q);
+a_cleanup:
+    free(tau);
+    free_matrix(n, (void **)a);
+d_cleanup:
+    free(d);
+end:
+    return result;
+}
+
+/*
+ * The largest eigenpairs only, sorted as in section 1.3. Bisection finds the *k largest eigenvalues, or the
+ * n / 2 + 1 that find_eigengap_max() reads when *k is 0 (in which case *k is set from the eigengap), and
+ * inverse iteration computes eigenvectors for the first *k of them. The remaining entries are left unset.
+ */
+int tridiag_top_eigens(const size_t n, double **mat, eigen_t *eigens, size_t *k)
+{
+    int result = 1;
+    double **a, *tau, *d, *e, *work, **cluster;
+    double lo, hi, radius, norm, pivmin, tolerance;
+    size_t i, needed, cluster_start;
+
+    d = (double *)calloc(7 * n, sizeof(double));
+    if (NULL == d)
+    {
+        goto end;
+    }
+    e = d + n;
+    work = d + 2 * n;
+    if (reduce_copy(n, mat, &a, d, e, &tau) != 0)
+    {
+        goto d_cleanup;
+    }
+    cluster = (double **)malloc(n * sizeof(double *));
+    if (NULL == cluster)
+    {
+        goto a_cleanup;
+    }
+
+    lo = DBL_MAX;
+    hi = -DBL_MAX;
+    for (i = 0; i < n; i++)
+    {
+        radius = (i > 0 ? fabs(e[i - 1]) : .0) + (i + 1 < n ? fabs(e[i]) : .0);
+        lo = d[i] - radius < lo ? d[i] - radius : lo;
+        hi = d[i] + radius > hi ? d[i] + radius : hi;
+    }
+    norm = fabs(lo) > fabs(hi) ? fabs(lo) : fabs(hi);
+    pivmin = DBL_MIN + DBL_EPSILON * norm;
+    tolerance = 1e-3 * norm; /* Eigenvalues closer than this are treated as one cluster */
+
+    needed = 0 == *k ? n / 2 + 1 : *k;
+    needed = needed > n ? n : needed;
+    for (i = 0; i < needed; i++)
+    {
+        eigens[i].value = tridiag_bisect(n, d, e, n - 1 - i, lo, hi, pivmin);
+    }
+    if (0 == *k)
+    {
+        *k = find_eigengap_max(n, eigens);
+    }
+
+    cluster_start = 0;
+    for (i = 0; i < *k; i++)
+    {
+        if (i > 0 && eigens[i - 1].value - eigens[i].value > tolerance)
+        {
+            cluster_start = i;
+        }
+        tridiag_inverse_iteration(n, d, e, eigens[i].value, pivmin, cluster, i - cluster_start, eigens[i].vector, work);
+        cluster[i - cluster_start] = eigens[i].vector;
+    }
+    for (i = 0; i < *k; i++)
+    {
+        tridiag_back_transform(n, a, tau, eigens[i].vector);
+    }
+    result = 0;
+
+    free(cluster);
+a_cleanup:
+    free(tau);
+    free_matrix(n, (void **)a);
+d_cleanup:
+    free(d);
+end:
+    return result;
+}
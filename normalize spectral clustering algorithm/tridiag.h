@@ -0,0 +1,15 @@
+#ifndef TRIDIAG_H
+#define TRIDIAG_H
+
+#include <stdlib.h>
+#include "eigen.h"
+
+#define TRIDIAG_BLOCK 32        /* Columns reduced per panel before the trailing matrix is updated */
+#define TRIDIAG_MAX_QL_ITER 60  /* Implicit QL iterations allowed per eigenvalue */
+#define TRIDIAG_BISECT_ITER 128 /* Upper bound on bisection steps per eigenvalue */
+#define TRIDIAG_INVERSE_ITER 3  /* Inverse iteration solves per eigenvector */
+
+int tridiag_eigens(const size_t n, double **mat, eigen_t *eigens);
+int tridiag_top_eigens(const size_t n, double **mat, eigen_t *eigens, size_t *k);
+
+#endif /* TRIDIAG_H */